@@ -0,0 +1,144 @@
+﻿using System;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Text;
+using System.Text.RegularExpressions;
+
+namespace Sage.Benchmarks
+{
+    internal struct BackendResult
+    {
+        public string Name;
+        public double CompileSeconds;
+        public double RunSeconds;
+        public int ExitCode;
+    }
+
+    // Compares running a program with "--run" against compiling it to an executable and running that, from the start
+    // of the compiler process, which is the latency a script pays. The program calls a tree of functions, twice at
+    // every level, so the run time is spent in calls rather than in loops the optimizer could shorten.
+    internal class BackendBenchmark
+    {
+        private static readonly Regex RunTime = new Regex(@"^\[INFO\] Ran "".*"" in ([0-9.]+) ms", RegexOptions.Multiline);
+
+        private readonly int Iterations;
+        private readonly string Directory;
+
+        public BackendBenchmark(int iterations, string directory)
+        {
+            Iterations = iterations;
+            Directory = directory;
+        }
+
+        // Functions F0 to F<depth>, with Main calling the last one, so the program makes 2^depth calls
+        public static string GenerateProgram(int depth)
+        {
+            StringBuilder builder = new StringBuilder();
+
+            builder.Append("function F0(i64 x) -> i64\n{\n\treturn x * 3 + 1;\n}\n");
+
+            for (int i = 1; i <= depth; i++)
+                builder.Append($"\nfunction F{i}(i64 x) -> i64\n{{\n\ti64 y = F{i - 1}(x) * 7;\n\treturn y + F{i - 1}(x + {i}) / 3;\n}}\n");
+
+            builder.Append($"\nfunction Main() -> i64\n{{\n\treturn F{depth}(1);\n}}\n");
+            return builder.ToString();
+        }
+
+        public BackendResult MeasureVirtualMachine(string fileName)
+        {
+            return Measure("--run", () =>
+            {
+                BackendResult result = new BackendResult();
+                string output;
+                double seconds = RunCompiler($"\"{fileName}\" --run", out result.ExitCode, out output);
+
+                Match match = RunTime.Match(output);
+                result.RunSeconds = match.Success ? double.Parse(match.Groups[1].Value, CultureInfo.InvariantCulture) / 1000 : 0;
+                result.CompileSeconds = seconds - result.RunSeconds;
+                return result;
+            });
+        }
+
+        // Returns null when the program cannot be built, as when no C compiler is installed
+        public BackendResult? MeasureNative(string fileName)
+        {
+            string executable = Path.Combine(Directory, Path.GetFileNameWithoutExtension(fileName) + (Toolchain.IsWindows ? ".exe" : ""));
+            bool built = true;
+
+            BackendResult measured = Measure("native", () =>
+            {
+                BackendResult result = new BackendResult();
+                string output;
+                int exitCode;
+
+                result.CompileSeconds = RunCompiler($"\"{fileName}\" -o \"{executable}\"", out exitCode, out output);
+                built &= exitCode == 0;
+
+                if (built)
+                    result.RunSeconds = RunProcess(executable, "", out result.ExitCode, out output);
+
+                return result;
+            });
+
+            if (File.Exists(executable))
+                File.Delete(executable);
+
+            return built ? measured : (BackendResult?)null;
+        }
+
+        private BackendResult Measure(string name, Func<BackendResult> run)
+        {
+            run();
+
+            BackendResult[] results = new BackendResult[Iterations];
+
+            for (int i = 0; i < Iterations; i++)
+                results[i] = run();
+
+            // The median of every phase
+            Array.Sort(results, (left, right) => left.CompileSeconds.CompareTo(right.CompileSeconds));
+            double compile = results[Iterations / 2].CompileSeconds;
+
+            Array.Sort(results, (left, right) => left.RunSeconds.CompareTo(right.RunSeconds));
+
+            BackendResult median = results[Iterations / 2];
+            median.Name = name;
+            median.CompileSeconds = compile;
+            return median;
+        }
+
+        // The compiler next to the benchmarks, and the runtime of .NET for the builds that are not executables
+        private static double RunCompiler(string arguments, out int exitCode, out string output)
+        {
+            string compiler = typeof(Driver).Assembly.Location;
+
+            if (Path.GetExtension(compiler).Equals(".exe", StringComparison.OrdinalIgnoreCase))
+                return RunProcess(compiler, arguments, out exitCode, out output);
+
+            return RunProcess("dotnet", $"\"{compiler}\" {arguments}", out exitCode, out output);
+        }
+
+        private static double RunProcess(string fileName, string arguments, out int exitCode, out string output)
+        {
+            ProcessStartInfo start = new ProcessStartInfo(fileName, arguments)
+            {
+                UseShellExecute = false,
+                RedirectStandardOutput = true,
+                CreateNoWindow = true
+            };
+
+            Stopwatch stopwatch = Stopwatch.StartNew();
+
+            using (Process process = Process.Start(start))
+            {
+                output = process.StandardOutput.ReadToEnd();
+                process.WaitForExit();
+                stopwatch.Stop();
+                exitCode = process.ExitCode;
+            }
+
+            return stopwatch.Elapsed.TotalSeconds;
+        }
+    }
+}
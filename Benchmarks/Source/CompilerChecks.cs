@@ -0,0 +1,321 @@
+﻿using System;
+using System.Globalization;
+using System.IO;
+using System.Text;
+
+namespace Sage.Benchmarks
+{
+    // Checks of the compiler over small sources written for them, each one a case that once went wrong. A check
+    // returns the reason it failed, or null.
+    internal static class CompilerChecks
+    {
+        private const string FileName = "Check.sg";
+
+        private static string Directory;
+
+        // Returns the number of checks that failed, the sources some checks need as files are written in the directory
+        public static int Run(string directory)
+        {
+            Func<string>[] checks = { DeepNesting, NestingBelowLimit, RepeatedRelex, RelexKeepsErrors, SignedMinimums, MixedIntegerTypes };
+            string[] names = { "Deep nesting", "Nesting below the limit", "Repeated relex", "Relex keeps errors", "Signed minimums", "Mixed integer types" };
+            Directory = directory;
+            int failures = 0;
+
+            for (int i = 0; i < checks.Length; i++)
+            {
+                string failure = checks[i]();
+
+                if (failure != null)
+                {
+                    Console.WriteLine($"[ERROR] {names[i]}: {failure}.");
+                    failures++;
+                }
+            }
+
+            Console.WriteLine($"[INFO] Ran {checks.Length} check(s) of the compiler, {failures} failed.");
+            return failures;
+        }
+
+        // Nesting far deeper than the parser accepts used to exhaust its stack, now it is a single error and the
+        // functions after it still parse
+        private static string DeepNesting()
+        {
+            const int depth = 50000;
+            string[] sources =
+            {
+                Nested("(", ")", depth, "1"),
+                Nested("-", "", depth, "1"),
+                Nested("{ ", "} ", depth, ""),
+                Chain("+", depth),
+                Chain("*", depth)
+            };
+
+            foreach (string body in sources)
+            {
+                DiagnosticBag diagnostics = new DiagnosticBag();
+                Ast tree = Parse(Function("Main", body) + Function("Other", "i32 y = 7;"), diagnostics);
+
+                if (diagnostics.Count != 1 || diagnostics.Items[0].Code != DiagnosticCode.NestingTooDeep)
+                    return $"{diagnostics.Count} diagnostic(s) instead of a single one for the nesting";
+
+                int item = tree.Nodes[tree.Root].Left;
+
+                if (item < 0 || tree.Nodes[item].Kind != NodeKind.Function || tree.Nodes[item].Next >= 0)
+                    return "the function after the nesting was not parsed alone";
+            }
+
+            return null;
+        }
+
+        private static string NestingBelowLimit()
+        {
+            const int depth = Parser.MaxDepth / 2;
+            string[] sources = { Nested("(", ")", depth, "1"), Nested("-", "", depth, "1"), Nested("{ ", "} ", depth, ""), Chain("+", depth) };
+
+            foreach (string body in sources)
+            {
+                DiagnosticBag diagnostics = new DiagnosticBag();
+                Parse(Function("Main", body), diagnostics);
+
+                if (diagnostics.Count != 0)
+                    return $"{diagnostics.Count} diagnostic(s) for a nesting {depth} deep";
+            }
+
+            return null;
+        }
+
+        // Every relex scans the literals of the edited line again, the table of the numbers must still not grow with
+        // the number of edits
+        private static string RepeatedRelex()
+        {
+            const int edits = 1000;
+            string fileName = Path.Combine(Directory, FileName);
+            string source = Function("Main", "i32 x = 1 + 2 * 3;\n\ti32 y = 40 - x;") + Function("Other", "i32 z = 5;");
+            int offset = source.IndexOf('1');
+
+            File.WriteAllText(fileName, source);
+
+            try
+            {
+                Lexer lexer = new Lexer();
+
+                using (TokenStream tokens = lexer.Read(fileName))
+                {
+                    for (int i = 0; i < edits; i++)
+                        lexer.Relex(tokens, offset, (i % 2 == 0) ? 1 : 2, (i % 2 == 0) ? "17" : "1");
+
+                    int count = 0;
+
+                    for (int i = 0; i < tokens.Count; i++)
+                    {
+                        if (tokens[i].Type != Token.Number)
+                            continue;
+
+                        string text = new string(tokens.Source, tokens[i].Offset, tokens[i].Length);
+
+                        if (tokens.Numbers[tokens[i].Value].Value != ulong.Parse(text, CultureInfo.InvariantCulture))
+                            return $"the literal {text} has the value {tokens.Numbers[tokens[i].Value].Value}";
+
+                        count++;
+                    }
+
+                    if (tokens.NumberCount > 2 * count + 16)
+                        return $"{tokens.NumberCount} entries in the table of the numbers for {count} literals after {edits} edits";
+                }
+            }
+
+            finally
+            {
+                File.Delete(fileName);
+            }
+
+            return null;
+        }
+
+        // The watcher reports the errors of the lexer after every edit, so the ones of the lines Relex does not scan
+        // again must stay, at their new place, while the ones of the edited lines follow the edit
+        private static string RelexKeepsErrors()
+        {
+            string fileName = Path.Combine(Directory, FileName);
+            string source = Function("Main", "i32 a = 1;\n\ti32 x = 12abc;");
+
+            File.WriteAllText(fileName, source);
+
+            try
+            {
+                DiagnosticBag diagnostics = new DiagnosticBag();
+                Lexer lexer = new Lexer(diagnostics);
+
+                using (TokenStream tokens = lexer.Read(fileName))
+                {
+                    int bad = source.IndexOf("12abc");
+                    string[] edits = { "2", "1234", "7", "3u8x" };
+                    int length = 1;
+
+                    for (int i = 0; i < edits.Length; i++)
+                    {
+                        lexer.Relex(tokens, source.IndexOf('1'), length, edits[i]);
+                        bad += edits[i].Length - length;
+                        length = edits[i].Length;
+
+                        // The last edit is a bad literal of its own, before the old one
+                        int expected = (i == edits.Length - 1) ? 2 : 1;
+
+                        if (diagnostics.Count != expected || diagnostics.Items[expected - 1].Code != DiagnosticCode.InvalidNumber || diagnostics.Items[expected - 1].Start != bad)
+                            return $"{diagnostics.Count} diagnostic(s) after the edit {edits[i]} instead of {expected}, the last one for the literal at {bad}";
+                    }
+
+                    lexer.Relex(tokens, bad, 5, "12");
+
+                    if (diagnostics.Count != 1 || diagnostics.Items[0].Start != source.IndexOf('1'))
+                        return "the error of the literal fixed by the edit is still reported";
+                }
+            }
+
+            finally
+            {
+                File.Delete(fileName);
+            }
+
+            return null;
+        }
+
+        // The minimum of every signed type is written as the negated literal of its magnitude, which is too large for
+        // the type anywhere else
+        private static string SignedMinimums()
+        {
+            string[] types = { "i8", "i16", "i32", "i64" };
+            string[] magnitudes = { "128", "32768", "2147483648", "9223372036854775808" };
+
+            for (int i = 0; i < types.Length; i++)
+            {
+                string literal = magnitudes[i] + types[i];
+                DiagnosticBag diagnostics = new DiagnosticBag();
+
+                Parse(Function("Main", $"{types[i]} x = -{literal};\n\t{types[i]} y = - {literal} + 1{types[i]};"), diagnostics);
+
+                if (diagnostics.Count != 0)
+                    return $"{diagnostics.Count} diagnostic(s) for -{literal}";
+
+                string[] errors = { $"{types[i]} x = {literal};", $"{types[i]} x = 1{types[i]} - {literal};", $"{types[i]} x = -({literal});" };
+
+                foreach (string body in errors)
+                {
+                    diagnostics = new DiagnosticBag();
+                    Parse(Function("Main", body), diagnostics);
+
+                    if (diagnostics.Count != 1 || diagnostics.Items[0].Code != DiagnosticCode.NumberTooLarge)
+                        return $"{diagnostics.Count} diagnostic(s) instead of a single one for the literal of \"{body}\"";
+                }
+
+                diagnostics = new DiagnosticBag();
+                Parse(Function("Main", $"{types[i]} x = -{ulong.Parse(magnitudes[i], CultureInfo.InvariantCulture) + 1}{types[i]};"), diagnostics);
+
+                if (diagnostics.Count != 1 || diagnostics.Items[0].Code != DiagnosticCode.NumberTooLarge)
+                    return $"the literal one past the minimum of {types[i]} is not too large";
+            }
+
+            return null;
+        }
+
+        // Integers of two types compute in a type holding both, and only the literals without a suffix narrow
+        private static string MixedIntegerTypes()
+        {
+            DiagnosticBag diagnostics = new DiagnosticBag();
+            Module module = Analyze(Function("Main", "u8 a = 1u8;\n\ti64 b = 257;\n\ti16 c = a + 1i8;\n\tif (a < b) { c = 7; }"), diagnostics);
+
+            if (diagnostics.Count != 0)
+                return $"{diagnostics.Count} diagnostic(s) for operands a type holds";
+
+            for (int node = 0; node < module.Tree.Count; node++)
+            {
+                if (module.Tree.Nodes[node].Kind == NodeKind.Compare && module.Types[node] != TypeId.I64)
+                    return $"u8 and i64 are compared in {TypeTable.NameOf(module.Types[node])}";
+            }
+
+            string[] bodies =
+            {
+                "i64 b = 1;\n\ti8 n = b;",
+                "i64 b = 1;\n\ti32 s = b * 2 + 1;",
+                "i64 b = 1;\n\treturn b;",
+                "u32 b = 1u32;\n\ti32 s = b;",
+                "i64 b = 1;\n\tu64 c = 1u64;\n\tif (b < c) { b = 2; }",
+                "i64 b = 1;\n\tu64 c = 1u64;\n\ti8 s = b + c;"
+            };
+            DiagnosticCode[] codes =
+            {
+                DiagnosticCode.NarrowingConversion, DiagnosticCode.NarrowingConversion, DiagnosticCode.NarrowingConversion,
+                DiagnosticCode.NarrowingConversion, DiagnosticCode.MixedTypes, DiagnosticCode.MixedTypes
+            };
+
+            for (int i = 0; i < bodies.Length; i++)
+            {
+                diagnostics = new DiagnosticBag();
+                Analyze(Function("Main", bodies[i]), diagnostics);
+
+                if (diagnostics.Count != 1 || diagnostics.Items[0].Code != codes[i])
+                    return $"{diagnostics.Count} diagnostic(s) instead of a single {codes[i]} for \"{bodies[i]}\"";
+            }
+
+            return null;
+        }
+
+        // A statement with the value nested depth times, or depth nested blocks when the value is empty
+        private static string Nested(string open, string close, int depth, string value)
+        {
+            StringBuilder builder = new StringBuilder();
+
+            if (value.Length > 0)
+                builder.Append("i32 x = ");
+
+            for (int i = 0; i < depth; i++)
+                builder.Append(open);
+
+            builder.Append(value);
+
+            for (int i = 0; i < depth; i++)
+                builder.Append(close);
+
+            if (value.Length > 0)
+                builder.Append(';');
+
+            return builder.ToString();
+        }
+
+        private static string Chain(string op, int length)
+        {
+            StringBuilder builder = new StringBuilder("i32 x = 1");
+
+            for (int i = 1; i < length; i++)
+                builder.Append(' ').Append(op).Append(" 1");
+
+            return builder.Append(';').ToString();
+        }
+
+        private static string Function(string name, string body)
+        {
+            return $"function {name}() -> i32\n{{\n\t{body}\n\treturn 0;\n}}\n\n";
+        }
+
+        private static Ast Parse(string source, DiagnosticBag diagnostics)
+        {
+            using (TokenStream tokens = Lex(source, diagnostics))
+                return new Parser(diagnostics).Parse(tokens);
+        }
+
+        private static Module Analyze(string source, DiagnosticBag diagnostics)
+        {
+            ModuleGraph graph = new ModuleGraph();
+            Module module = graph.Add(Parse(source, diagnostics), diagnostics);
+
+            graph.Link();
+            new Analyzer(graph).Analyze(module);
+            return module;
+        }
+
+        private static TokenStream Lex(string source, DiagnosticBag diagnostics)
+        {
+            return new Lexer(diagnostics).Read(new MemoryStream(Encoding.UTF8.GetBytes(source)), FileName);
+        }
+    }
+}
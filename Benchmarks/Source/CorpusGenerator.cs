@@ -0,0 +1,140 @@
+﻿using System;
+using System.IO;
+using System.Text;
+
+namespace Sage.Benchmarks
+{
+    enum CorpusKind
+    {
+        // Many small function bodies, like Main.sg repeated
+        Functions = 0,
+
+        // Long arithmetic chains such as "i32 x = a + b * c;"
+        Chains,
+
+        // Sources dominated by commentaries and string literals
+        Comments,
+
+        // All of the above interleaved
+        Mixed
+    }
+
+    // Generates synthetic Sage sources of a given size, the same seed always gives the same text
+    internal static class CorpusGenerator
+    {
+        private static readonly string[] Types = { "i8", "u8", "i16", "u16", "i32", "u32", "i64", "u64" };
+        private static readonly string[] Operators = { "+", "-", "*", "/" };
+        private static readonly string[] Words = { "lorem", "ipsum", "dolor", "sit", "amet", "sage", "compiler", "token", "lexer", "buffer" };
+
+        public static string Generate(CorpusKind kind, int size, int seed)
+        {
+            Random random = new Random(seed);
+            StringBuilder builder = new StringBuilder(size + 1024);
+            int function = 0;
+
+            builder.Append("use Console;\n\n");
+
+            while (builder.Length < size)
+            {
+                CorpusKind next = (kind == CorpusKind.Mixed) ? (CorpusKind)random.Next(3) : kind;
+
+                builder.Append("function Function").Append(function++).Append("() -> i32\n{\n");
+
+                switch (next)
+                {
+                    case CorpusKind.Functions:
+                        AppendFunctionBody(builder, random);
+                        break;
+
+                    case CorpusKind.Chains:
+                        AppendChains(builder, random);
+                        break;
+
+                    case CorpusKind.Comments:
+                        AppendComments(builder, random);
+                        break;
+                }
+
+                builder.Append("\treturn 0;\n}\n\n");
+            }
+
+            return builder.ToString();
+        }
+
+        // Writes the corpus as UTF-8 with a byte order mark, the way the sources of the repository are saved
+        public static string WriteFile(string directory, CorpusKind kind, int size, int seed)
+        {
+            string fileName = Path.Combine(directory, $"{kind}_{size}.sg");
+            File.WriteAllText(fileName, Generate(kind, size, seed), new UTF8Encoding(true));
+            return fileName;
+        }
+
+        private static void AppendFunctionBody(StringBuilder builder, Random random)
+        {
+            int count = random.Next(2, 6);
+
+            for (int i = 0; i < count; i++)
+                builder.Append('\t').Append(Types[random.Next(Types.Length)]).Append(" number").Append(i).Append(" = ").Append(random.Next(100)).Append(";\n");
+
+            builder.Append("\ti32 result = number0 + number1;\n\n");
+        }
+
+        private static void AppendChains(StringBuilder builder, Random random)
+        {
+            int count = random.Next(2, 5);
+
+            for (int i = 0; i < count; i++)
+            {
+                builder.Append("\ti32 value").Append(i).Append(" = a");
+
+                int length = random.Next(8, 40);
+
+                for (int j = 0; j < length; j++)
+                {
+                    builder.Append(' ').Append(Operators[random.Next(Operators.Length)]).Append(' ');
+
+                    if (random.Next(3) == 0)
+                        builder.Append(random.Next(100000));
+
+                    else
+                        builder.Append((char)('a' + random.Next(26))).Append(random.Next(10));
+                }
+
+                builder.Append(";\n");
+            }
+
+            builder.Append('\n');
+        }
+
+        private static void AppendComments(StringBuilder builder, Random random)
+        {
+            int count = random.Next(3, 8);
+
+            for (int i = 0; i < count; i++)
+            {
+                builder.Append("\t// ");
+                AppendSentence(builder, random);
+                builder.Append('\n');
+
+                builder.Append("\tConsole::Write(\"");
+                AppendSentence(builder, random);
+                builder.Append("\");\n");
+            }
+
+            builder.Append('\n');
+        }
+
+        private static void AppendSentence(StringBuilder builder, Random random)
+        {
+            int length = random.Next(4, 16);
+
+            for (int i = 0; i < length; i++)
+            {
+                if (i > 0)
+                    builder.Append(' ');
+
+                builder.Append(Words[random.Next(Words.Length)]);
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+﻿using System;
+using System.Diagnostics;
+using System.IO;
+
+namespace Sage.Benchmarks
+{
+    internal struct BenchmarkResult
+    {
+        public string Name;
+        public long Bytes;
+        public long Tokens;
+        public double Seconds;
+        public double AllocatedPerToken;
+
+        public double MegabytesPerSecond
+        {
+            get { return Bytes / Seconds / (1024.0 * 1024.0); }
+        }
+
+        public double TokensPerSecond
+        {
+            get { return Tokens / Seconds; }
+        }
+    }
+
+    // Measures the lexer over one corpus file, taking the median of several runs after a warmup
+    internal class LexerBenchmark
+    {
+        private const int Warmup = 2;
+
+        private readonly int Iterations;
+
+        public LexerBenchmark(int iterations)
+        {
+            Iterations = iterations;
+        }
+
+        // Reads and lexes the file on every run, the way the driver does
+        public BenchmarkResult MeasureRead(string fileName)
+        {
+            return Measure(fileName, "read + lex", () =>
+            {
+                Lexer lexer = new Lexer();
+
+                using (TokenStream tokens = lexer.Read(fileName))
+                    return tokens.Count;
+            });
+        }
+
+        // Lexes a source that is already in memory, so only the scanner is measured
+        public BenchmarkResult MeasureLex(string fileName)
+        {
+            using (SourceFile source = SourceFile.Open(fileName))
+            {
+                // The streams are not disposed, since that would return the shared source buffer to the pool
+                return Measure(fileName, "lex", () => new Lexer().Read(source).Count);
+            }
+        }
+
+        private BenchmarkResult Measure(string fileName, string name, Func<int> run)
+        {
+            long tokens = 0;
+
+            for (int i = 0; i < Warmup; i++)
+                tokens = run();
+
+            double[] seconds = new double[Iterations];
+
+            GC.Collect();
+            GC.WaitForPendingFinalizers();
+            GC.Collect();
+
+            long allocated = AllocatedBytes();
+
+            for (int i = 0; i < Iterations; i++)
+            {
+                Stopwatch stopwatch = Stopwatch.StartNew();
+                run();
+                seconds[i] = stopwatch.Elapsed.TotalSeconds;
+            }
+
+            allocated = AllocatedBytes() - allocated;
+            Array.Sort(seconds);
+
+            return new BenchmarkResult
+            {
+                Name = name,
+                Bytes = new FileInfo(fileName).Length,
+                Tokens = tokens,
+                Seconds = seconds[seconds.Length / 2],
+                AllocatedPerToken = (tokens > 0) ? (double)allocated / Iterations / tokens : 0
+            };
+        }
+
+        private static long AllocatedBytes()
+        {
+            // The lexer runs on the measuring thread
+            return GC.GetAllocatedBytesForCurrentThread();
+        }
+    }
+}
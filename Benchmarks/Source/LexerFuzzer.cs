@@ -0,0 +1,400 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+
+namespace Sage.Benchmarks
+{
+    // Compares the tokens and the errors of Lexer with the ones of ReferenceLexer over random sources: sequences of
+    // tokens chosen to hit the edges of the rules, and corpora damaged by random edits. Every source is lexed from a
+    // file, from a stream through a small window and once more after an incremental edit.
+    internal class LexerFuzzer
+    {
+        private static readonly string[] Operators = { "->", "::", "==", "<=", ">=", "!=", "-", "=", "<", ">", "+", "*", "/", ";", ",", "(", ")", "[", "]", "{", "}", ":", "!" };
+        private static readonly string[] Blanks = { " ", "  ", "\t", "\n", "\r\n", "\n\t\t", "    ", "\r" };
+        private static readonly string[] Others = { ".", "#", "@", "$", "'", "`", "~", "%", "&", "|", "^", "?", "\0", "\u00E9", "\u4E2D", "\u00A0", "\uD83D\uDE00", "\uD800", "\uFEFF" };
+        private static readonly string[] Escapes = { "\\n", "\\r", "\\t", "\\0", "\\\\", "\\\"", "\\'", "\\x41", "\\x7", "\\xff", "\\u{1F600}", "\\u{41}", "\\u{10FFFF}" };
+        private static readonly string[] BadEscapes = { "\\q", "\\x", "\\xG", "\\u41", "\\u{}", "\\u{110000}", "\\u{D800}", "\\u{1234567}", "\\u{41", "\\u", "\\\r", "\\" };
+        private static readonly string[] Suffixes = { "i8", "u8", "i16", "u16", "i32", "u32", "i64", "u64", "u7", "x", "_", "e", "i" };
+        private static readonly string[] Limits =
+        {
+            "127", "128", "255", "256", "32767", "32768", "65535", "65536", "2147483647", "2147483648", "4294967295", "4294967296",
+            "9223372036854775807", "9223372036854775808", "18446744073709551615", "18446744073709551616", "99999999999999999999999"
+        };
+
+        private static readonly string[] Reserved = new List<string>(ReferenceLexer.ReservedWords).ToArray();
+
+        private readonly Random Random;
+        private readonly string Directory;
+        private string Text;
+        private int Tokens;
+
+        public LexerFuzzer(int seed, string directory)
+        {
+            Random = new Random(seed);
+            Directory = directory;
+        }
+
+        // Returns the number of sources that did not match, each of them is kept in the directory
+        public int Run(int count)
+        {
+            string fileName = Path.Combine(Directory, "Fuzz.sg");
+            int failures = 0;
+
+            for (int i = 0; i < count; i++)
+            {
+                string source = (i % 2 == 0) ? GenerateTokens() : Damage(CorpusGenerator.Generate(CorpusKind.Mixed, Random.Next(256, 4096), Random.Next()));
+                string failure = Check(source, fileName);
+
+                if (failure != null)
+                {
+                    string kept = Path.Combine(Directory, $"Fuzz{i}.sg");
+
+                    File.Copy(fileName, kept, true);
+                    Console.WriteLine($"[ERROR] Source {i} does not lex as the reference does, {failure}. The source was kept in \"{kept}\".");
+                    failures++;
+                }
+            }
+
+            File.Delete(fileName);
+            Console.WriteLine($"[INFO] Compared {count} source(s) and {Tokens} token(s) with the reference lexer, {failures} did not match.");
+            return failures;
+        }
+
+        // The reason the lexer disagrees with the reference on the source, or null
+        private string Check(string source, string fileName)
+        {
+            // The text is written the way an editor saves it, and compared as the lexer decodes it: the halves of the
+            // pairs cut by the edits are replaced, and a byte order mark at the start is not part of the text
+            byte[] bytes = Encoding.UTF8.GetBytes((Random.Next(4) == 0) ? "\uFEFF" + source : source);
+
+            File.WriteAllBytes(fileName, bytes);
+            Text = new UTF8Encoding(false).GetString(bytes);
+
+            if (Text.StartsWith('\uFEFF'))
+                Text = Text.Substring(1);
+
+            ReferenceLexer reference = new ReferenceLexer();
+            reference.Read(Text);
+            Tokens += reference.Tokens.Count;
+
+            DiagnosticBag diagnostics = new DiagnosticBag();
+            string failure;
+
+            using (TokenStream tokens = new Lexer(diagnostics).Read(fileName))
+            {
+                failure = Compare("read from the file", tokens, reference) ?? Compare(diagnostics, reference.Diagnostics);
+
+                if (failure != null)
+                    return failure;
+            }
+
+            // The window is refilled at line breaks and grows for the longer lines
+            diagnostics = new DiagnosticBag();
+            int window = Random.Next(1, 64);
+
+            using (MemoryStream stream = new MemoryStream(bytes))
+            {
+                TokenStream tokens = new Lexer(diagnostics).Read(stream, fileName, window);
+                failure = Compare($"read from a stream through {window} character(s)", tokens, reference) ?? Compare(diagnostics, reference.Diagnostics);
+
+                if (failure != null)
+                    return failure;
+            }
+
+            return CheckEdit(fileName);
+        }
+
+        // Replaces a random range of the text and compares the tokens and the errors Relex keeps and scans with the ones
+        // of the whole edited text
+        private string CheckEdit(string fileName)
+        {
+            int offset = Random.Next(Text.Length + 1);
+            int removed = Random.Next(Math.Min(24, Text.Length - offset) + 1);
+            string inserted = (Random.Next(3) == 0) ? "" : Fragment();
+
+            DiagnosticBag diagnostics = new DiagnosticBag();
+            Lexer lexer = new Lexer(diagnostics);
+
+            using (TokenStream tokens = lexer.Read(fileName))
+            {
+                lexer.Relex(tokens, offset, removed, inserted);
+
+                Text = Text.Substring(0, offset) + inserted + Text.Substring(offset + removed);
+
+                ReferenceLexer reference = new ReferenceLexer();
+                string mode = $"edited at {offset}, {removed} character(s) replaced by {ReferenceLexer.Escape(inserted)}";
+
+                reference.Read(Text);
+                return Compare(mode, tokens, reference) ?? Compare(diagnostics, reference.Diagnostics);
+            }
+        }
+
+        private string Compare(string mode, TokenStream tokens, ReferenceLexer reference)
+        {
+            for (int i = 0; i < Math.Min(tokens.Count, reference.Tokens.Count); i++)
+            {
+                ReferenceToken expected = reference.Tokens[i];
+                Lexeme token = tokens[i];
+                string text = Describe(tokens, token, expected.Text == "Number");
+
+                if (token.Type != expected.Type || token.Offset != expected.Offset || token.Length != expected.Length || token.Line != expected.Line || token.Column != expected.Column || text != expected.Text)
+                {
+                    return $"{mode}: token {i} is {text} at {token.Offset}+{token.Length}, line {token.Line}, column {token.Column}, " +
+                        $"instead of {expected.Text} at {expected.Offset}+{expected.Length}, line {expected.Line}, column {expected.Column}";
+                }
+            }
+
+            if (tokens.Count != reference.Tokens.Count)
+                return $"{mode}: it has {tokens.Count} token(s) instead of {reference.Tokens.Count}";
+
+            return null;
+        }
+
+        private static string Compare(DiagnosticBag diagnostics, List<Diagnostic> expected)
+        {
+            for (int i = 0; i < Math.Min(diagnostics.Count, expected.Count); i++)
+            {
+                Diagnostic diagnostic = diagnostics.Items[i];
+
+                if (diagnostic.Code != expected[i].Code || diagnostic.Start != expected[i].Start || diagnostic.Length != expected[i].Length)
+                {
+                    return $"error {i} is {diagnostic.Code} at {diagnostic.Start}+{diagnostic.Length} " +
+                        $"instead of {expected[i].Code} at {expected[i].Start}+{expected[i].Length}";
+                }
+            }
+
+            if (diagnostics.Count != expected.Count)
+                return $"it has {diagnostics.Count} error(s) instead of {expected.Count}";
+
+            return null;
+        }
+
+        // The meaning of a token in the words of ReferenceLexer, the value of a number in error is left out
+        private string Describe(TokenStream tokens, Lexeme token, bool error)
+        {
+            switch (token.Type)
+            {
+                case Token.Keyword:
+                case Token.Integer:
+                    return $"{token.Type} {(Word)token.Value}";
+
+                case Token.Name:
+                    return "Name " + tokens.Names.GetText(token.Value);
+
+                case Token.Operator:
+                {
+                    char second = (char)(token.Value >> 16);
+                    return "Operator " + (char)(token.Value & 0xFFFF) + ((second != '\0') ? second.ToString() : "");
+                }
+
+                case Token.String:
+                    return "String " + ReferenceLexer.Escape(tokens.Strings.GetText(token.Value));
+
+                default:
+                {
+                    NumberLiteral literal = tokens.Numbers[token.Value];
+
+                    if (error)
+                        return "Number";
+
+                    return literal.IsFloat ? $"Float {literal.Value:X16}" : $"Integer {literal.Value} {literal.Type}";
+                }
+            }
+        }
+
+        // A sequence of tokens, blanks and commentaries
+        private string GenerateTokens()
+        {
+            StringBuilder builder = new StringBuilder();
+            int count = Random.Next(1, 200);
+
+            for (int i = 0; i < count; i++)
+            {
+                builder.Append(Fragment());
+
+                // Tokens are often glued together, which is where the rules meet
+                if (Random.Next(3) > 0)
+                    builder.Append(Pick(Blanks));
+            }
+
+            return builder.ToString();
+        }
+
+        // Removes, duplicates and inserts random ranges of a source, and sometimes cuts it short
+        private string Damage(string source)
+        {
+            StringBuilder builder = new StringBuilder(source);
+            int edits = Random.Next(1, 9);
+
+            for (int i = 0; i < edits; i++)
+            {
+                int offset = Random.Next(builder.Length + 1);
+                int length = Random.Next(Math.Min(32, builder.Length - offset) + 1);
+
+                switch (Random.Next(4))
+                {
+                    case 0:
+                        builder.Remove(offset, length);
+                        break;
+
+                    case 1:
+                        builder.Insert(offset, builder.ToString(offset, length));
+                        break;
+
+                    case 2:
+                        builder.Insert(offset, Fragment());
+                        break;
+
+                    default:
+                        builder.Length = offset;
+                        break;
+                }
+            }
+
+            return builder.ToString();
+        }
+
+        private string Fragment()
+        {
+            switch (Random.Next(10))
+            {
+                case 0:
+                {
+                    // Reserved words and the names close to them
+                    string word = Pick(Reserved);
+
+                    if (Random.Next(3) == 0)
+                        word = (Random.Next(2) == 0) ? word.Substring(0, Random.Next(1, word.Length)) : word + Pick(Suffixes);
+
+                    return (Random.Next(8) == 0) ? word.ToUpperInvariant() : word;
+                }
+
+                case 1:
+                    return Name();
+
+                case 2:
+                case 3:
+                    return Number();
+
+                case 4:
+                    return String();
+
+                case 5:
+                    return "//" + ((Random.Next(2) == 0) ? " " + Name() + " \"" + Pick(Escapes) : Pick(Others)) + Pick(new[] { "\n", "\r\n", "" });
+
+                case 6:
+                case 7:
+                    return Pick(Operators);
+
+                case 8:
+                    return Pick(Others);
+
+                default:
+                    return Pick(Blanks);
+            }
+        }
+
+        private string Name()
+        {
+            const string first = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+            StringBuilder builder = new StringBuilder().Append(first[Random.Next(first.Length)]);
+            int length = Random.Next(12);
+
+            for (int i = 0; i < length; i++)
+                builder.Append((Random.Next(4) == 0) ? (char)('0' + Random.Next(10)) : first[Random.Next(first.Length)]);
+
+            return builder.ToString();
+        }
+
+        private string Number()
+        {
+            StringBuilder builder = new StringBuilder();
+
+            switch (Random.Next(6))
+            {
+                case 0:
+                    builder.Append(Pick(Limits));
+                    break;
+
+                case 1:
+                    builder.Append((Random.Next(2) == 0) ? "0x" : "0X").Append(Digits("0123456789abcdefABCDEF_", Random.Next(0, 20)));
+                    break;
+
+                case 2:
+                    builder.Append((Random.Next(2) == 0) ? "0b" : "0B").Append(Digits("01_", Random.Next(0, 70)));
+                    break;
+
+                case 3:
+                {
+                    // Floats with many digits or large exponents leave the fast path of the lexer
+                    builder.Append(Digits("0123456789", Random.Next(1, 24)));
+
+                    if (Random.Next(4) > 0)
+                        builder.Append('.').Append(Digits("0123456789_", Random.Next(0, 24)));
+
+                    if (Random.Next(2) == 0)
+                        builder.Append(Pick(new[] { "e", "E" })).Append(Pick(new[] { "", "+", "-" })).Append(Digits("0123456789", Random.Next(0, 4)));
+
+                    break;
+                }
+
+                default:
+                    builder.Append(Random.Next(0, 1000));
+
+                    if (Random.Next(4) == 0)
+                        builder.Append('_').Append(Random.Next(0, 1000));
+
+                    break;
+            }
+
+            if (Random.Next(3) == 0)
+                builder.Append(Pick(Suffixes));
+
+            return builder.ToString();
+        }
+
+        private string String()
+        {
+            StringBuilder builder = new StringBuilder("\"");
+            int length = Random.Next(0, 16);
+
+            for (int i = 0; i < length; i++)
+            {
+                int kind = Random.Next(10);
+
+                if (kind < 6)
+                    builder.Append((char)Random.Next(' ', '~' + 1));
+
+                else if (kind < 8)
+                    builder.Append(Pick(Escapes));
+
+                else if (kind < 9)
+                    builder.Append(Pick(BadEscapes));
+
+                else
+                    builder.Append(Pick(Others));
+            }
+
+            if (Random.Next(10) > 0)
+                builder.Append('"');
+
+            return builder.ToString();
+        }
+
+        private string Digits(string digits, int length)
+        {
+            StringBuilder builder = new StringBuilder(length);
+
+            for (int i = 0; i < length; i++)
+                builder.Append(digits[Random.Next(digits.Length)]);
+
+            return builder.ToString();
+        }
+
+        private string Pick(string[] items)
+        {
+            return items[Random.Next(items.Length)];
+        }
+    }
+}
@@ -0,0 +1,285 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+
+namespace Sage.Benchmarks
+{
+    class Program
+    {
+        private const string Usage =
+            "Usage: Sage.Benchmarks [options]\n" +
+            "\n" +
+            "Options:\n" +
+            "  --sizes <list>        Corpus sizes, for example 64K,1M,16M (default)\n" +
+            "  --kinds <list>        Corpus kinds among Functions, Chains, Comments and Mixed (default: all)\n" +
+            "  --iterations <count>  Measured runs for every corpus (default: 10)\n" +
+            "  --keep                Keep the generated corpora in the temporary directory\n" +
+            "  --backends            Compare --run with the native backend instead of measuring the lexer\n" +
+            "  --depths <list>       Depths of the call trees of the backend programs (default: 12,16,20)\n" +
+            "  --fuzz <count>        Compare the lexer with the reference lexer over random sources\n" +
+            "  --seed <seed>         Seed of the random sources (default: 1234)\n" +
+            "  --check               Run the checks of the compiler over the sources written for them\n" +
+            "  --gate <file>         Fail when the lexer is slower than the baseline stored in the file\n" +
+            "  --tolerance <percent> Slowdown the gate accepts (default: 10)\n" +
+            "  --update-baseline     Store the measured speed as the new baseline of the gate";
+
+        private const int Seed = 1234;
+
+        // The corpus of the gate, large enough for a run to last a few milliseconds
+        private const CorpusKind GateKind = CorpusKind.Mixed;
+        private const int GateSize = 4 << 20;
+
+        static int Main(string[] args)
+        {
+            List<int> sizes = new List<int> { 64 << 10, 1 << 20, 16 << 20 };
+            List<CorpusKind> kinds = new List<CorpusKind>(Enum.GetValues<CorpusKind>());
+            int iterations = 10;
+            bool keep = false;
+            bool backends = false;
+            List<int> depths = new List<int> { 12, 16, 20 };
+            int fuzz = 0;
+            int seed = Seed;
+            bool check = false;
+            string baseline = null;
+            double tolerance = 10;
+            bool update = false;
+
+            try
+            {
+                for (int i = 0; i < args.Length; i++)
+                {
+                    switch (args[i])
+                    {
+                        case "--sizes":
+                            sizes = ParseList(args[++i], ParseSize);
+                            break;
+
+                        case "--kinds":
+                            kinds = ParseList(args[++i], text => Enum.Parse<CorpusKind>(text, true));
+                            break;
+
+                        case "--iterations":
+                            iterations = Math.Max(1, int.Parse(args[++i], CultureInfo.InvariantCulture));
+                            break;
+
+                        case "--keep":
+                            keep = true;
+                            break;
+
+                        case "--backends":
+                            backends = true;
+                            break;
+
+                        case "--depths":
+                            depths = ParseList(args[++i], text => int.Parse(text, CultureInfo.InvariantCulture));
+                            break;
+
+                        case "--fuzz":
+                            fuzz = Math.Max(1, int.Parse(args[++i], CultureInfo.InvariantCulture));
+                            break;
+
+                        case "--seed":
+                            seed = int.Parse(args[++i], CultureInfo.InvariantCulture);
+                            break;
+
+                        case "--check":
+                            check = true;
+                            break;
+
+                        case "--gate":
+                            baseline = args[++i];
+                            break;
+
+                        case "--tolerance":
+                            tolerance = double.Parse(args[++i], CultureInfo.InvariantCulture);
+                            break;
+
+                        case "--update-baseline":
+                            update = true;
+                            break;
+
+                        default:
+                            throw new ArgumentException($"Unknown option \"{args[i]}\".");
+                    }
+                }
+            }
+
+            catch (Exception exception) when (exception is ArgumentException || exception is FormatException || exception is OverflowException || exception is IndexOutOfRangeException)
+            {
+                Console.WriteLine($"[ERROR] {exception.Message}");
+                Console.WriteLine(Usage);
+                return 1;
+            }
+
+            string directory = Path.Combine(Path.GetTempPath(), "SageBenchmarks");
+            Directory.CreateDirectory(directory);
+
+            if (backends)
+                return RunBackends(directory, depths, iterations, keep);
+
+            if (check)
+                return (CompilerChecks.Run(directory) > 0) ? 1 : 0;
+
+            if (fuzz > 0)
+                return (new LexerFuzzer(seed, directory).Run(fuzz) > 0) ? 1 : 0;
+
+            if (baseline != null)
+                return RunGate(directory, baseline, tolerance, update, iterations);
+
+            LexerBenchmark benchmark = new LexerBenchmark(iterations);
+
+            Console.WriteLine($"{"Corpus",-20} {"Mode",-12} {"Size",10} {"Tokens",12} {"MB/s",10} {"Mtokens/s",10} {"B/token",10}");
+
+            foreach (CorpusKind kind in kinds)
+            {
+                foreach (int size in sizes)
+                {
+                    string fileName = CorpusGenerator.WriteFile(directory, kind, size, Seed);
+
+                    Print($"{kind} {FormatSize(size)}", benchmark.MeasureRead(fileName));
+                    Print($"{kind} {FormatSize(size)}", benchmark.MeasureLex(fileName));
+
+                    if (!keep)
+                        File.Delete(fileName);
+                }
+            }
+
+            return 0;
+        }
+
+        private static int RunBackends(string directory, List<int> depths, int iterations, bool keep)
+        {
+            BackendBenchmark benchmark = new BackendBenchmark(iterations, directory);
+            int errors = 0;
+
+            Console.WriteLine($"{"Program",-20} {"Mode",-12} {"Compile (ms)",14} {"Run (ms)",12} {"Total (ms)",12}");
+
+            foreach (int depth in depths)
+            {
+                string fileName = Path.Combine(directory, $"Calls{depth}.sg");
+                string corpus = $"{1L << depth} calls";
+
+                File.WriteAllText(fileName, BackendBenchmark.GenerateProgram(depth));
+
+                BackendResult run = benchmark.MeasureVirtualMachine(fileName);
+                BackendResult? native = benchmark.MeasureNative(fileName);
+
+                Print(corpus, run);
+
+                if (native == null)
+                    Console.WriteLine($"{corpus,-20} {"native",-12} the program could not be built");
+
+                else
+                {
+                    Print(corpus, native.Value);
+
+                    // Exit codes only keep the low 8 bits on some systems
+                    if ((run.ExitCode & 0xFF) != (native.Value.ExitCode & 0xFF))
+                    {
+                        Console.WriteLine($"[ERROR] The backends disagree on {corpus}: {run.ExitCode} and {native.Value.ExitCode}.");
+                        errors++;
+                    }
+                }
+
+                if (!keep)
+                    File.Delete(fileName);
+            }
+
+            return (errors > 0) ? 1 : 0;
+        }
+
+        // Compares the speed of the lexer over a fixed corpus with the one stored in the baseline. The speed depends on the
+        // machine, so every machine stores its own baseline with --update-baseline, and the gate fails without one.
+        private static int RunGate(string directory, string baseline, double tolerance, bool update, int iterations)
+        {
+            if (!update && !File.Exists(baseline))
+            {
+                Console.WriteLine($"[ERROR] The baseline \"{baseline}\" does not exist, run the gate with --update-baseline once to store the speed of this machine.");
+                return 1;
+            }
+
+            string fileName = CorpusGenerator.WriteFile(directory, GateKind, GateSize, Seed);
+            string corpus = $"{GateKind} {FormatSize(GateSize)}";
+            BenchmarkResult result = new LexerBenchmark(iterations).MeasureLex(fileName);
+
+            File.Delete(fileName);
+            Print(corpus, result);
+
+            if (update)
+            {
+                File.WriteAllText(baseline, $"# Tokens per second of the lexer over the {corpus} corpus\n{result.TokensPerSecond.ToString("F0", CultureInfo.InvariantCulture)}\n");
+                Console.WriteLine($"[INFO] Stored {result.TokensPerSecond / 1e6:F2} Mtokens/s as the baseline in \"{baseline}\".");
+                return 0;
+            }
+
+            double expected = 0;
+
+            foreach (string line in File.ReadAllLines(baseline))
+            {
+                if (line.Length > 0 && line[0] != '#')
+                    expected = double.Parse(line, CultureInfo.InvariantCulture);
+            }
+
+            double change = (result.TokensPerSecond / expected - 1) * 100;
+            string summary = string.Format(CultureInfo.InvariantCulture, "{0:F2} Mtokens/s against {1:F2} in the baseline ({2:+0.0;-0.0}%)", result.TokensPerSecond / 1e6, expected / 1e6, change);
+
+            if (change < -tolerance)
+            {
+                Console.WriteLine(string.Format(CultureInfo.InvariantCulture, "[ERROR] The lexer got slower than the baseline allows: {0}, more than {1}% below.", summary, tolerance));
+                return 1;
+            }
+
+            Console.WriteLine($"[INFO] The lexer keeps its speed: {summary}.");
+            return 0;
+        }
+
+        private static void Print(string corpus, BackendResult result)
+        {
+            Console.WriteLine(string.Format(CultureInfo.InvariantCulture, "{0,-20} {1,-12} {2,14:F1} {3,12:F1} {4,12:F1}",
+                corpus, result.Name, result.CompileSeconds * 1000, result.RunSeconds * 1000, (result.CompileSeconds + result.RunSeconds) * 1000));
+        }
+
+        private static void Print(string corpus, BenchmarkResult result)
+        {
+            Console.WriteLine(string.Format(CultureInfo.InvariantCulture, "{0,-20} {1,-12} {2,10} {3,12} {4,10:F1} {5,10:F2} {6,10:F2}",
+                corpus, result.Name, FormatSize(result.Bytes), result.Tokens, result.MegabytesPerSecond, result.TokensPerSecond / 1e6, result.AllocatedPerToken));
+        }
+
+        private static List<T> ParseList<T>(string text, Func<string, T> parse)
+        {
+            List<T> items = new List<T>();
+
+            foreach (string item in text.Split(','))
+                items.Add(parse(item.Trim()));
+
+            return items;
+        }
+
+        // Accepts plain byte counts or the K, M and G suffixes
+        private static int ParseSize(string text)
+        {
+            long scale = 1;
+            char suffix = char.ToUpperInvariant(text[text.Length - 1]);
+
+            if (suffix == 'K' || suffix == 'M' || suffix == 'G')
+            {
+                scale = (suffix == 'K') ? 1L << 10 : (suffix == 'M') ? 1L << 20 : 1L << 30;
+                text = text.Substring(0, text.Length - 1);
+            }
+
+            return checked((int)(long.Parse(text, CultureInfo.InvariantCulture) * scale));
+        }
+
+        private static string FormatSize(long bytes)
+        {
+            if (bytes >= 1 << 20)
+                return string.Format(CultureInfo.InvariantCulture, "{0:0.#}M", bytes / (double)(1 << 20));
+
+            if (bytes >= 1 << 10)
+                return string.Format(CultureInfo.InvariantCulture, "{0:0.#}K", bytes / (double)(1 << 10));
+
+            return bytes.ToString(CultureInfo.InvariantCulture);
+        }
+    }
+}
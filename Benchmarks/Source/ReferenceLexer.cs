@@ -0,0 +1,410 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.Numerics;
+using System.Text;
+
+namespace Sage.Benchmarks
+{
+    // A token of the reference lexer. Text describes its meaning the way LexerFuzzer describes the tokens of the lexer.
+    internal struct ReferenceToken
+    {
+        public Token Type;
+        public int Offset;
+        public int Length;
+        public int Line;
+        public int Column;
+        public string Text;
+    }
+
+    // A slow lexer written straight from the rules of the language, one character at a time and without any of the
+    // tables, vector searches and fast paths of Lexer. It only exists to be compared with it.
+    internal class ReferenceLexer
+    {
+        private struct Reserved
+        {
+            public Token Type;
+            public Word Word;
+
+            // The largest magnitude of a literal of an integer type, one more than the largest value of the signed
+            // ones, whose minimum is written negated
+            public ulong Max;
+        }
+
+        private static readonly Dictionary<string, Reserved> Words = new Dictionary<string, Reserved>
+        {
+            { "function", new Reserved { Type = Token.Keyword, Word = Word.Function } },
+            { "for", new Reserved { Type = Token.Keyword, Word = Word.For } },
+            { "if", new Reserved { Type = Token.Keyword, Word = Word.If } },
+            { "else", new Reserved { Type = Token.Keyword, Word = Word.Else } },
+            { "return", new Reserved { Type = Token.Keyword, Word = Word.Return } },
+            { "use", new Reserved { Type = Token.Keyword, Word = Word.Use } },
+            { "while", new Reserved { Type = Token.Keyword, Word = Word.While } },
+            { "i8", new Reserved { Type = Token.Integer, Word = Word.I8, Max = (ulong)sbyte.MaxValue + 1 } },
+            { "u8", new Reserved { Type = Token.Integer, Word = Word.U8, Max = byte.MaxValue } },
+            { "i16", new Reserved { Type = Token.Integer, Word = Word.I16, Max = (ulong)short.MaxValue + 1 } },
+            { "u16", new Reserved { Type = Token.Integer, Word = Word.U16, Max = ushort.MaxValue } },
+            { "i32", new Reserved { Type = Token.Integer, Word = Word.I32, Max = (ulong)int.MaxValue + 1 } },
+            { "u32", new Reserved { Type = Token.Integer, Word = Word.U32, Max = uint.MaxValue } },
+            { "i64", new Reserved { Type = Token.Integer, Word = Word.I64, Max = (ulong)long.MaxValue + 1 } },
+            { "u64", new Reserved { Type = Token.Integer, Word = Word.U64, Max = ulong.MaxValue } }
+        };
+
+        private static readonly string[] Operators = { "->", "::", "==", "<=", ">=", "!=", "-", "=", "<", ">", "+", "*", "/", ";", ",", "(", ")", "[", "]", "{", "}" };
+
+        private string Text;
+        private int Position;
+        private int Line;
+        private int LineStart;
+
+        public List<ReferenceToken> Tokens { get; private set; }
+        public List<Diagnostic> Diagnostics { get; private set; }
+
+        public static IEnumerable<string> ReservedWords
+        {
+            get { return Words.Keys; }
+        }
+
+        public void Read(string text)
+        {
+            Text = text;
+            Position = 0;
+            Line = 1;
+            LineStart = 0;
+            Tokens = new List<ReferenceToken>();
+            Diagnostics = new List<Diagnostic>();
+
+            while (Position < Text.Length)
+            {
+                char c = Text[Position];
+
+                if (c == '\n')
+                {
+                    Position++;
+                    Line++;
+                    LineStart = Position;
+                }
+
+                else if (c == ' ' || c == '\t' || c == '\r')
+                    Position++;
+
+                else if (StartsWith("//"))
+                {
+                    while (Position < Text.Length && Text[Position] != '\n')
+                        Position++;
+                }
+
+                else if (IsDigit(c))
+                    ReadNumber();
+
+                else if (IsWordChar(c))
+                    ReadWord();
+
+                else if (c == '"')
+                    ReadString();
+
+                else
+                    ReadOperator();
+            }
+        }
+
+        private void ReadWord()
+        {
+            int start = Position;
+
+            while (Position < Text.Length && IsWordChar(Text[Position]))
+                Position++;
+
+            string word = Text.Substring(start, Position - start);
+            Reserved reserved;
+
+            if (Words.TryGetValue(word, out reserved))
+                Add(reserved.Type, start, $"{reserved.Type} {reserved.Word}");
+
+            else
+                Add(Token.Name, start, "Name " + word);
+        }
+
+        // The characters that start no token are names of a single character
+        private void ReadOperator()
+        {
+            int start = Position;
+
+            foreach (string text in Operators)
+            {
+                if (StartsWith(text))
+                {
+                    Position += text.Length;
+                    Add(Token.Operator, start, "Operator " + text);
+                    return;
+                }
+            }
+
+            Position++;
+            Add(Token.Name, start, "Name " + Text[start]);
+        }
+
+        // Digits with underscores between them, a 0x or 0b prefix, a fraction or an exponent for the decimal numbers,
+        // and the name of an integer type for the numbers without either
+        private void ReadNumber()
+        {
+            int start = Position;
+            int radix = 10;
+
+            if (StartsWith("0x") || StartsWith("0X"))
+                radix = 16;
+
+            else if (StartsWith("0b") || StartsWith("0B"))
+                radix = 2;
+
+            if (radix != 10)
+                Position += 2;
+
+            BigInteger value = BigInteger.Zero;
+            bool digits = false;
+
+            for (; Position < Text.Length && (Text[Position] == '_' || DigitOf(Text[Position]) < radix); Position++)
+            {
+                if (Text[Position] != '_')
+                {
+                    value = value * radix + DigitOf(Text[Position]);
+                    digits = true;
+                }
+            }
+
+            bool valid = digits;
+            bool isFloat = false;
+            bool tooLarge = value > ulong.MaxValue;
+            double number = 0;
+
+            bool fraction = Position + 1 < Text.Length && Text[Position] == '.' && IsDigit(Text[Position + 1]);
+            bool exponent = Position < Text.Length && (Text[Position] == 'e' || Text[Position] == 'E');
+
+            if (radix == 10 && digits && (fraction || exponent))
+            {
+                isFloat = true;
+
+                if (fraction)
+                {
+                    Position++;
+
+                    while (Position < Text.Length && (IsDigit(Text[Position]) || Text[Position] == '_'))
+                        Position++;
+                }
+
+                if (Position < Text.Length && (Text[Position] == 'e' || Text[Position] == 'E'))
+                {
+                    Position++;
+
+                    if (Position < Text.Length && (Text[Position] == '+' || Text[Position] == '-'))
+                        Position++;
+
+                    valid = Position < Text.Length && IsDigit(Text[Position]);
+
+                    while (Position < Text.Length && IsDigit(Text[Position]))
+                        Position++;
+                }
+
+                if (valid)
+                {
+                    number = double.Parse(Text.Substring(start, Position - start).Replace("_", ""), NumberStyles.Float, CultureInfo.InvariantCulture);
+                    tooLarge = double.IsInfinity(number);
+                }
+            }
+
+            int suffix = Position;
+            Word type = Word.None;
+
+            while (Position < Text.Length && IsWordChar(Text[Position]))
+                Position++;
+
+            if (Position > suffix)
+            {
+                Reserved reserved;
+
+                if (!isFloat && Words.TryGetValue(Text.Substring(suffix, Position - suffix), out reserved) && reserved.Type == Token.Integer)
+                {
+                    type = reserved.Word;
+                    tooLarge |= value > reserved.Max;
+                }
+
+                else
+                    valid = false;
+            }
+
+            // The value of a number in error is not part of the rules
+            string meaning = "Number";
+
+            if (!valid)
+                Error(DiagnosticCode.InvalidNumber, start);
+
+            else if (tooLarge)
+                Error(DiagnosticCode.NumberTooLarge, start);
+
+            else if (isFloat)
+                meaning = $"Float {BitConverter.DoubleToInt64Bits(number):X16}";
+
+            else
+                meaning = $"Integer {value} {type}";
+
+            Add(Token.Number, start, meaning);
+        }
+
+        // A string ends with its quote, or unterminated with its line or the text. A backslash takes the character
+        // after it, unless that is the line break.
+        private void ReadString()
+        {
+            int start = Position++;
+
+            while (Position < Text.Length && Text[Position] != '"' && Text[Position] != '\n')
+            {
+                if (Text[Position] == '\\' && Position + 1 < Text.Length && Text[Position + 1] != '\n')
+                    Position += 2;
+
+                else
+                    Position++;
+            }
+
+            int end = Position;
+            bool closed = Position < Text.Length && Text[Position] == '"';
+
+            if (closed)
+                Position++;
+
+            // The errors of a string refer to the whole literal, which is only known once its end is
+            int length = Position - start;
+            List<DiagnosticCode> errors = new List<DiagnosticCode>();
+            StringBuilder decoded = new StringBuilder();
+
+            if (!closed)
+                errors.Add(DiagnosticCode.UnterminatedString);
+
+            for (int i = start + 1; i < end; i++)
+            {
+                if (Text[i] != '\\')
+                {
+                    decoded.Append(Text[i]);
+                    continue;
+                }
+
+                // A backslash ending an unterminated string is part of its error
+                if (++i == end)
+                {
+                    if (closed)
+                        errors.Add(DiagnosticCode.InvalidEscape);
+
+                    break;
+                }
+
+                char c = Text[i];
+
+                if (c == 'n' || c == 'r' || c == 't' || c == '0' || c == '\\' || c == '"' || c == '\'')
+                    decoded.Append((c == 'n') ? '\n' : (c == 'r') ? '\r' : (c == 't') ? '\t' : (c == '0') ? '\0' : c);
+
+                else if (c == 'x' || c == 'u')
+                    i = ReadCode(i, end, c == 'u', decoded, errors);
+
+                else
+                    errors.Add(DiagnosticCode.InvalidEscape);
+            }
+
+            foreach (DiagnosticCode code in errors)
+                Diagnostics.Add(new Diagnostic { Code = code, File = -1, Start = start, Length = length });
+
+            Add(Token.String, start, "String " + Escape(decoded.ToString()));
+        }
+
+        // \xHH with one or two digits, or \u{H} with one to six. The character after the backslash and u is taken as
+        // the brace even when it is not one, as is the character after the digits.
+        private int ReadCode(int i, int end, bool braces, StringBuilder decoded, List<DiagnosticCode> errors)
+        {
+            if (braces)
+            {
+                bool brace = i + 1 < end && Text[i + 1] == '{';
+
+                if (i + 1 < end)
+                    i++;
+
+                if (!brace)
+                {
+                    errors.Add(DiagnosticCode.ExpectedUnicodeBrace);
+                    return i;
+                }
+            }
+
+            int code = 0;
+            int digits = 0;
+
+            while (i + 1 < end && digits < (braces ? 6 : 2) && Uri.IsHexDigit(Text[i + 1]))
+            {
+                code = code * 16 + DigitOf(Text[++i]);
+                digits++;
+            }
+
+            if (braces)
+            {
+                if (i + 1 >= end || Text[i + 1] != '}')
+                    digits = 0;
+
+                if (i + 1 < end)
+                    i++;
+            }
+
+            if (digits == 0 || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+                errors.Add(DiagnosticCode.InvalidEscape);
+
+            else
+                decoded.Append(char.ConvertFromUtf32(code));
+
+            return i;
+        }
+
+        private void Add(Token type, int start, string text)
+        {
+            Tokens.Add(new ReferenceToken { Type = type, Offset = start, Length = Position - start, Line = Line, Column = start - LineStart + 1, Text = text });
+        }
+
+        private void Error(DiagnosticCode code, int start)
+        {
+            Diagnostics.Add(new Diagnostic { Code = code, File = -1, Start = start, Length = Position - start });
+        }
+
+        private bool StartsWith(string text)
+        {
+            return Position + text.Length <= Text.Length && string.CompareOrdinal(Text, Position, text, 0, text.Length) == 0;
+        }
+
+        private static bool IsDigit(char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+
+        private static bool IsWordChar(char c)
+        {
+            return c == '_' || IsDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        }
+
+        // The value of a digit of any radix up to 16, or 99
+        private static int DigitOf(char c)
+        {
+            return IsDigit(c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 99;
+        }
+
+        // Writes the characters outside of printable ASCII as codes, so the messages of the fuzzer stay on one line
+        public static string Escape(string text)
+        {
+            StringBuilder builder = new StringBuilder(text.Length + 2).Append('"');
+
+            foreach (char c in text)
+            {
+                if (c >= ' ' && c <= '~' && c != '"' && c != '\\')
+                    builder.Append(c);
+
+                else
+                    builder.Append($"\\u{(int)c:X4}");
+            }
+
+            return builder.Append('"').ToString();
+        }
+    }
+}
@@ -0,0 +1,4 @@
+﻿using System.Runtime.CompilerServices;
+
+// The benchmarks measure the internal lexer directly
+[assembly: InternalsVisibleTo("Sage.Benchmarks")]
@@ -0,0 +1,230 @@
+﻿namespace Sage
+{
+    // Checks a module once the modules it uses were analyzed, so their functions are known
+    internal class Analyzer
+    {
+        private readonly ModuleGraph Graph;
+
+        public Analyzer(ModuleGraph graph)
+        {
+            Graph = graph;
+        }
+
+        public void Analyze(Module module)
+        {
+            if (module.IsRuntime)
+                return;
+
+            Ast tree = module.Tree;
+            Node[] nodes = tree.Nodes;
+
+            for (int item = nodes[tree.Root].Left; item >= 0; item = nodes[item].Next)
+            {
+                if (nodes[item].Kind != NodeKind.Function)
+                    continue;
+
+                int name = tree.Tokens[nodes[item].Token].Value;
+
+                if (module.Functions.ContainsKey(name))
+                    ModuleGraph.Error(module, nodes[item].Token, DiagnosticCode.FunctionDefinedTwice);
+
+                else
+                    module.Functions.Add(name, item);
+            }
+
+            for (int node = 0; node < tree.Count; node++)
+            {
+                if (nodes[node].Kind == NodeKind.Call)
+                    CheckCall(module, nodes[nodes[node].Left]);
+            }
+
+            ResolveVariables(module);
+            new TypeChecker(Graph).Check(module);
+        }
+
+        // Binds every use of a variable to the node of its parameter or declaration, in Module.Bindings.
+        // The table is shared by the functions of the module, as each one starts with an empty table.
+        private void ResolveVariables(Module module)
+        {
+            Ast tree = module.Tree;
+            Node[] nodes = tree.Nodes;
+            SymbolTable symbols = new SymbolTable();
+
+            module.Bindings = new int[tree.Count];
+
+            for (int i = 0; i < tree.Count; i++)
+                module.Bindings[i] = -1;
+
+            for (int item = nodes[tree.Root].Left; item >= 0; item = nodes[item].Next)
+            {
+                if (nodes[item].Kind != NodeKind.Function)
+                    continue;
+
+                symbols.Clear();
+
+                // The parameters and the outermost block of the body share a scope, so the body cannot hide them
+                int scope = symbols.Push();
+
+                for (int parameter = nodes[item].Left; parameter >= 0; parameter = nodes[parameter].Next)
+                    Declare(module, symbols, parameter);
+
+                ResolveStatements(module, symbols, nodes[item].Right);
+                symbols.Pop(scope);
+            }
+        }
+
+        private void ResolveStatements(Module module, SymbolTable symbols, int block)
+        {
+            Node[] nodes = module.Tree.Nodes;
+
+            for (int node = nodes[block].Left; node >= 0; node = nodes[node].Next)
+                ResolveStatement(module, symbols, node);
+        }
+
+        private void ResolveStatement(Module module, SymbolTable symbols, int node)
+        {
+            Node statement = module.Tree.Nodes[node];
+
+            switch (statement.Kind)
+            {
+                case NodeKind.Block:
+                    int scope = symbols.Push();
+                    ResolveStatements(module, symbols, node);
+                    symbols.Pop(scope);
+                    break;
+
+                // The initial value is resolved first, as it cannot refer to the variable it initializes
+                case NodeKind.Declaration:
+                    if (statement.Left >= 0)
+                        ResolveExpression(module, symbols, statement.Left);
+
+                    Declare(module, symbols, node);
+                    break;
+
+                case NodeKind.Assignment:
+                    Bind(module, symbols, node);
+                    ResolveExpression(module, symbols, statement.Left);
+
+                    if (statement.Right >= 0)
+                        ResolveExpression(module, symbols, statement.Right);
+
+                    break;
+
+                case NodeKind.Return:
+                case NodeKind.Expression:
+                    if (statement.Left >= 0)
+                        ResolveExpression(module, symbols, statement.Left);
+
+                    break;
+
+                case NodeKind.If:
+                    ResolveExpression(module, symbols, statement.Left);
+                    ResolveStatement(module, symbols, statement.Right);
+
+                    if (statement.Extra >= 0)
+                        ResolveStatement(module, symbols, statement.Extra);
+
+                    break;
+
+                case NodeKind.While:
+                    if (statement.Left >= 0)
+                        ResolveExpression(module, symbols, statement.Left);
+
+                    ResolveStatement(module, symbols, statement.Right);
+                    break;
+            }
+        }
+
+        private void ResolveExpression(Module module, SymbolTable symbols, int node)
+        {
+            Node[] nodes = module.Tree.Nodes;
+            Node expression = nodes[node];
+
+            switch (expression.Kind)
+            {
+                // Paths name functions, the lowering reports the ones used as variables
+                case NodeKind.Name:
+                    if (expression.Extra == expression.Token)
+                        Bind(module, symbols, node);
+
+                    break;
+
+                case NodeKind.Negate:
+                    ResolveExpression(module, symbols, expression.Left);
+                    break;
+
+                case NodeKind.Binary:
+                case NodeKind.Compare:
+                case NodeKind.Index:
+                    ResolveExpression(module, symbols, expression.Left);
+                    ResolveExpression(module, symbols, expression.Right);
+                    break;
+
+                case NodeKind.Call:
+                    for (int argument = expression.Right; argument >= 0; argument = nodes[argument].Next)
+                        ResolveExpression(module, symbols, argument);
+
+                    break;
+            }
+        }
+
+        private void Declare(Module module, SymbolTable symbols, int node)
+        {
+            int token = module.Tree.Nodes[node].Token;
+
+            if (!symbols.Declare(module.Tree.Tokens[token].Value, node))
+                ModuleGraph.Error(module, token, DiagnosticCode.VariableDefinedTwice);
+        }
+
+        private void Bind(Module module, SymbolTable symbols, int node)
+        {
+            int token = module.Tree.Nodes[node].Token;
+            int declaration;
+
+            if (symbols.TryFind(module.Tree.Tokens[token].Value, out declaration))
+                module.Bindings[node] = declaration;
+
+            else
+                ModuleGraph.Error(module, token, DiagnosticCode.UnknownVariable);
+        }
+
+        // Name() calls a function of the module, Module::Name() one of a module it uses
+        private void CheckCall(Module module, Node callee)
+        {
+            Ast tree = module.Tree;
+            int function = tree.Tokens[callee.Extra].Value;
+
+            if (callee.Token == callee.Extra)
+            {
+                if (!module.Functions.ContainsKey(function))
+                    ModuleGraph.Error(module, callee.Token, DiagnosticCode.UnknownFunction);
+
+                return;
+            }
+
+            string name = ModuleGraph.PathOf(tree, callee.Token, callee.Extra - 2);
+            int target = Graph.Find(name);
+
+            if (target < 0)
+            {
+                ModuleGraph.Error(module, callee.Token, callee.Extra - 2, DiagnosticCode.UnknownModule);
+                return;
+            }
+
+            Module other = Graph.Modules[target];
+
+            if (other != module && !module.Dependencies.Contains(target))
+            {
+                // The functions of a module used through a cycle may not be known yet, the cycle is already reported
+                if (!module.Uses.Exists(use => use.Target == target))
+                    ModuleGraph.Error(module, callee.Token, callee.Extra - 2, DiagnosticCode.ModuleNotUsed);
+
+                return;
+            }
+
+            // The functions of the runtime are bound when the program is linked
+            if (!other.IsRuntime && !other.Functions.ContainsKey(function))
+                ModuleGraph.Error(module, callee.Extra, DiagnosticCode.UnknownFunctionInModule, name);
+        }
+    }
+}
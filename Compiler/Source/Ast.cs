@@ -0,0 +1,172 @@
+﻿using System;
+using System.IO;
+
+namespace Sage
+{
+    // Meaning of the fields of a node for every kind, unused fields are -1
+    enum NodeKind : byte
+    {
+        // Left: first item
+        Module = 0,
+
+        // Token: first name of the path, Extra: last name of the path
+        Use,
+
+        // Token: name, Left: first parameter, Right: body, Extra: return type token
+        Function,
+
+        // Token: name, Extra: type token
+        Parameter,
+
+        // Token: opening brace, Left: first statement
+        Block,
+
+        // Token: name, Left: initial value, Right: the length of an array, a number node, or -1, Extra: type token
+        Declaration,
+
+        // Token: name, Left: value, Right: the index of the element assigned in an array, or -1
+        Assignment,
+
+        // Token: keyword, Left: value
+        Return,
+
+        // Token: keyword, Left: condition, Right: block run when it holds, Extra: the block or the if run otherwise, or -1
+        If,
+
+        // Token: keyword, Left: condition, or -1 for a loop without an end, Right: body.
+        // The for loops are parsed as the block of their initializer and of the while loop they stand for.
+        While,
+
+        // Token: first token, Left: expression
+        Expression,
+
+        // Token: operator, Left and Right: operands
+        Binary,
+
+        // Token: operator, Left: operand
+        Negate,
+
+        // Token: operator, Left and Right: operands, only found as the condition of an if or a while
+        Compare,
+
+        // Token: opening parenthesis, Left: callee, Right: first argument
+        Call,
+
+        // Token: opening bracket, Left: the name of the array, Right: index
+        Index,
+
+        // Token: first name of the path, Extra: last name of the path
+        Name,
+
+        // Token: literal
+        Number,
+
+        // Token: literal
+        String
+    }
+
+    internal struct Node
+    {
+        public NodeKind Kind;
+        public int Token;
+        public int Left;
+        public int Right;
+        public int Extra;
+
+        // Next node of the same list, such as the following statement of a block
+        public int Next;
+    }
+
+    // The syntax tree of a source, every node lives in one array and refers to the others by index
+    internal class Ast
+    {
+        private static readonly string[] KindNames = Enum.GetNames<NodeKind>();
+
+        public TokenStream Tokens { get; private set; }
+        public Node[] Nodes { get; private set; }
+        public int Count { get; private set; }
+
+        // The module node, which is always the first one
+        public int Root
+        {
+            get { return 0; }
+        }
+
+        public Ast(TokenStream tokens)
+        {
+            Tokens = tokens;
+
+            // Most statements take about two tokens for each node
+            Nodes = new Node[Math.Max(16, tokens.Count / 2)];
+        }
+
+        // Builds a tree from nodes that were already parsed, such as the ones of the cache
+        public Ast(TokenStream tokens, Node[] nodes, int count)
+        {
+            Tokens = tokens;
+            Nodes = nodes;
+            Count = count;
+        }
+
+        public int Add(NodeKind kind, int token)
+        {
+            if (Count == Nodes.Length)
+            {
+                Node[] nodes = new Node[Nodes.Length * 2];
+                Array.Copy(Nodes, nodes, Count);
+                Nodes = nodes;
+            }
+
+            Nodes[Count] = new Node { Kind = kind, Token = token, Left = -1, Right = -1, Extra = -1, Next = -1 };
+            return Count++;
+        }
+
+        public void Dump(TextWriter writer)
+        {
+            if (Count > 0)
+                Dump(writer, Root, 0);
+        }
+
+        private void Dump(TextWriter writer, int node, int depth)
+        {
+            for (; node >= 0; node = Nodes[node].Next)
+            {
+                Node current = Nodes[node];
+
+                writer.Write(new string(' ', depth * 2));
+                writer.Write(KindNames[(int)current.Kind]);
+
+                if (current.Kind != NodeKind.Module && current.Token >= 0 && current.Token < Tokens.Count)
+                {
+                    writer.Write(" \"");
+
+                    // Paths are written from their first to their last name
+                    if ((current.Kind == NodeKind.Name || current.Kind == NodeKind.Use) && current.Extra > current.Token)
+                        Tokens.WriteText(writer, current.Token, current.Extra);
+
+                    else
+                        Tokens.WriteText(writer, current.Token, current.Token);
+
+                    writer.Write('"');
+
+                    if ((current.Kind == NodeKind.Function || current.Kind == NodeKind.Parameter || current.Kind == NodeKind.Declaration) && current.Extra >= 0)
+                    {
+                        writer.Write(" : ");
+                        Tokens.WriteText(writer, current.Extra, current.Extra);
+                    }
+                }
+
+                writer.WriteLine();
+
+                if (current.Left >= 0)
+                    Dump(writer, current.Left, depth + 1);
+
+                if (current.Right >= 0)
+                    Dump(writer, current.Right, depth + 1);
+
+                if (current.Kind == NodeKind.If && current.Extra >= 0)
+                    Dump(writer, current.Extra, depth + 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+﻿using System.Collections.Generic;
+
+namespace Sage
+{
+    // The instructions of a block, from its label or the start of the function to the next label
+    internal struct IrBlock
+    {
+        public int Start;
+        public int End;
+    }
+
+    // Orders the blocks of a function after the counts of its profile, so the code that runs the most is contiguous.
+    // Starting from the entry, every block is followed by its hottest successor not laid out yet, and once a chain
+    // has none the next one starts at the first block left in the order of the code. The blocks that never ran go
+    // after all the others, still in the order of the code.
+    internal static class BlockLayout
+    {
+        public static IrBlock[] Order(IrFunction function)
+        {
+            Instruction[] code = function.Code;
+            List<IrBlock> blocks = new List<IrBlock>();
+            int[] indices = new int[function.BlockCount];
+
+            for (int start = 0, i = 1; i <= function.Count; i++)
+            {
+                if (i < function.Count && code[i].Op != Opcode.Label)
+                    continue;
+
+                if (code[start].Op == Opcode.Label)
+                    indices[(int)code[start].Value] = blocks.Count;
+
+                blocks.Add(new IrBlock { Start = start, End = i });
+                start = i;
+            }
+
+            long[] counts = new long[blocks.Count];
+
+            for (int i = 0; i < counts.Length; i++)
+                counts[i] = (code[blocks[i].Start].Op == Opcode.Label) ? function.CountOf((int)code[blocks[i].Start].Value) : function.EntryCount;
+
+            List<IrBlock> order = new List<IrBlock>(blocks.Count);
+            bool[] placed = new bool[blocks.Count];
+            int[] successors = new int[2];
+            int warm = 0;
+            int cold = 0;
+            int current = (blocks.Count > 0) ? 0 : -1;
+
+            while (current >= 0)
+            {
+                placed[current] = true;
+                order.Add(blocks[current]);
+
+                // The block falling through comes first, so it stays next when both successors are as hot
+                int next = -1;
+                int count = SuccessorsOf(code, blocks, indices, current, successors);
+
+                for (int i = 0; i < count; i++)
+                {
+                    int successor = successors[i];
+
+                    if (!placed[successor] && counts[successor] > 0 && (next < 0 || counts[successor] > counts[next]))
+                        next = successor;
+                }
+
+                while (warm < blocks.Count && (placed[warm] || counts[warm] == 0))
+                    warm++;
+
+                while (cold < blocks.Count && placed[cold])
+                    cold++;
+
+                if (next < 0)
+                    next = (warm < blocks.Count) ? warm : (cold < blocks.Count) ? cold : -1;
+
+                current = next;
+            }
+
+            return order.ToArray();
+        }
+
+        private static int SuccessorsOf(Instruction[] code, List<IrBlock> blocks, int[] indices, int block, int[] successors)
+        {
+            Instruction last = code[blocks[block].End - 1];
+            int count = 0;
+
+            if (last.Op != Opcode.Jump && last.Op != Opcode.Return && block + 1 < blocks.Count)
+                successors[count++] = block + 1;
+
+            if (last.Op == Opcode.Jump || last.Op == Opcode.Branch)
+                successors[count++] = indices[(int)last.Value];
+
+            return count;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+﻿using System.Collections.Generic;
+
+namespace Sage
+{
+    // Keeps a few large arrays alive, so reading many sources does not allocate a buffer for each of them
+    internal static class BufferPool<T>
+    {
+        private const int MinimumLength = 4096;
+        private const int BucketCount = 19;
+        private const int MaximumRetained = 8;
+
+        private static readonly Stack<T[]>[] Buckets = CreateBuckets();
+
+        private static Stack<T[]>[] CreateBuckets()
+        {
+            Stack<T[]>[] buckets = new Stack<T[]>[BucketCount];
+
+            for (int i = 0; i < BucketCount; i++)
+                buckets[i] = new Stack<T[]>();
+
+            return buckets;
+        }
+
+        // Returns an array with at least the requested length
+        public static T[] Rent(int length)
+        {
+            int bucket = BucketOf(length);
+
+            if (bucket >= BucketCount)
+                return new T[length];
+
+            Stack<T[]> stack = Buckets[bucket];
+
+            lock (stack)
+            {
+                if (stack.Count > 0)
+                    return stack.Pop();
+            }
+
+            return new T[MinimumLength << bucket];
+        }
+
+        public static void Return(T[] array)
+        {
+            if (array == null)
+                return;
+
+            int bucket = BucketOf(array.Length);
+
+            // Only arrays handed out by Rent have an exact bucket size
+            if (bucket >= BucketCount || array.Length != MinimumLength << bucket)
+                return;
+
+            Stack<T[]> stack = Buckets[bucket];
+
+            lock (stack)
+            {
+                if (stack.Count < MaximumRetained)
+                    stack.Push(array);
+            }
+        }
+
+        private static int BucketOf(int length)
+        {
+            int bucket = 0;
+
+            while (bucket < BucketCount && (MinimumLength << bucket) < length)
+                bucket++;
+
+            return bucket;
+        }
+    }
+}
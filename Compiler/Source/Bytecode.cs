@@ -0,0 +1,345 @@
+﻿using System.Collections.Generic;
+
+namespace Sage
+{
+    // Instructions of the virtual machine, followed in the code by their operands. Slots are relative to the frame
+    // of the function, and every value is held in a 64 bit slot the way the native backend holds it in a register.
+    enum BytecodeOp
+    {
+        // Target, low and high 32 bits of the value
+        Constant = 0,
+
+        // Target, source
+        Move,
+
+        // Target, source: extends the low bits of the source over the whole slot
+        SignExtend8,
+        SignExtend16,
+        SignExtend32,
+        ZeroExtend8,
+        ZeroExtend16,
+        ZeroExtend32,
+
+        // Target, left and right operands, on whole slots
+        Add,
+        Subtract,
+        Multiply,
+        DivideSigned,
+        DivideUnsigned,
+
+        // Target, source
+        Negate,
+
+        // Target, left and right operands: sets the target to 1 when the comparison holds and to 0 otherwise. The
+        // greater comparisons are the lesser ones with their operands swapped.
+        Equal,
+        NotEqual,
+        LessSigned,
+        LessEqualSigned,
+        LessUnsigned,
+        LessEqualUnsigned,
+
+        // Position in the code of the function
+        Jump,
+
+        // Source, position: jumps when the source is zero
+        JumpIfZero,
+
+        // Target or -1, index of the callee, number of arguments, then the slot of every argument
+        Call,
+
+        // Target, first slot and length of the array, index: faults when the index is out of the array
+        Load,
+
+        // First slot and length of the array, index, value
+        Store,
+
+        // First slot and length of the array
+        Clear,
+
+        // Index of the constant string, written to the output of the machine
+        Write,
+
+        // Source
+        Return,
+
+        // No operand
+        ReturnNothing
+    }
+
+    internal class BytecodeFunction
+    {
+        public string Name;
+        public int[] Code;
+        public string[] Strings;
+
+        // Number of slots of a frame, the parameters take the first ones
+        public int FrameSize;
+    }
+
+    // Compiles the code of the backend to the bytecode of the virtual machine, one slot for every register that is used
+    // and one for every element of the arrays
+    internal class BytecodeCompiler
+    {
+        private readonly List<int> Code = new List<int>();
+        private readonly Dictionary<string, int> Indices = new Dictionary<string, int>();
+        private int[] Slots;
+        private int SlotCount;
+
+        // First slot of every array, after the parameters
+        private int[] Arrays;
+
+        // Position of every block, and the operands of the jumps to patch with them
+        private int[] Blocks;
+        private readonly List<int> Jumps = new List<int>();
+
+        // The functions of the program, in the order of the given functions
+        public BytecodeFunction[] Compile(List<IrFunction> functions)
+        {
+            BytecodeFunction[] compiled = new BytecodeFunction[functions.Count];
+
+            for (int i = 0; i < functions.Count; i++)
+                Indices[functions[i].Name] = i;
+
+            for (int i = 0; i < functions.Count; i++)
+                compiled[i] = CompileFunction(functions[i]);
+
+            return compiled;
+        }
+
+        public int IndexOf(string name)
+        {
+            int index;
+            return Indices.TryGetValue(name, out index) ? index : -1;
+        }
+
+        private BytecodeFunction CompileFunction(IrFunction function)
+        {
+            function = function.WithoutPhis();
+
+            Code.Clear();
+            Jumps.Clear();
+            Blocks = new int[function.BlockCount];
+            Slots = new int[function.Registers.Count];
+            SlotCount = function.Parameters.Length;
+
+            for (int i = 0; i < Slots.Length; i++)
+                Slots[i] = -1;
+
+            Arrays = new int[function.Arrays.Count];
+
+            for (int i = 0; i < Arrays.Length; i++)
+            {
+                Arrays[i] = SlotCount;
+                SlotCount += function.Arrays[i].Length;
+            }
+
+            // The caller writes the arguments in the first slots of the frame
+            for (int i = 0; i < function.Count; i++)
+            {
+                if (function.Code[i].Op == Opcode.Parameter)
+                    Slots[function.Code[i].Target] = (int)function.Code[i].Value;
+            }
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                Instruction instruction = function.Code[i];
+
+                switch (instruction.Op)
+                {
+                    case Opcode.Constant:
+                        Emit(BytecodeOp.Constant, Slot(instruction.Target));
+                        Code.Add((int)instruction.Value);
+                        Code.Add((int)(instruction.Value >> 32));
+                        break;
+
+                    case Opcode.Copy:
+                        Emit(BytecodeOp.Move, Slot(instruction.Target), Slot(instruction.Left));
+                        break;
+
+                    case Opcode.Convert:
+                    {
+                        int target = Slot(instruction.Target);
+
+                        if (Keywords.SizeOf(instruction.Type) == 8)
+                            Emit(BytecodeOp.Move, target, Slot(instruction.Left));
+
+                        else
+                            Emit(ExtendOf(instruction.Type), target, Slot(instruction.Left));
+
+                        break;
+                    }
+
+                    case Opcode.Add:
+                        EmitBinary(BytecodeOp.Add, instruction);
+                        break;
+
+                    case Opcode.Subtract:
+                        EmitBinary(BytecodeOp.Subtract, instruction);
+                        break;
+
+                    case Opcode.Multiply:
+                        EmitBinary(BytecodeOp.Multiply, instruction);
+                        break;
+
+                    case Opcode.Divide:
+                        EmitBinary(Keywords.IsSigned(instruction.Type) ? BytecodeOp.DivideSigned : BytecodeOp.DivideUnsigned, instruction);
+                        break;
+
+                    case Opcode.Negate:
+                    {
+                        int target = Slot(instruction.Target);
+
+                        Emit(BytecodeOp.Negate, target, Slot(instruction.Left));
+                        Wrap(target, instruction.Type);
+                        break;
+                    }
+
+                    case Opcode.Equal:
+                        EmitCompare(BytecodeOp.Equal, instruction, false);
+                        break;
+
+                    case Opcode.NotEqual:
+                        EmitCompare(BytecodeOp.NotEqual, instruction, false);
+                        break;
+
+                    case Opcode.Less:
+                        EmitCompare(Keywords.IsSigned(instruction.Type) ? BytecodeOp.LessSigned : BytecodeOp.LessUnsigned, instruction, false);
+                        break;
+
+                    case Opcode.LessEqual:
+                        EmitCompare(Keywords.IsSigned(instruction.Type) ? BytecodeOp.LessEqualSigned : BytecodeOp.LessEqualUnsigned, instruction, false);
+                        break;
+
+                    case Opcode.Greater:
+                        EmitCompare(Keywords.IsSigned(instruction.Type) ? BytecodeOp.LessSigned : BytecodeOp.LessUnsigned, instruction, true);
+                        break;
+
+                    case Opcode.GreaterEqual:
+                        EmitCompare(Keywords.IsSigned(instruction.Type) ? BytecodeOp.LessEqualSigned : BytecodeOp.LessEqualUnsigned, instruction, true);
+                        break;
+
+                    case Opcode.Label:
+                        Blocks[(int)instruction.Value] = Code.Count;
+                        break;
+
+                    case Opcode.Jump:
+                        Emit(BytecodeOp.Jump, (int)instruction.Value);
+                        Jumps.Add(Code.Count - 1);
+                        break;
+
+                    case Opcode.Branch:
+                        Emit(BytecodeOp.JumpIfZero, Slot(instruction.Left), (int)instruction.Value);
+                        Jumps.Add(Code.Count - 1);
+                        break;
+
+                    case Opcode.Call:
+                        Emit(BytecodeOp.Call, (instruction.Target >= 0) ? Slot(instruction.Target) : -1);
+                        Code.Add(Indices[function.Callees[(int)instruction.Value]]);
+                        Code.Add(instruction.Right);
+
+                        for (int argument = 0; argument < instruction.Right; argument++)
+                            Code.Add(Slot(function.Arguments[instruction.Left + argument]));
+
+                        break;
+
+                    case Opcode.Load:
+                    {
+                        int array = (int)instruction.Value;
+                        Emit(BytecodeOp.Load, Slot(instruction.Target), Arrays[array], function.Arrays[array].Length, Slot(instruction.Left));
+                        break;
+                    }
+
+                    case Opcode.Store:
+                    {
+                        int array = (int)instruction.Value;
+                        Emit(BytecodeOp.Store, Arrays[array], function.Arrays[array].Length, Slot(instruction.Left), Slot(instruction.Right));
+                        break;
+                    }
+
+                    case Opcode.Clear:
+                        Emit(BytecodeOp.Clear, Arrays[(int)instruction.Value], function.Arrays[(int)instruction.Value].Length);
+                        break;
+
+                    // The machine has no vectors, the loop after the kernel goes over all the elements from its start
+                    case Opcode.Kernel:
+                        Emit(BytecodeOp.Move, Slot(instruction.Target), Slot(function.Arguments[instruction.Left]));
+                        break;
+
+                    case Opcode.Write:
+                        Emit(BytecodeOp.Write, (int)instruction.Value);
+                        break;
+
+                    case Opcode.Return:
+                        if (instruction.Left >= 0)
+                            Emit(BytecodeOp.Return, Slot(instruction.Left));
+
+                        else
+                            Emit(BytecodeOp.ReturnNothing);
+
+                        break;
+                }
+            }
+
+            // The jumps forward are only known once their block was compiled
+            foreach (int jump in Jumps)
+                Code[jump] = Blocks[Code[jump]];
+
+            return new BytecodeFunction { Name = function.Name, Code = Code.ToArray(), Strings = function.Strings.ToArray(), FrameSize = SlotCount };
+        }
+
+        private void EmitCompare(BytecodeOp op, Instruction instruction, bool swapped)
+        {
+            int left = Slot(instruction.Left);
+            int right = Slot(instruction.Right);
+
+            Emit(op, Slot(instruction.Target), swapped ? right : left, swapped ? left : right);
+        }
+
+        private void EmitBinary(BytecodeOp op, Instruction instruction)
+        {
+            int target = Slot(instruction.Target);
+
+            Emit(op, target, Slot(instruction.Left), Slot(instruction.Right));
+            Wrap(target, instruction.Type);
+        }
+
+        // Results of types smaller than a slot are extended again from their low bits
+        private void Wrap(int slot, Word type)
+        {
+            if (Keywords.SizeOf(type) < 8)
+                Emit(ExtendOf(type), slot, slot);
+        }
+
+        private static BytecodeOp ExtendOf(Word type)
+        {
+            bool signed = Keywords.IsSigned(type);
+
+            switch (Keywords.SizeOf(type))
+            {
+                case 1:
+                    return signed ? BytecodeOp.SignExtend8 : BytecodeOp.ZeroExtend8;
+
+                case 2:
+                    return signed ? BytecodeOp.SignExtend16 : BytecodeOp.ZeroExtend16;
+
+                default:
+                    return signed ? BytecodeOp.SignExtend32 : BytecodeOp.ZeroExtend32;
+            }
+        }
+
+        private int Slot(int register)
+        {
+            if (Slots[register] < 0)
+                Slots[register] = SlotCount++;
+
+            return Slots[register];
+        }
+
+        private void Emit(BytecodeOp op, params int[] operands)
+        {
+            Code.Add((int)op);
+            Code.AddRange(operands);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+﻿using System;
+using System.Buffers;
+
+namespace Sage
+{
+    // Finds the ends of the runs of characters the lexer skips. The searches of the spans compare 16 or 32 characters
+    // at once with the vector instructions of the processor, and fall back to scalar loops without them.
+    internal static class CharClass
+    {
+        private static readonly SearchValues<char> WordChars = SearchValues.Create("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz");
+        private static readonly SearchValues<char> StringStops = SearchValues.Create("\n\"\\");
+
+        // Position of the first character from the position on that is neither a space nor a tab
+        public static int SkipBlanks(char[] buffer, int position, int length)
+        {
+            return End(buffer.AsSpan(position, length - position).IndexOfAnyExcept(' ', '\t'), position, length);
+        }
+
+        // Position of the first character from the position on that cannot be part of a word
+        public static int SkipWord(char[] buffer, int position, int length)
+        {
+            return End(buffer.AsSpan(position, length - position).IndexOfAnyExcept(WordChars), position, length);
+        }
+
+        // Position of the next line break, or the length when the text has none
+        public static int FindLineEnd(char[] buffer, int position, int length)
+        {
+            return End(buffer.AsSpan(position, length - position).IndexOf('\n'), position, length);
+        }
+
+        // Position of the next quote, backslash or line break, which are the characters ending a run of a string literal
+        public static int FindStringStop(char[] buffer, int position, int length)
+        {
+            return End(buffer.AsSpan(position, length - position).IndexOfAny(StringStops), position, length);
+        }
+
+        public static bool IsWordChar(char c)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+        private static int End(int index, int position, int length)
+        {
+            return (index >= 0) ? position + index : length;
+        }
+    }
+}
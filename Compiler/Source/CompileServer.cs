@@ -0,0 +1,184 @@
+﻿using System;
+using System.IO;
+using System.IO.Pipes;
+using System.Text;
+
+namespace Sage
+{
+    // Keeps one compiler process running, so repeated builds skip starting the runtime, compiling the compiler again
+    // and lexing the files that did not change. A client sends its working directory and its command line over the
+    // pipe, the server compiles as if it was started with them and answers with the output and the exit code.
+    internal class CompileServer
+    {
+        private const int Magic = 0x50534753; // "SGSP"
+        private const int ProtocolVersion = 1;
+
+        // How long a client waits for a server before compiling in its own process
+        private const int ConnectTimeout = 200;
+
+        private readonly string PipeName;
+        private readonly CompilerState State = new CompilerState();
+
+        public CompileServer(string pipeName)
+        {
+            PipeName = pipeName;
+        }
+
+        public int Run()
+        {
+            Console.WriteLine($"[INFO] Serving the compilations of the pipe \"{PipeName}\", press Ctrl+C to stop.");
+
+            // One instance of the pipe, so the builds never overlap and each can change the working directory
+            while (true)
+            {
+                using (NamedPipeServerStream pipe = new NamedPipeServerStream(PipeName, PipeDirection.InOut, 1, PipeTransmissionMode.Byte))
+                {
+                    pipe.WaitForConnection();
+
+                    try
+                    {
+                        Serve(pipe);
+                    }
+
+                    // The client stopped waiting, the next one is served as usual
+                    catch (IOException exception)
+                    {
+                        Console.WriteLine($"[WARNING] Lost a client: {exception.Message}");
+                    }
+                }
+            }
+        }
+
+        private void Serve(Stream pipe)
+        {
+            BinaryReader reader = new BinaryReader(pipe, Encoding.UTF8, true);
+            BinaryWriter writer = new BinaryWriter(pipe, Encoding.UTF8, true);
+
+            if (reader.ReadInt32() != Magic || reader.ReadInt32() != ProtocolVersion)
+            {
+                Answer(writer, "[ERROR] The client is not a compiler of this version.\n", 1);
+                return;
+            }
+
+            string directory = reader.ReadString();
+            string[] args = new string[reader.ReadInt32()];
+
+            for (int i = 0; i < args.Length; i++)
+                args[i] = reader.ReadString();
+
+            string output;
+            int exitCode = Compile(directory, args, out output);
+
+            Answer(writer, output, exitCode);
+        }
+
+        private int Compile(string directory, string[] args, out string output)
+        {
+            if (!Directory.Exists(directory))
+            {
+                output = $"[ERROR] The directory \"{directory}\" of the client does not exist.\n";
+                return 1;
+            }
+
+            // The inputs are found relative to the directory of the client, so it is set before parsing them
+            Directory.SetCurrentDirectory(directory);
+
+            string error;
+            Options options = Options.Parse(args, out error);
+
+            if (options == null)
+                error = $"{error}\n{Options.Usage}";
+
+            else if (options.Server || options.Watch)
+                error = "The server cannot serve, nor watch the files of a client.";
+
+            else if (options.Files.Contains(Options.StandardInput))
+                error = "The server cannot read the standard input of a client.";
+
+            if (error != null)
+            {
+                output = $"[ERROR] {error}\n";
+                return 1;
+            }
+
+            using (MemoryStream stream = new MemoryStream())
+            {
+                int exitCode;
+
+                try
+                {
+                    exitCode = new Driver(options, State).Run(stream);
+                }
+
+                catch (Exception exception)
+                {
+                    output = $"[ERROR] Internal error of the server: {exception.Message}\n";
+                    return 1;
+                }
+
+                output = Encoding.UTF8.GetString(stream.ToArray());
+                return exitCode;
+            }
+        }
+
+        private static void Answer(BinaryWriter writer, string output, int exitCode)
+        {
+            writer.Write(output);
+            writer.Write(exitCode);
+            writer.Flush();
+        }
+
+        // Compiles through the server of the pipe, returning false when no server answers
+        public static bool TryCompile(string pipeName, string[] args, out int exitCode)
+        {
+            exitCode = 1;
+
+            using (NamedPipeClientStream pipe = new NamedPipeClientStream(".", pipeName, PipeDirection.InOut))
+            {
+                try
+                {
+                    pipe.Connect(ConnectTimeout);
+                }
+
+                catch (Exception exception) when (exception is TimeoutException || exception is IOException)
+                {
+                    return false;
+                }
+
+                BinaryWriter writer = new BinaryWriter(pipe, Encoding.UTF8, true);
+                BinaryReader reader = new BinaryReader(pipe, Encoding.UTF8, true);
+                string output;
+
+                // A server that stops during the build leaves it to the client
+                try
+                {
+                    writer.Write(Magic);
+                    writer.Write(ProtocolVersion);
+                    writer.Write(Directory.GetCurrentDirectory());
+                    writer.Write(args.Length);
+
+                    foreach (string arg in args)
+                        writer.Write(arg);
+
+                    writer.Flush();
+
+                    output = reader.ReadString();
+                    exitCode = reader.ReadInt32();
+                }
+
+                catch (IOException)
+                {
+                    return false;
+                }
+
+                using (Stream stream = Console.OpenStandardOutput())
+                {
+                    byte[] bytes = new UTF8Encoding(false).GetBytes(output);
+                    stream.Write(bytes, 0, bytes.Length);
+                }
+
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,54 @@
+﻿using System;
+using System.Collections.Generic;
+
+namespace Sage
+{
+    // What a compile server keeps from one build to the next: the interned names, which the tokens refer to by id,
+    // and the tokens and trees of the sources that compiled without errors. The builds of a server never overlap.
+    internal class CompilerState
+    {
+        private class Entry
+        {
+            public ulong Hash;
+            public TokenStream Tokens;
+            public Ast Tree;
+        }
+
+        public readonly ConcurrentInterner Names = new ConcurrentInterner();
+        public readonly ConcurrentInterner Strings = new ConcurrentInterner();
+
+        // By the full path of the source
+        private readonly Dictionary<string, Entry> Sources = new Dictionary<string, Entry>(StringComparer.Ordinal);
+
+        // The tokens and the tree of a source whose text did not change since they were kept
+        public bool TryGet(string fileName, ulong hash, out TokenStream tokens, out Ast tree)
+        {
+            Entry entry;
+
+            lock (Sources)
+            {
+                if (!Sources.TryGetValue(fileName, out entry) || entry.Hash != hash)
+                    entry = null;
+            }
+
+            tokens = (entry != null) ? entry.Tokens : null;
+            tree = (entry != null) ? entry.Tree : null;
+            return entry != null;
+        }
+
+        // The state takes ownership of the tokens, and releases the ones they replace
+        public void Keep(string fileName, ulong hash, TokenStream tokens, Ast tree)
+        {
+            Entry old;
+
+            lock (Sources)
+            {
+                Sources.TryGetValue(fileName, out old);
+                Sources[fileName] = new Entry { Hash = hash, Tokens = tokens, Tree = tree };
+            }
+
+            if (old != null && old.Tokens != tokens)
+                old.Tokens.Dispose();
+        }
+    }
+}
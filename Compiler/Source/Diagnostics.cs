@@ -0,0 +1,504 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using System.Text;
+
+namespace Sage
+{
+    enum Severity : byte
+    {
+        Error = 0,
+        Warning,
+
+        // Explains the diagnostic before it
+        Note
+    }
+
+    // The messages are in the table of DiagnosticMessages, in the same order
+    enum DiagnosticCode : ushort
+    {
+        // Reading and lexing
+        FileNotFound = 0,
+        FileUnreadable,
+        UnterminatedString,
+        InvalidEscape,
+        ExpectedUnicodeBrace,
+        InvalidNumber,
+        NumberTooLarge,
+
+        // Parsing
+        ExpectedItem,
+        ExpectedFunctionName,
+        ExpectedReturnType,
+        ExpectedParameterType,
+        ExpectedParameterName,
+        ExpectedVariableName,
+        UnexpectedKeyword,
+        ExpectedExpression,
+        ExpectedName,
+        ExpectedNameAfterPath,
+        ExpectedOperator,
+        ExpectedArrayLength,
+        ArrayInitialized,
+        NestingTooDeep,
+
+        // Modules and analysis
+        ModuleDefinedTwice,
+        ModuleDefinedByRuntime,
+        UnknownModule,
+        CyclicUse,
+        UseInCycle,
+        FunctionDefinedTwice,
+        UnknownFunction,
+        UnknownFunctionInModule,
+        ModuleNotUsed,
+
+        // Lowering
+        MissingReturn,
+        ReturnFromNothing,
+        MissingReturnValue,
+        FloatNotSupported,
+        StringNotSupported,
+        RuntimeNotSupported,
+        ExpectedString,
+        ExpectedVariable,
+        ArgumentCount,
+        ReturnsNothing,
+        UnknownVariable,
+        VariableDefinedTwice,
+        ExpectedInteger,
+        NumberWraps,
+        NotAnArray,
+        ArrayWithoutIndex,
+        MixedTypes,
+        NarrowingConversion,
+
+        // Optimization reports
+        LoopVectorized,
+        LoopNotVectorized,
+
+        InternalError
+    }
+
+    // One error, warning or note. No message is formatted until the diagnostic is printed: it refers to its source by
+    // the id of the file and a span of characters, and keeps the few values its message needs.
+    internal struct Diagnostic
+    {
+        public DiagnosticCode Code;
+
+        // Id of the file in the file table, or -1
+        public int File;
+
+        // Span of the diagnostic in the text of the file, Start is -1 for the diagnostics of a whole file
+        public int Start;
+        public int Length;
+
+        // Values of the message, given by the code
+        public int Argument;
+        public int Extra;
+        public string Text;
+    }
+
+    // The diagnostics of one file, in the order they were found
+    internal class DiagnosticBag
+    {
+        // The file of the diagnostics that do not give one
+        public int File { get; private set; }
+
+        public Diagnostic[] Items { get; private set; }
+        public int Count { get; private set; }
+        public int ErrorCount { get; private set; }
+
+        public DiagnosticBag(int file = -1)
+        {
+            File = file;
+            Items = new Diagnostic[4];
+        }
+
+        public void Add(DiagnosticCode code, int start, int length, string text = null, int argument = 0, int extra = 0)
+        {
+            Add(new Diagnostic { Code = code, File = File, Start = start, Length = length, Argument = argument, Extra = extra, Text = text });
+        }
+
+        public void Add(Diagnostic diagnostic)
+        {
+            if (Count == Items.Length)
+            {
+                Diagnostic[] items = new Diagnostic[Items.Length * 2];
+                Array.Copy(Items, items, Count);
+                Items = items;
+            }
+
+            Items[Count++] = diagnostic;
+
+            if (DiagnosticMessages.SeverityOf(diagnostic.Code) == Severity.Error)
+                ErrorCount++;
+        }
+
+        // Replaces the diagnostics of an edited range of the text. The ones found before the first new one that start in
+        // [start, end) are dropped and the ones after the range are moved by the size of the edit, while the new ones
+        // take the place of the range, leaving out the ones from the limit on.
+        public void Replace(int firstNew, int start, int end, int delta, int limit)
+        {
+            Diagnostic[] items = new Diagnostic[Items.Length];
+            int count = 0;
+
+            for (int i = 0; i < firstNew; i++)
+            {
+                if (Items[i].Start < start)
+                    items[count++] = Items[i];
+            }
+
+            for (int i = firstNew; i < Count; i++)
+            {
+                if (Items[i].Start < limit)
+                    items[count++] = Items[i];
+            }
+
+            for (int i = 0; i < firstNew; i++)
+            {
+                if (Items[i].Start >= end)
+                {
+                    items[count] = Items[i];
+                    items[count++].Start += delta;
+                }
+            }
+
+            Items = items;
+            Count = count;
+            ErrorCount = 0;
+
+            for (int i = 0; i < count; i++)
+            {
+                if (DiagnosticMessages.SeverityOf(items[i].Code) == Severity.Error)
+                    ErrorCount++;
+            }
+        }
+
+        public void Clear()
+        {
+            Array.Clear(Items, 0, Count);
+            Count = 0;
+            ErrorCount = 0;
+        }
+    }
+
+    // The names and the sources of the files the diagnostics refer to by their id
+    internal class FileTable
+    {
+        private class Entry
+        {
+            public string FileName;
+            public SourceFile Source;
+
+            // Offsets of the starts of the lines, found the first time a diagnostic of the file is printed
+            public int[] LineStarts;
+            public char[] LinesOf;
+            public int LinesLength;
+
+            // Set for the files read from a stream, whose lines are known without their text
+            public bool Streamed;
+        }
+
+        private readonly List<Entry> Entries = new List<Entry>();
+
+        public int Add(string fileName)
+        {
+            lock (Entries)
+            {
+                Entries.Add(new Entry { FileName = fileName });
+                return Entries.Count - 1;
+            }
+        }
+
+        // The source is kept until the diagnostics of the file are printed, so they can quote it
+        public void SetSource(int file, SourceFile source)
+        {
+            lock (Entries)
+                Entries[file].Source = source;
+        }
+
+        // The starts of the lines of a file whose text was not kept, so its diagnostics are located without quotes
+        public void SetLines(int file, int[] lineStarts)
+        {
+            lock (Entries)
+            {
+                Entries[file].LineStarts = lineStarts;
+                Entries[file].Streamed = true;
+            }
+        }
+
+        public string NameOf(int file)
+        {
+            lock (Entries)
+                return (file >= 0 && file < Entries.Count) ? Entries[file].FileName : "<source>";
+        }
+
+        // The text of a file and the starts of its lines, false when the source is not available anymore.
+        // The text is null for the files read from a stream.
+        public bool TryGetLines(int file, out char[] text, out int length, out int[] lineStarts)
+        {
+            Entry entry;
+
+            lock (Entries)
+                entry = (file >= 0 && file < Entries.Count) ? Entries[file] : null;
+
+            text = (entry != null && entry.Source != null) ? entry.Source.Text : null;
+            length = (text != null) ? entry.Source.Length : 0;
+            lineStarts = null;
+
+            if (text == null)
+            {
+                lineStarts = (entry != null && entry.Streamed) ? entry.LineStarts : null;
+                return lineStarts != null;
+            }
+
+            // Edited sources get new buffers, so the lines are found again
+            if (entry.LinesOf != text || entry.LinesLength != length)
+            {
+                List<int> starts = new List<int> { 0 };
+
+                for (int i = 0; i < length; i++)
+                {
+                    if (text[i] == '\n')
+                        starts.Add(i + 1);
+                }
+
+                entry.LineStarts = starts.ToArray();
+                entry.LinesOf = text;
+                entry.LinesLength = length;
+            }
+
+            lineStarts = entry.LineStarts;
+            return true;
+        }
+    }
+
+    // Prints diagnostics with the line of source they point at, up to a maximum number of errors
+    internal class DiagnosticRenderer
+    {
+        private readonly FileTable Files;
+        private readonly int MaxErrors;
+        private readonly StringBuilder Line = new StringBuilder();
+        private int Printed;
+
+        // The diagnostics left out once the maximum was reached
+        public int Hidden { get; private set; }
+
+        // No maximum when it is 0
+        public DiagnosticRenderer(FileTable files, int maxErrors = 0)
+        {
+            Files = files;
+            MaxErrors = maxErrors;
+        }
+
+        public void Render(TextWriter writer, DiagnosticBag diagnostics)
+        {
+            for (int i = 0; i < diagnostics.Count; i++)
+            {
+                if (MaxErrors > 0 && Printed >= MaxErrors)
+                {
+                    Hidden += diagnostics.Count - i;
+                    return;
+                }
+
+                Render(writer, diagnostics.Items[i]);
+            }
+        }
+
+        public void ReportHidden(TextWriter writer)
+        {
+            if (Hidden > 0)
+                writer.WriteLine($"[INFO] {Hidden} more diagnostic(s) were not printed, the option \"--max-errors\" changes the maximum of {MaxErrors} error(s).");
+        }
+
+        private void Render(TextWriter writer, Diagnostic diagnostic)
+        {
+            Severity severity = DiagnosticMessages.SeverityOf(diagnostic.Code);
+            string fileName = Files.NameOf(diagnostic.File);
+
+            char[] text = null;
+            int length = 0;
+            int[] lineStarts = null;
+            bool located = diagnostic.Start >= 0 && Files.TryGetLines(diagnostic.File, out text, out length, out lineStarts);
+            bool quoted = located && text != null;
+
+            string spanText = quoted ? new string(text, diagnostic.Start, Math.Min(diagnostic.Length, length - diagnostic.Start)) : "";
+            string other = (diagnostic.Code == DiagnosticCode.ModuleDefinedTwice) ? Files.NameOf(diagnostic.Argument) : "";
+
+            Line.Clear();
+            Line.Append((severity == Severity.Error) ? "[ERROR] " : (severity == Severity.Warning) ? "[WARNING] " : "[INFO] ");
+            Line.AppendFormat(CultureInfo.InvariantCulture, DiagnosticMessages.FormatOf(diagnostic.Code), spanText, diagnostic.Argument, diagnostic.Extra, diagnostic.Text, fileName, other);
+
+            int line = 0;
+
+            if (located)
+            {
+                line = FindLine(lineStarts, diagnostic.Start);
+                Line.Append(" at ").Append(fileName).Append(':').Append(line + 1).Append(':').Append(diagnostic.Start - lineStarts[line] + 1);
+            }
+
+            else if (DiagnosticMessages.IsLocated(diagnostic.Code) && diagnostic.File >= 0)
+                Line.Append(" at ").Append(fileName);
+
+            writer.Write(Line.Append(".\n").ToString());
+
+            if (quoted)
+                Quote(writer, text, length, lineStarts, line, diagnostic);
+
+            if (severity == Severity.Error)
+                Printed++;
+        }
+
+        // Prints the line of the span and marks the span under it, tabs are expanded so the marks line up
+        private void Quote(TextWriter writer, char[] text, int length, int[] lineStarts, int line, Diagnostic diagnostic)
+        {
+            int start = lineStarts[line];
+            int end = (line + 1 < lineStarts.Length) ? lineStarts[line + 1] - 1 : length;
+
+            if (end > start && text[end - 1] == '\r')
+                end--;
+
+            int spanEnd = Math.Min(diagnostic.Start + Math.Max(diagnostic.Length, 1), end);
+
+            Line.Clear().Append("    ");
+
+            for (int i = start; i < end; i++)
+            {
+                if (text[i] == '\t')
+                    Line.Append("    ");
+
+                else
+                    Line.Append(text[i]);
+            }
+
+            Line.Append("\n    ");
+
+            for (int i = start; i < Math.Max(spanEnd, diagnostic.Start + 1); i++)
+            {
+                int width = (i < end && text[i] == '\t') ? 4 : 1;
+                Line.Append((i < diagnostic.Start) ? ' ' : '^', width);
+            }
+
+            writer.Write(Line.Append('\n').ToString());
+        }
+
+        private static int FindLine(int[] lineStarts, int offset)
+        {
+            int index = Array.BinarySearch(lineStarts, offset);
+            return (index >= 0) ? index : ~index - 1;
+        }
+    }
+
+    internal static class DiagnosticMessages
+    {
+        private struct Entry
+        {
+            public Severity Severity;
+
+            // {0} is the text of the span, {1} the argument, {2} the extra value, {3} the text, {4} the name of the
+            // file and {5} the name of the file whose id is the argument
+            public string Format;
+
+            // The location follows the message, unless the message already names the file
+            public bool Located;
+
+            public Entry(Severity severity, string format, bool located = true)
+            {
+                Severity = severity;
+                Format = format;
+                Located = located;
+            }
+        }
+
+        private static readonly Entry[] Entries =
+        {
+            new Entry(Severity.Error, "Failed to read the file \"{4}\"", false),
+            new Entry(Severity.Error, "Failed to read the file \"{4}\": {3}", false),
+            new Entry(Severity.Error, "Unterminated string literal \"{0}\""),
+            new Entry(Severity.Error, "Invalid escape sequence in string literal \"{0}\""),
+            new Entry(Severity.Error, "Expected \"{{\" in unicode escape sequence \"{0}\""),
+            new Entry(Severity.Error, "Invalid number literal \"{0}\""),
+            new Entry(Severity.Error, "Number literal is too large \"{0}\""),
+
+            new Entry(Severity.Error, "Expected \"use\" or \"function\""),
+            new Entry(Severity.Error, "Expected the name of the function"),
+            new Entry(Severity.Error, "Expected the return type of the function"),
+            new Entry(Severity.Error, "Expected the type of the parameter"),
+            new Entry(Severity.Error, "Expected the name of the parameter"),
+            new Entry(Severity.Error, "Expected the name of the variable"),
+            new Entry(Severity.Error, "Unexpected keyword"),
+            new Entry(Severity.Error, "Expected an expression"),
+            new Entry(Severity.Error, "Expected a name"),
+            new Entry(Severity.Error, "Expected a name after \"::\""),
+            new Entry(Severity.Error, "Expected \"{3}\""),
+            new Entry(Severity.Error, "Expected the length of the array, a number from 1 to {3}"),
+            new Entry(Severity.Error, "Arrays cannot be given an initial value, their elements start at zero"),
+            new Entry(Severity.Error, "Blocks and expressions cannot be nested more than {3} deep"),
+
+            new Entry(Severity.Error, "The module \"{3}\" of \"{4}\" is already defined by \"{5}\"", false),
+            new Entry(Severity.Error, "The module \"{3}\" of \"{4}\" is already defined by the runtime", false),
+            new Entry(Severity.Error, "Unknown module \"{0}\""),
+            new Entry(Severity.Error, "Cyclic use of modules {3}"),
+            new Entry(Severity.Note, "\"{3}\" uses \"{0}\""),
+            new Entry(Severity.Error, "The function \"{0}\" is already defined"),
+            new Entry(Severity.Error, "Unknown function \"{0}\""),
+            new Entry(Severity.Error, "Unknown function \"{0}\" in the module \"{3}\""),
+            new Entry(Severity.Error, "The module \"{0}\" is used without a \"use {0};\" declaration"),
+
+            new Entry(Severity.Error, "The function \"{0}\" does not return a value at its end"),
+            new Entry(Severity.Error, "The function returns nothing, so it cannot return a value"),
+            new Entry(Severity.Error, "The function must return a value"),
+            new Entry(Severity.Error, "Floating point numbers are not supported by the native backend yet"),
+            new Entry(Severity.Error, "String constants are not supported by the native backend yet"),
+            new Entry(Severity.Error, "The functions of the module \"{3}\" are not supported by the native backend yet"),
+            new Entry(Severity.Error, "The function \"{3}\" only writes constant strings"),
+            new Entry(Severity.Error, "Expected the name of a variable"),
+            new Entry(Severity.Error, "The function \"{3}\" expects {1} argument(s), not {2}"),
+            new Entry(Severity.Error, "The function \"{3}\" returns nothing"),
+            new Entry(Severity.Error, "Unknown variable \"{0}\""),
+            new Entry(Severity.Error, "The variable \"{0}\" is already defined in this scope"),
+            new Entry(Severity.Error, "Expected a value of the type {3}, not a string"),
+            new Entry(Severity.Warning, "The number \"{0}\" does not fit in the type {3} and wraps around"),
+            new Entry(Severity.Error, "The variable \"{0}\" is not an array"),
+            new Entry(Severity.Error, "The array \"{0}\" is only read and written through the index of an element"),
+            new Entry(Severity.Error, "No integer type holds every value of the types {3}"),
+            new Entry(Severity.Error, "Cannot convert {3} without losing values"),
+
+            new Entry(Severity.Note, "The loop was vectorized with {1} elements of the type {3} at a time"),
+            new Entry(Severity.Note, "The loop was not vectorized, as {3}"),
+
+            new Entry(Severity.Error, "Internal error while compiling \"{4}\": {3}", false)
+        };
+
+        // The texts of the operators, so the parser can name the one it expected without allocating
+        private static readonly string[] Characters = new string[128];
+
+        static DiagnosticMessages()
+        {
+            for (int i = 0; i < Characters.Length; i++)
+                Characters[i] = ((char)i).ToString();
+        }
+
+        public static Severity SeverityOf(DiagnosticCode code)
+        {
+            return Entries[(int)code].Severity;
+        }
+
+        public static string FormatOf(DiagnosticCode code)
+        {
+            return Entries[(int)code].Format;
+        }
+
+        public static bool IsLocated(DiagnosticCode code)
+        {
+            return Entries[(int)code].Located;
+        }
+
+        public static string TextOf(char c)
+        {
+            return (c < Characters.Length) ? Characters[c] : c.ToString();
+        }
+    }
+}
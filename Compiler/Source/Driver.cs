@@ -0,0 +1,690 @@
+﻿using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Runtime.ExceptionServices;
+using System.Text;
+using System.Threading;
+
+namespace Sage
+{
+    // Compiles every input file in parallel, reporting the results in the order of the command line
+    internal class Driver
+    {
+        private class Unit
+        {
+            public string FileName;
+            public bool Streamed;
+            public TokenStream Tokens;
+            public Ast Tree;
+            public Module Module;
+            public DiagnosticBag Diagnostics;
+            public int ErrorCount;
+            public bool Cached;
+
+            // The tokens and the tree belong to the state of the server, which reuses them in the next builds
+            public bool Kept;
+            public bool Reused;
+            public ManualResetEventSlim Done = new ManualResetEventSlim(false);
+        }
+
+        private readonly Options Options;
+
+        // Shared by every file, so the same name has the same id across the whole program
+        private readonly ConcurrentInterner Names;
+
+        // Decoded string literals, identical literals of different files are stored only once
+        private readonly ConcurrentInterner Strings;
+
+        // Null unless the compiler runs as a server, which keeps the sources that do not change between builds
+        private readonly CompilerState State;
+
+        private readonly TokenCache Cache;
+
+        // The files the diagnostics refer to, by the index of their unit
+        private readonly FileTable Files = new FileTable();
+
+        // Null unless the passes are measured
+        private readonly Timings Timings;
+
+        // The counts of --profile-use, read before the analysis
+        private Profile Profile;
+
+        public Driver(Options options, CompilerState state = null)
+        {
+            Options = options;
+            State = state;
+            Names = (state != null) ? state.Names : new ConcurrentInterner();
+            Strings = (state != null) ? state.Strings : new ConcurrentInterner();
+
+            if (options.CacheDirectory != null)
+                Cache = new TokenCache(options.CacheDirectory, Names, Strings);
+
+            if (options.TimePasses || options.TraceFile != null)
+                Timings = new Timings();
+        }
+
+        // Returns the exit code of the compiler
+        public int Run()
+        {
+            if (Options.Watch)
+                return new Watcher(Options, Names, Strings).Run();
+
+            return Run(Console.OpenStandardOutput());
+        }
+
+        // Writes the diagnostics and the messages of the build to the stream
+        public int Run(Stream stream)
+        {
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            TimingMark total = Start();
+            TimingMark frontEnd = Start();
+
+            Unit[] units = new Unit[Options.Files.Count];
+
+            for (int i = 0; i < units.Length; i++)
+            {
+                bool streamed = Options.Files[i] == Options.StandardInput;
+                string fileName = streamed ? Options.StdinName : Options.Files[i];
+                units[i] = new Unit { FileName = fileName, Streamed = streamed, Diagnostics = new DiagnosticBag(Files.Add(fileName)) };
+            }
+
+            DiagnosticRenderer renderer = new DiagnosticRenderer(Files, Options.MaxErrors);
+
+            int jobs = Math.Max(1, Math.Min(Options.Jobs, units.Length));
+            int errors = 0;
+            int exitCode = 0;
+            int cached = 0;
+            int reused = 0;
+            long tokens = 0;
+
+            // The queue bounds the files waiting for a worker, the window bounds the results waiting to be reported
+            using (BlockingCollection<Unit> queue = new BlockingCollection<Unit>(jobs * 2))
+            using (SemaphoreSlim window = new SemaphoreSlim(jobs * 4))
+            using (StreamWriter output = new StreamWriter(stream, new UTF8Encoding(false), 1 << 16))
+            {
+                Thread[] workers = new Thread[jobs];
+
+                for (int i = 0; i < jobs; i++)
+                {
+                    workers[i] = new Thread(() => Work(queue)) { IsBackground = true, Name = $"Sage Worker {i}" };
+                    workers[i].Start();
+                }
+
+                Thread producer = new Thread(() =>
+                {
+                    foreach (Unit unit in units)
+                    {
+                        window.Wait();
+                        queue.Add(unit);
+                    }
+
+                    queue.CompleteAdding();
+                }) { IsBackground = true };
+
+                producer.Start();
+
+                foreach (Unit unit in units)
+                {
+                    unit.Done.Wait();
+
+                    renderer.Render(output, unit.Diagnostics);
+                    errors += unit.ErrorCount;
+
+                    if (unit.Cached)
+                        cached++;
+
+                    if (unit.Reused)
+                        reused++;
+
+                    if (unit.Tokens != null)
+                    {
+                        tokens += unit.Tokens.Count;
+
+                        if (Options.DumpTokens)
+                            unit.Tokens.Dump(output);
+
+                        if (Options.DumpAst && unit.Tree != null)
+                            unit.Tree.Dump(output);
+                    }
+
+                    // The tokens and the tree are kept for the analysis of the whole program, which reports in the same bag
+                    unit.Diagnostics.Clear();
+                    unit.Done.Dispose();
+                    window.Release();
+                }
+
+                producer.Join();
+
+                foreach (Thread worker in workers)
+                    worker.Join();
+
+                Stop(frontEnd, "Front end");
+
+                if (Options.ProfileUse != null && (Profile = Profile.Load(Options.ProfileUse, output)) == null)
+                    errors++;
+
+                ModuleGraph graph;
+                errors += Analyze(units, out graph);
+
+                // The notes of a file may quote the other files, which are released once everything was printed
+                foreach (Unit unit in units)
+                {
+                    renderer.Render(output, unit.Diagnostics);
+
+                    if (unit.Module != null)
+                        output.Write(unit.Module.Output.ToString());
+                }
+
+                foreach (Unit unit in units)
+                {
+                    if (unit.Tokens != null && !unit.Kept)
+                        unit.Tokens.Dispose();
+
+                    unit.Tokens = null;
+                    unit.Tree = null;
+                    unit.Module = null;
+                    Files.SetSource(unit.Diagnostics.File, null);
+                }
+
+                renderer.ReportHidden(output);
+
+                if (errors == 0 && Options.Output != null)
+                    errors += Build(graph, output);
+
+                stopwatch.Stop();
+                output.WriteLine($"[INFO] Compiled {units.Length} file(s), {tokens} token(s) and {errors} error(s) in {stopwatch.Elapsed.TotalMilliseconds:F1} ms using {jobs} thread(s).");
+
+                if (Cache != null)
+                    output.WriteLine($"[INFO] Loaded {cached} of {units.Length} file(s) from the cache.");
+
+                if (State != null)
+                    output.WriteLine($"[INFO] Reused {reused} of {units.Length} file(s) kept by the server.");
+
+                if (errors == 0 && Options.Run)
+                    errors += Execute(graph, output, out exitCode);
+
+                if (Timings != null)
+                {
+                    Stop(total, "Total");
+                    errors += ReportTimings(output);
+                }
+            }
+
+            return (errors > 0) ? 1 : exitCode;
+        }
+
+        // Analyzes the modules over the graph of their uses, so only the modules that use each other wait for one another.
+        // The code of a module is generated right after its analysis, once the signatures of the functions it calls are known.
+        private int Analyze(Unit[] units, out ModuleGraph graph)
+        {
+            TimingMark mark = Start();
+            ModuleGraph modules = graph = new ModuleGraph();
+            int errors = 0;
+
+            foreach (Unit unit in units)
+            {
+                if (unit.Tree != null && (unit.Module = graph.Add(unit.Tree, unit.Diagnostics)) == null)
+                    errors++;
+            }
+
+            graph.Link();
+            Stop(mark, "Link");
+
+            List<int>[] dependencies = new List<int>[graph.Modules.Count];
+
+            for (int i = 0; i < dependencies.Length; i++)
+                dependencies[i] = graph.Modules[i].Dependencies;
+
+            Analyzer analyzer = new Analyzer(graph);
+
+            mark = Start();
+
+            Scheduler.Run(dependencies, Options.Jobs, index =>
+            {
+                Module module = modules.Modules[index];
+
+                if (module.IsRuntime)
+                    return;
+
+                try
+                {
+                    TimingMark start = Start();
+                    analyzer.Analyze(module);
+                    Stop(start, "Analyze", module.Tree.Tokens.FileName);
+
+                    if ((Options.Output != null || Options.DumpIr || Options.Run) && module.ErrorCount == 0)
+                        Generate(modules, module);
+                }
+
+                catch (Exception exception)
+                {
+                    module.Diagnostics.Add(DiagnosticCode.InternalError, -1, 0, exception.Message);
+                    module.ErrorCount++;
+                }
+            });
+
+            Stop(mark, "Analysis");
+
+            foreach (Module module in graph.Modules)
+                errors += module.ErrorCount;
+
+            return errors;
+        }
+
+        private void Generate(ModuleGraph graph, Module module)
+        {
+            string fileName = module.Tree.Tokens.FileName;
+            TimingMark start = Start();
+
+            // Only the native code runs the vectors of the kernels, the virtual machine leaves the elements to the loops
+            Vectorizer vectorizer = (Options.OptimizationLevel >= 2 && Options.Output != null) ? new Vectorizer(Options.Avx2, Options.ReportVectors) : null;
+
+            module.Code = new Lowering(graph, vectorizer, Options.ProfileGenerate != null, Profile).Lower(module);
+            Stop(start, "Lower", fileName);
+
+            if (module.Code == null)
+                return;
+
+            start = Start();
+
+            int level = Options.OptimizationLevel;
+
+            if (Options.ParallelFunctions)
+                ForEachFunction(module.Code, index => Optimizer.Optimize(module.Code[index], level));
+
+            else
+            {
+                foreach (IrFunction function in module.Code)
+                    Optimizer.Optimize(function, level);
+            }
+
+            if (level >= 2)
+                Inline(graph, module, level, (Profile != null) ? Profile.HotCount : 0);
+
+            Stop(start, "Optimize", fileName);
+
+            if (Options.DumpIr)
+            {
+                foreach (IrFunction function in module.Code)
+                    function.Dump(module.Output);
+            }
+
+            if (Options.Output != null)
+            {
+                start = Start();
+
+                if (Options.ParallelFunctions)
+                {
+                    char[][] buffers = new char[module.Code.Count][];
+                    int[] lengths = new int[module.Code.Count];
+
+                    ForEachFunction(module.Code, index => lengths[index] = X64Emitter.OfThread().Emit(module.Code[index], out buffers[index]));
+                    module.Assembly = X64Emitter.Merge(buffers, lengths);
+                }
+
+                else
+                    module.Assembly = new X64Emitter().Emit(module.Code);
+
+                Stop(start, "Generate", fileName);
+            }
+        }
+
+        // Inlines the small functions of the module and of the modules it uses, which were generated before it.
+        // The callees of the module change as it goes, so its functions are inlined one after the other.
+        private static void Inline(ModuleGraph graph, Module module, int level, long hotCount)
+        {
+            Dictionary<string, IrFunction> functions = new Dictionary<string, IrFunction>();
+
+            foreach (int dependency in module.Dependencies)
+            {
+                if (graph.Modules[dependency].Code != null)
+                {
+                    foreach (IrFunction function in graph.Modules[dependency].Code)
+                        functions[function.Name] = function;
+                }
+            }
+
+            foreach (IrFunction function in module.Code)
+                functions[function.Name] = function;
+
+            Inliner inliner = new Inliner(functions, level, hotCount);
+
+            foreach (IrFunction function in module.Code)
+            {
+                if (inliner.Inline(function))
+                    Optimizer.Optimize(function, level);
+            }
+        }
+
+        // Runs the work for every function on the workers of a scheduler, as the functions do not depend on each other.
+        // The first exception is thrown again on the calling thread, where the module reports it.
+        private void ForEachFunction(List<IrFunction> functions, Action<int> work)
+        {
+            List<int> none = new List<int>();
+            List<int>[] dependencies = new List<int>[functions.Count];
+            Exception failure = null;
+
+            for (int i = 0; i < dependencies.Length; i++)
+                dependencies[i] = none;
+
+            Scheduler.Run(dependencies, Options.Jobs, index =>
+            {
+                try
+                {
+                    work(index);
+                }
+
+                catch (Exception exception)
+                {
+                    Interlocked.CompareExchange(ref failure, exception, null);
+                }
+            });
+
+            if (failure != null)
+                ExceptionDispatchInfo.Capture(failure).Throw();
+        }
+
+        // Writes the assembly of every module in the order of the command line, then assembles and links it
+        private int Build(ModuleGraph graph, TextWriter output)
+        {
+            TimingMark mark = Start();
+            IrFunction main = FindMain(graph);
+
+            if (main == null && Options.OutputKind == OutputKind.Executable)
+            {
+                output.WriteLine("[ERROR] The program has no \"Main\" function without parameters.");
+                return 1;
+            }
+
+            StringBuilder assembly = new StringBuilder();
+            assembly.Append("    .intel_syntax noprefix\n    .text\n");
+
+            bool console = false;
+            List<IrFunction> instrumented = new List<IrFunction>();
+
+            foreach (Module module in graph.Modules)
+            {
+                if (module.Assembly != null)
+                    assembly.Append(module.Assembly);
+
+                if (module.Code != null)
+                {
+                    console |= module.Code.Exists(function => function.Strings.Count > 0);
+                    instrumented.AddRange(module.Code.FindAll(function => function.Instrumented));
+                }
+            }
+
+            // The runtime only comes with the programs writing to the console
+            if (console)
+                assembly.Append(NativeRuntime.EmitConsole(Toolchain.IsWindows));
+
+            // The profile goes where the compiler was asked to write it, whatever directory the program runs from
+            bool profile = main != null && instrumented.Count > 0;
+
+            if (profile)
+                assembly.Append(NativeRuntime.EmitProfile(instrumented, Path.GetFullPath(Options.ProfileGenerate), Toolchain.IsWindows));
+
+            if (main != null)
+                assembly.Append(X64Emitter.EmitEntry(main, Toolchain.IsWindows, console, profile));
+
+            // The stack of the program is not executable
+            if (!Toolchain.IsWindows)
+                assembly.Append("\n    .section .note.GNU-stack,\"\",@progbits\n");
+
+            bool built;
+
+            if (Options.OutputKind == OutputKind.Assembly)
+            {
+                File.WriteAllText(Options.Output, assembly.ToString());
+                built = true;
+            }
+
+            else
+            {
+                // The assembler needs the extension, so the empty file reserving the name is deleted along with the source
+                string tempFile = Path.GetTempFileName();
+                string assemblyFile = tempFile + ".s";
+
+                try
+                {
+                    File.WriteAllText(assemblyFile, assembly.ToString());
+                    built = Toolchain.Build(assemblyFile, Options.Output, Options.OutputKind == OutputKind.Object, output);
+                }
+
+                finally
+                {
+                    File.Delete(assemblyFile);
+                    File.Delete(tempFile);
+                }
+            }
+
+            Stop(mark, "Build");
+
+            if (built)
+                output.WriteLine($"[INFO] Wrote \"{Options.Output}\".");
+
+            return built ? 0 : 1;
+        }
+
+        // Runs the program in the virtual machine, which exits with the result of its main function like a native program
+        private int Execute(ModuleGraph graph, TextWriter output, out int exitCode)
+        {
+            IrFunction main = FindMain(graph);
+            exitCode = 0;
+
+            if (main == null)
+            {
+                output.WriteLine("[ERROR] The program has no \"Main\" function without parameters.");
+                return 1;
+            }
+
+            TimingMark mark = Start();
+            List<IrFunction> functions = new List<IrFunction>();
+
+            foreach (Module module in graph.Modules)
+            {
+                if (module.Code != null)
+                    functions.AddRange(module.Code);
+            }
+
+            BytecodeCompiler compiler = new BytecodeCompiler();
+            VirtualMachine machine = new VirtualMachine(compiler.Compile(functions));
+            Stop(mark, "Bytecode");
+
+            mark = Start();
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            long result;
+            bool ran = machine.Run(compiler.IndexOf(main.Name), output, out result);
+            Stop(mark, "Run");
+
+            if (!ran)
+                return 1;
+
+            exitCode = (int)result;
+            output.WriteLine($"[INFO] Ran \"{main.Name}\" in {stopwatch.Elapsed.TotalMilliseconds:F1} ms, it returned {result}.");
+            return 0;
+        }
+
+        // The main function of the module named Main, or else of the first module that has one
+        private static IrFunction FindMain(ModuleGraph graph)
+        {
+            IrFunction found = null;
+
+            foreach (Module module in graph.Modules)
+            {
+                if (module.Code == null)
+                    continue;
+
+                foreach (IrFunction function in module.Code)
+                {
+                    if (function.Name != module.Name + "::Main" || function.Parameters.Length != 0)
+                        continue;
+
+                    if (module.Name == "Main")
+                        return function;
+
+                    if (found == null)
+                        found = function;
+                }
+            }
+
+            return found;
+        }
+
+        private int ReportTimings(TextWriter output)
+        {
+            if (Options.TimePasses)
+                Timings.Report(output);
+
+            if (Options.TraceFile == null)
+                return 0;
+
+            try
+            {
+                Timings.WriteTrace(Options.TraceFile);
+                output.WriteLine($"[INFO] Wrote the trace of the passes to \"{Options.TraceFile}\".");
+                return 0;
+            }
+
+            catch (Exception exception) when (exception is IOException || exception is UnauthorizedAccessException)
+            {
+                output.WriteLine($"[ERROR] Failed to write the trace \"{Options.TraceFile}\": {exception.Message}");
+                return 1;
+            }
+        }
+
+        private void Work(BlockingCollection<Unit> queue)
+        {
+            foreach (Unit unit in queue.GetConsumingEnumerable())
+            {
+                try
+                {
+                    Compile(unit);
+                }
+
+                catch (Exception exception)
+                {
+                    unit.Diagnostics.Add(DiagnosticCode.InternalError, -1, 0, exception.Message);
+                    unit.ErrorCount++;
+                }
+
+                finally
+                {
+                    unit.Done.Set();
+                }
+            }
+        }
+
+        private void Compile(Unit unit)
+        {
+            Lexer lexer = new Lexer(unit.Diagnostics, Names, Strings);
+
+            if (unit.Streamed)
+            {
+                CompileStream(unit, lexer);
+                return;
+            }
+
+            TimingMark mark = Start();
+
+            SourceFile source = lexer.Open(unit.FileName);
+            unit.ErrorCount += lexer.ErrorCount;
+
+            if (source == null)
+                return;
+
+            Files.SetSource(unit.Diagnostics.File, source);
+
+            ulong hash = (Cache != null || State != null) ? TokenCache.HashOf(source) : 0;
+            string fullName = (State != null) ? Path.GetFullPath(unit.FileName) : null;
+            Stop(mark, "Read", unit.FileName);
+
+            // The kept tokens own a source with the same text, which the diagnostics quote instead
+            if (State != null && State.TryGet(fullName, hash, out unit.Tokens, out unit.Tree))
+            {
+                source.Dispose();
+                Files.SetSource(unit.Diagnostics.File, unit.Tokens.File);
+                unit.Kept = true;
+                unit.Reused = true;
+                return;
+            }
+
+            if (Cache != null)
+            {
+                mark = Start();
+                unit.Cached = Cache.TryLoad(source, hash, out unit.Tokens, out unit.Tree);
+                Stop(mark, "Cache", unit.FileName, unit.Cached ? unit.Tokens.Count : 0);
+
+                if (unit.Cached)
+                {
+                    Keep(unit, fullName, hash);
+                    return;
+                }
+            }
+
+            mark = Start();
+            unit.Tokens = lexer.Read(source);
+            unit.ErrorCount += lexer.ErrorCount;
+            Stop(mark, "Lex", unit.FileName, unit.Tokens.Count);
+
+            Parse(unit);
+
+            // Files with errors are compiled again, so their diagnostics are reported on every run
+            if (Cache != null && unit.ErrorCount == 0)
+            {
+                mark = Start();
+                Cache.Save(hash, unit.Tokens, unit.Tree);
+                Stop(mark, "Cache", unit.FileName);
+            }
+
+            if (unit.ErrorCount == 0)
+                Keep(unit, fullName, hash);
+        }
+
+        private void Keep(Unit unit, string fullName, ulong hash)
+        {
+            if (State == null)
+                return;
+
+            State.Keep(fullName, hash, unit.Tokens, unit.Tree);
+            unit.Kept = true;
+        }
+
+        // The standard input is lexed as it arrives, and never cached as it cannot be read again
+        private void CompileStream(Unit unit, Lexer lexer)
+        {
+            TimingMark mark = Start();
+
+            using (Stream input = Console.OpenStandardInput())
+                unit.Tokens = lexer.Read(input, unit.FileName);
+
+            unit.ErrorCount += lexer.ErrorCount;
+            Files.SetLines(unit.Diagnostics.File, unit.Tokens.LineStarts);
+            Stop(mark, "Lex", unit.FileName, unit.Tokens.Count);
+
+            Parse(unit);
+        }
+
+        private void Parse(Unit unit)
+        {
+            TimingMark mark = Start();
+            Parser parser = new Parser(unit.Diagnostics);
+            unit.Tree = parser.Parse(unit.Tokens);
+            unit.ErrorCount += parser.ErrorCount;
+            Stop(mark, "Parse", unit.FileName);
+        }
+
+        private TimingMark Start()
+        {
+            return (Timings != null) ? Timings.Start() : default(TimingMark);
+        }
+
+        private void Stop(TimingMark start, string name, string file = null, int tokens = 0)
+        {
+            if (Timings != null)
+                Timings.Stop(start, name, file, tokens);
+        }
+    }
+}
@@ -0,0 +1,227 @@
+﻿using System.Collections.Generic;
+
+namespace Sage
+{
+    // Copies the code of small functions in place of their calls at -O2, so the optimizer folds the arguments the
+    // callers give and loops lose the calls of their bodies. Only the functions of a single block are inlined, as
+    // their code ends with their one return, and a function is never inlined into itself nor are the functions with
+    // arrays, which live in the frame of their own function. With a profile, the calls that never ran are left as
+    // they are and the hot ones inline functions four times larger.
+    internal class Inliner
+    {
+        private const int HotFactor = 4;
+
+        private readonly Dictionary<string, IrFunction> Functions;
+        private readonly int Limit;
+        private readonly long HotCount;
+
+        // The size of every function, int.MaxValue for the ones that cannot be inlined
+        private readonly Dictionary<IrFunction, int> Sizes = new Dictionary<IrFunction, int>();
+
+        // The functions that may be inlined by their name, from the module and the modules it uses, and the count of
+        // the hot blocks of the profile
+        public Inliner(Dictionary<string, IrFunction> functions, int level, long hotCount = 0)
+        {
+            Functions = functions;
+            Limit = (level >= 3) ? 48 : 16;
+            HotCount = hotCount;
+        }
+
+        // Returns true when some call of the function was inlined, the function should then be optimized again
+        public bool Inline(IrFunction caller)
+        {
+            Instruction[] code = caller.Code;
+            List<Instruction> result = null;
+            int block = -1;
+
+            for (int i = 0; i < caller.Count; i++)
+            {
+                IrFunction callee;
+
+                if (code[i].Op == Opcode.Label)
+                    block = (int)code[i].Value;
+
+                if (code[i].Op == Opcode.Call && Functions.TryGetValue(caller.Callees[(int)code[i].Value], out callee) && callee != caller && SizeOf(callee) <= LimitOf(caller, block))
+                {
+                    // The code before the first inlined call is kept as it is
+                    if (result == null)
+                    {
+                        result = new List<Instruction>(code.Length);
+
+                        for (int j = 0; j < i; j++)
+                            result.Add(code[j]);
+                    }
+
+                    Expand(caller, code[i], callee, result);
+                }
+
+                else if (result != null)
+                    result.Add(code[i]);
+            }
+
+            if (result == null)
+                return false;
+
+            // The caller grew, and may no longer be small enough for its own callers
+            caller.SetCode(result.ToArray(), result.Count);
+            Sizes.Remove(caller);
+            return true;
+        }
+
+        // The largest callee inlined into the block, which the profile makes larger where the block is hot
+        private int LimitOf(IrFunction caller, int block)
+        {
+            if (caller.BlockCounts == null)
+                return Limit;
+
+            long count = caller.CountOf(block);
+            return (count == 0) ? -1 : (count >= HotCount) ? Limit * HotFactor : Limit;
+        }
+
+        private int SizeOf(IrFunction function)
+        {
+            int size;
+
+            if (Sizes.TryGetValue(function, out size))
+                return size;
+
+            size = (function.Arrays.Count > 0) ? int.MaxValue : 0;
+            int returns = 0;
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                switch (function.Code[i].Op)
+                {
+                    case Opcode.Label:
+                    case Opcode.Jump:
+                    case Opcode.Branch:
+                    case Opcode.Phi:
+                        size = int.MaxValue;
+                        break;
+
+                    case Opcode.Return:
+                        returns++;
+                        break;
+
+                    // The counters of an instrumented build do not change what is inlined
+                    case Opcode.Parameter:
+                    case Opcode.Count:
+                        break;
+
+                    default:
+                        if (size < int.MaxValue)
+                            size++;
+
+                        break;
+                }
+            }
+
+            if (returns != 1 || function.Count == 0 || function.Code[function.Count - 1].Op != Opcode.Return)
+                size = int.MaxValue;
+
+            Sizes[function] = size;
+            return size;
+        }
+
+        // The code of the callee with fresh registers, its parameters reading the arguments and its return value
+        // copied to the result of the call
+        private static void Expand(IrFunction caller, Instruction call, IrFunction callee, List<Instruction> result)
+        {
+            int[] registers = new int[callee.Registers.Count];
+
+            for (int i = 0; i < registers.Length; i++)
+                registers[i] = -1;
+
+            for (int i = 0; i < callee.Count; i++)
+            {
+                Instruction instruction = callee.Code[i];
+
+                switch (instruction.Op)
+                {
+                    case Opcode.Parameter:
+                        registers[instruction.Target] = caller.Arguments[call.Left + (int)instruction.Value];
+                        break;
+
+                    case Opcode.Write:
+                    {
+                        string text = callee.Strings[(int)instruction.Value];
+                        int index = caller.Strings.IndexOf(text);
+
+                        if (index < 0)
+                        {
+                            index = caller.Strings.Count;
+                            caller.Strings.Add(text);
+                        }
+
+                        instruction.Value = index;
+                        result.Add(instruction);
+                        break;
+                    }
+
+                    // The inlined code still counts for the callee
+                    case Opcode.Count:
+                    {
+                        IrCounter counter = callee.Counters[(int)instruction.Value];
+                        int index = caller.Counters.IndexOf(counter);
+
+                        if (index < 0)
+                        {
+                            index = caller.Counters.Count;
+                            caller.Counters.Add(counter);
+                        }
+
+                        instruction.Value = index;
+                        result.Add(instruction);
+                        break;
+                    }
+
+                    case Opcode.Return:
+                        if (call.Target >= 0 && instruction.Left >= 0)
+                            result.Add(new Instruction { Op = Opcode.Copy, Type = call.Type, Target = call.Target, Left = Map(caller, callee, registers, instruction.Left), Right = -1 });
+
+                        break;
+
+                    case Opcode.Call:
+                    {
+                        int arguments = caller.Arguments.Count;
+                        string name = callee.Callees[(int)instruction.Value];
+                        int index = caller.Callees.IndexOf(name);
+
+                        if (index < 0)
+                        {
+                            index = caller.Callees.Count;
+                            caller.Callees.Add(name);
+                        }
+
+                        for (int argument = 0; argument < instruction.Right; argument++)
+                            caller.Arguments.Add(Map(caller, callee, registers, callee.Arguments[instruction.Left + argument]));
+
+                        instruction.Target = Map(caller, callee, registers, instruction.Target);
+                        instruction.Left = arguments;
+                        instruction.Value = index;
+                        result.Add(instruction);
+                        break;
+                    }
+
+                    default:
+                        instruction.Target = Map(caller, callee, registers, instruction.Target);
+                        instruction.Left = Map(caller, callee, registers, instruction.Left);
+                        instruction.Right = Map(caller, callee, registers, instruction.Right);
+                        result.Add(instruction);
+                        break;
+                }
+            }
+        }
+
+        private static int Map(IrFunction caller, IrFunction callee, int[] registers, int register)
+        {
+            if (register < 0)
+                return -1;
+
+            if (registers[register] < 0)
+                registers[register] = caller.NewRegister(callee.Registers[register]);
+
+            return registers[register];
+        }
+    }
+}
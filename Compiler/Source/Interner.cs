@@ -0,0 +1,238 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Threading;
+
+namespace Sage
+{
+    // Maps the text of identifiers to small integer ids, so later passes compare ids instead of strings
+    internal interface IInterner
+    {
+        int Count { get; }
+
+        int Intern(char[] buffer, int start, int length);
+
+        string GetText(int id);
+    }
+
+    // Open addressing table from text to id, shared by both interners
+    internal sealed class InternTable
+    {
+        private string[] Texts;
+        private int[] Hashes;
+        private int[] Ids;
+        private int Count;
+        private int Mask;
+
+        public InternTable(int capacity)
+        {
+            int size = 16;
+
+            while (size < capacity * 2)
+                size <<= 1;
+
+            Texts = new string[size];
+            Hashes = new int[size];
+            Ids = new int[size];
+            Mask = size - 1;
+        }
+
+        private const uint Seed = 2166136261;
+        private const uint Prime = 16777619;
+
+        // FNV-1a over the characters of the slice
+        public static int Hash(char[] buffer, int start, int length)
+        {
+            uint hash = Seed;
+
+            for (int i = start; i < start + length; i++)
+                hash = (hash ^ buffer[i]) * Prime;
+
+            return (int)hash;
+        }
+
+        public bool TryFind(char[] buffer, int start, int length, int hash, out int id)
+        {
+            for (int slot = hash & Mask; Texts[slot] != null; slot = (slot + 1) & Mask)
+            {
+                if (Hashes[slot] == hash && Equals(Texts[slot], buffer, start, length))
+                {
+                    id = Ids[slot];
+                    return true;
+                }
+            }
+
+            id = -1;
+            return false;
+        }
+
+        public void Add(string text, int hash, int id)
+        {
+            // Keep the table at most half full, so probe sequences stay short
+            if ((Count + 1) * 2 > Texts.Length)
+                Grow();
+
+            int slot = hash & Mask;
+
+            while (Texts[slot] != null)
+                slot = (slot + 1) & Mask;
+
+            Texts[slot] = text;
+            Hashes[slot] = hash;
+            Ids[slot] = id;
+            Count++;
+        }
+
+        private void Grow()
+        {
+            string[] texts = Texts;
+            int[] hashes = Hashes;
+            int[] ids = Ids;
+
+            Texts = new string[texts.Length * 2];
+            Hashes = new int[texts.Length * 2];
+            Ids = new int[texts.Length * 2];
+            Mask = Texts.Length - 1;
+
+            for (int i = 0; i < texts.Length; i++)
+            {
+                if (texts[i] == null)
+                    continue;
+
+                int slot = hashes[i] & Mask;
+
+                while (Texts[slot] != null)
+                    slot = (slot + 1) & Mask;
+
+                Texts[slot] = texts[i];
+                Hashes[slot] = hashes[i];
+                Ids[slot] = ids[i];
+            }
+        }
+
+        private static bool Equals(string text, char[] buffer, int start, int length)
+        {
+            if (text.Length != length)
+                return false;
+
+            for (int i = 0; i < length; i++)
+            {
+                if (text[i] != buffer[start + i])
+                    return false;
+            }
+
+            return true;
+        }
+    }
+
+    // Interner for a single thread
+    internal sealed class Interner : IInterner
+    {
+        private readonly InternTable Table = new InternTable(256);
+        private readonly List<string> Texts = new List<string>();
+
+        public int Count
+        {
+            get { return Texts.Count; }
+        }
+
+        public int Intern(char[] buffer, int start, int length)
+        {
+            int hash = InternTable.Hash(buffer, start, length);
+            int id;
+
+            if (Table.TryFind(buffer, start, length, hash, out id))
+                return id;
+
+            string text = new string(buffer, start, length);
+            id = Texts.Count;
+
+            Texts.Add(text);
+            Table.Add(text, hash, id);
+            return id;
+        }
+
+        public string GetText(int id)
+        {
+            return Texts[id];
+        }
+    }
+
+    // Interner shared by the workers of the driver, the table is split in shards with their own lock
+    internal sealed class ConcurrentInterner : IInterner
+    {
+        private const int ShardCount = 32;
+        private const int ChunkBits = 12;
+
+        private readonly InternTable[] Shards = new InternTable[ShardCount];
+        private readonly object ChunkLock = new object();
+
+        // Texts are stored in fixed chunks that never move, so reading them needs no lock
+        private string[][] Chunks = new string[16][];
+        private int NextId = -1;
+
+        public ConcurrentInterner()
+        {
+            for (int i = 0; i < ShardCount; i++)
+                Shards[i] = new InternTable(256);
+        }
+
+        public int Count
+        {
+            get { return Volatile.Read(ref NextId) + 1; }
+        }
+
+        public int Intern(char[] buffer, int start, int length)
+        {
+            int hash = InternTable.Hash(buffer, start, length);
+            InternTable shard = Shards[(int)((uint)hash >> 27)];
+            int id;
+
+            lock (shard)
+            {
+                if (shard.TryFind(buffer, start, length, hash, out id))
+                    return id;
+
+                string text = new string(buffer, start, length);
+                id = Interlocked.Increment(ref NextId);
+
+                Store(id, text);
+                shard.Add(text, hash, id);
+            }
+
+            return id;
+        }
+
+        public string GetText(int id)
+        {
+            return Volatile.Read(ref Chunks)[id >> ChunkBits][id & ((1 << ChunkBits) - 1)];
+        }
+
+        private void Store(int id, string text)
+        {
+            int chunk = id >> ChunkBits;
+            string[][] chunks = Volatile.Read(ref Chunks);
+
+            if (chunk >= chunks.Length || chunks[chunk] == null)
+            {
+                lock (ChunkLock)
+                {
+                    chunks = Chunks;
+
+                    if (chunk >= chunks.Length)
+                    {
+                        string[][] grown = new string[Math.Max(chunks.Length * 2, chunk + 1)][];
+                        Array.Copy(chunks, grown, chunks.Length);
+                        chunks = grown;
+                    }
+
+                    if (chunks[chunk] == null)
+                        chunks[chunk] = new string[1 << ChunkBits];
+
+                    Volatile.Write(ref Chunks, chunks);
+                }
+            }
+
+            chunks[chunk][id & ((1 << ChunkBits) - 1)] = text;
+        }
+    }
+}
@@ -0,0 +1,538 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace Sage
+{
+    // Meaning of the fields of an instruction for every opcode, unused fields are -1
+    enum Opcode : byte
+    {
+        // Target: register, Value: the value wrapped to the type
+        Constant = 0,
+
+        // Target: register, Value: index of the parameter
+        Parameter,
+
+        // Target: register, Left: value of the same type
+        Copy,
+
+        // Target: register, Left: value of another integer type
+        Convert,
+
+        // Target: register, Left and Right: operands of the type of the instruction
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+
+        // Target: register, Left: operand
+        Negate,
+
+        // Target: i32 register set to 1 when the comparison holds and to 0 otherwise, Left and Right: operands of the
+        // type of the instruction, which tells signed comparisons from unsigned ones
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+
+        // Target: register or -1 for functions returning nothing, Value: index of the callee,
+        // Left: index of the first argument in the arguments of the function, Right: number of arguments
+        Call,
+
+        // Target: register of the element type, Left: i64 index, Value: number of the array. Indices out of the
+        // array stop the program.
+        Load,
+
+        // Left: i64 index, Right: value of the element type, Value: number of the array
+        Store,
+
+        // Value: number of the array, whose elements are all set to zero
+        Clear,
+
+        // Target: the index the loop stopped at, of the type of the instruction, Value: index of the kernel,
+        // Left and Right: the arguments as for a call, the start and the end of the loop followed by the invariants
+        Kernel,
+
+        // Value: index of the constant string of the function, written to the standard output
+        Write,
+
+        // Value: index of the counter in the counters of the function, which counts the times the code ran for the
+        // profile of the program
+        Count,
+
+        // Left: value, or -1 for functions returning nothing
+        Return,
+
+        // Value: number of the block starting here. A block is entered by the jumps and branches to it, and from the
+        // instruction before its label unless that one is a jump or a return.
+        Label,
+
+        // Value: block jumped to
+        Jump,
+
+        // Left: condition, Value: block jumped to when the condition is zero, the code goes on with the next block otherwise
+        Branch,
+
+        // Target: register, Left and Right: the values coming from the two predecessors of the block, Left from the
+        // one ending first in the code. Phis come right after the label of their block.
+        Phi
+    }
+
+    // An array of a function, which lives in its frame
+    internal struct IrArray
+    {
+        public Word Type;
+        public int Length;
+    }
+
+    // A counter of the profile, owned by the function whose calls and branches it counts. The functions inlined
+    // into others keep counting in the counters of their own.
+    internal struct IrCounter
+    {
+        public string Function;
+        public int Index;
+    }
+
+    // The vectorized body of a loop over the elements of arrays, from an index while it stays below the end. Every
+    // turn handles Lanes elements, as long as all of them are below the end and the bound. The operations run in
+    // postfix order over a stack of vectors: a Load or a Store of an array by its Value, a Parameter pushing the
+    // invariant of its Value, and the Add, Subtract, Multiply and Negate of the element type.
+    internal class IrKernel
+    {
+        public Word Type;
+        public int Lanes;
+
+        // Length of the shortest array of the kernel
+        public int Bound;
+
+        public List<Instruction> Operations = new List<Instruction>();
+    }
+
+    internal struct Instruction
+    {
+        public Opcode Op;
+
+        // The integer type of the result, None for instructions without one
+        public Word Type;
+
+        public int Target;
+        public int Left;
+        public int Right;
+        public long Value;
+    }
+
+    // The code of a function for the backend. Values live in an unlimited number of virtual registers, which the
+    // register allocator maps to the registers of the machine. The code is in SSA form: every register is defined
+    // by a single instruction, which comes before the instructions reading it, except for the phis of the loop
+    // headers that read the values of the end of the loop. The blocks only come from structured statements, so a
+    // block has at most two predecessors and the only jumps going backwards are the ones closing a loop.
+    internal class IrFunction
+    {
+        private static readonly string[] OpcodeNames = Enum.GetNames<Opcode>();
+
+        // Qualified name of the function, such as "Math::Square"
+        public string Name { get; private set; }
+
+        // None when the function returns nothing
+        public Word ReturnType { get; private set; }
+
+        public Word[] Parameters { get; private set; }
+
+        public Instruction[] Code { get; private set; }
+        public int Count { get; private set; }
+        public int BlockCount { get; private set; }
+
+        // Type of every virtual register
+        public List<Word> Registers { get; private set; }
+
+        // Registers passed to the calls, each call refers to a range of this list
+        public List<int> Arguments { get; private set; }
+
+        // Qualified names of the called functions
+        public List<string> Callees { get; private set; }
+
+        // Constant strings written by the function, without duplicates
+        public List<string> Strings { get; private set; }
+
+        public List<IrArray> Arrays { get; private set; }
+        public List<IrKernel> Kernels { get; private set; }
+
+        // The counters the Count instructions increment. An instrumented function owns the counter 0 of its calls,
+        // and the counters 2j + 1 and 2j + 2 of the times the branch j was tested and held, whose statement is at the
+        // position of Branches.
+        public List<IrCounter> Counters { get; private set; }
+        public List<string> Branches { get; private set; }
+        public bool Instrumented { get; set; }
+
+        // The calls of the function and the times every block ran in the profile used, the blocks are null without one
+        public long EntryCount { get; private set; }
+        public long[] BlockCounts { get; private set; }
+
+        public IrFunction(string name, Word returnType, Word[] parameters)
+        {
+            Name = name;
+            ReturnType = returnType;
+            Parameters = parameters;
+            Code = new Instruction[16];
+            Registers = new List<Word>();
+            Arguments = new List<int>();
+            Callees = new List<string>();
+            Strings = new List<string>();
+            Arrays = new List<IrArray>();
+            Kernels = new List<IrKernel>();
+            Counters = new List<IrCounter>();
+            Branches = new List<string>();
+        }
+
+        // Calls and kernels read the registers of a range of the arguments instead of their Left and Right
+        public static bool HasArguments(Opcode op)
+        {
+            return op == Opcode.Call || op == Opcode.Kernel;
+        }
+
+        public int NewBlock()
+        {
+            return BlockCount++;
+        }
+
+        // Gives the function the counts of a profile, the blocks made after have no count until they are set
+        public void SetProfile(long calls)
+        {
+            EntryCount = calls;
+            BlockCounts = new long[Math.Max(BlockCount, 16)];
+        }
+
+        public void SetBlockCount(int block, long count)
+        {
+            if (block >= BlockCounts.Length)
+                BlockCounts = ResizedCounts(BlockCounts, Math.Max(block + 1, BlockCounts.Length * 2));
+
+            BlockCounts[block] = count;
+        }
+
+        // The count of the block, or of the entry for -1
+        public long CountOf(int block)
+        {
+            return (block < 0) ? EntryCount : (block < BlockCounts.Length) ? BlockCounts[block] : 0;
+        }
+
+        private static long[] ResizedCounts(long[] counts, int length)
+        {
+            long[] result = new long[length];
+            Array.Copy(counts, result, counts.Length);
+            return result;
+        }
+
+        public int NewRegister(Word type)
+        {
+            Registers.Add(type);
+            return Registers.Count - 1;
+        }
+
+        public int Add(Opcode op, Word type, int target, int left = -1, int right = -1, long value = 0)
+        {
+            if (Count == Code.Length)
+            {
+                Instruction[] code = new Instruction[Code.Length * 2];
+                Array.Copy(Code, code, Count);
+                Code = code;
+            }
+
+            Code[Count] = new Instruction { Op = op, Type = type, Target = target, Left = left, Right = right, Value = value };
+            return Count++;
+        }
+
+        // Replaces the whole code, for the passes that move instructions around
+        public void SetCode(Instruction[] code, int count)
+        {
+            Code = code;
+            Count = count;
+        }
+
+        public bool HasPhis()
+        {
+            for (int i = 0; i < Count; i++)
+            {
+                if (Code[i].Op == Opcode.Phi)
+                    return true;
+            }
+
+            return false;
+        }
+
+        // A copy of the function where every phi became copies at the end of its predecessors, for the backends.
+        // The function itself is left in SSA form, as the inliner may still read it.
+        public IrFunction WithoutPhis()
+        {
+            if (!HasPhis())
+                return this;
+
+            IrFunction result = new IrFunction(Name, ReturnType, Parameters);
+            result.Registers.AddRange(Registers);
+            result.Arguments.AddRange(Arguments);
+            result.Callees.AddRange(Callees);
+            result.Strings.AddRange(Strings);
+            result.Arrays.AddRange(Arrays);
+            result.Kernels.AddRange(Kernels);
+            result.BlockCount = BlockCount;
+            result.Counters.AddRange(Counters);
+            result.Branches.AddRange(Branches);
+            result.Instrumented = Instrumented;
+            result.EntryCount = EntryCount;
+            result.BlockCounts = BlockCounts;
+
+            int[] labels = new int[BlockCount];
+
+            for (int i = 0; i < Count; i++)
+            {
+                if (Code[i].Op == Opcode.Label)
+                    labels[(int)Code[i].Value] = i;
+            }
+
+            // The copies inserted before every instruction, which ends the predecessor of the block of the phis
+            List<Instruction>[] copies = new List<Instruction>[Count + 1];
+            int[] predecessors = new int[2];
+
+            for (int i = 0; i < Count; i++)
+            {
+                if (Code[i].Op != Opcode.Label || i + 1 >= Count || Code[i + 1].Op != Opcode.Phi)
+                    continue;
+
+                int count = PredecessorsOf(i, labels, predecessors);
+                int first = i + 1;
+                int last = first;
+
+                while (last < Count && Code[last].Op == Opcode.Phi)
+                    last++;
+
+                for (int predecessor = 0; predecessor < count; predecessor++)
+                {
+                    int end = predecessors[predecessor];
+
+                    if (copies[end] == null)
+                        copies[end] = new List<Instruction>();
+
+                    AddCopies(result, copies[end], first, last, predecessor == 0);
+                }
+            }
+
+            for (int i = 0; i <= Count; i++)
+            {
+                if (copies[i] != null)
+                {
+                    foreach (Instruction copy in copies[i])
+                        result.Add(copy.Op, copy.Type, copy.Target, copy.Left);
+                }
+
+                if (i < Count && Code[i].Op != Opcode.Phi)
+                    result.Add(Code[i].Op, Code[i].Type, Code[i].Target, Code[i].Left, Code[i].Right, Code[i].Value);
+            }
+
+            return result;
+        }
+
+        // Positions of the instructions ending the predecessors of the block of the label, in the order of the code.
+        // A block entered from the instruction before its label gets its copies right before that label.
+        private int PredecessorsOf(int label, int[] labels, int[] predecessors)
+        {
+            int block = (int)Code[label].Value;
+            int count = 0;
+
+            for (int i = 0; i < Count && count < predecessors.Length; i++)
+            {
+                bool jumps = (Code[i].Op == Opcode.Jump || Code[i].Op == Opcode.Branch) && Code[i].Value == block;
+                bool fallsThrough = i == label - 1 && Code[i].Op != Opcode.Jump && Code[i].Op != Opcode.Return;
+
+                if (jumps)
+                    predecessors[count++] = i;
+
+                else if (fallsThrough)
+                    predecessors[count++] = label;
+            }
+
+            return count;
+        }
+
+        // The copies of one predecessor are made at once: when a phi reads the result of another phi of the block,
+        // every value first goes to a temporary so none is overwritten before it is read
+        private void AddCopies(IrFunction result, List<Instruction> copies, int first, int last, bool left)
+        {
+            bool overlapping = false;
+
+            for (int i = first; i < last && !overlapping; i++)
+            {
+                int source = left ? Code[i].Left : Code[i].Right;
+
+                for (int j = first; j < last; j++)
+                    overlapping |= source == Code[j].Target && i != j;
+            }
+
+            for (int i = first; i < last; i++)
+            {
+                Instruction phi = Code[i];
+                int source = left ? phi.Left : phi.Right;
+
+                if (source == phi.Target)
+                    continue;
+
+                if (!overlapping)
+                {
+                    copies.Add(new Instruction { Op = Opcode.Copy, Type = phi.Type, Target = phi.Target, Left = source, Right = -1 });
+                    continue;
+                }
+
+                int temporary = result.NewRegister(phi.Type);
+                copies.Add(new Instruction { Op = Opcode.Copy, Type = phi.Type, Target = temporary, Left = source, Right = -1 });
+                copies.Add(new Instruction { Op = Opcode.Copy, Type = phi.Type, Target = phi.Target, Left = temporary, Right = -1, Value = 1 });
+            }
+
+            // The temporaries are all written before any phi is
+            if (overlapping)
+                copies.Sort((x, y) => x.Value.CompareTo(y.Value));
+        }
+
+        // Removes the marked instructions, keeping the order of the others
+        public void Remove(bool[] removed)
+        {
+            int count = 0;
+
+            for (int i = 0; i < Count; i++)
+            {
+                if (!removed[i])
+                    Code[count++] = Code[i];
+            }
+
+            Count = count;
+        }
+
+        public void Dump(TextWriter writer)
+        {
+            writer.Write($"function {Name}(");
+
+            for (int i = 0; i < Parameters.Length; i++)
+                writer.Write((i > 0) ? ", " + TypeName(Parameters[i]) : TypeName(Parameters[i]));
+
+            writer.WriteLine((ReturnType != Word.None) ? $") -> {TypeName(ReturnType)}" : ")");
+
+            for (int i = 0; i < Count; i++)
+            {
+                Instruction instruction = Code[i];
+
+                if (instruction.Op == Opcode.Label)
+                {
+                    writer.WriteLine($"  L{instruction.Value}:");
+                    continue;
+                }
+
+                writer.Write("    ");
+
+                if (instruction.Target >= 0)
+                    writer.Write($"%{instruction.Target} = ");
+
+                writer.Write(OpcodeNames[(int)instruction.Op].ToLowerInvariant());
+
+                if (instruction.Type != Word.None)
+                    writer.Write(" " + TypeName(instruction.Type));
+
+                switch (instruction.Op)
+                {
+                    case Opcode.Constant:
+                    case Opcode.Parameter:
+                        writer.Write($" {instruction.Value}");
+                        break;
+
+                    case Opcode.Call:
+                        writer.Write($" {Callees[(int)instruction.Value]}(");
+
+                        for (int argument = 0; argument < instruction.Right; argument++)
+                            writer.Write(((argument > 0) ? ", %" : "%") + Arguments[instruction.Left + argument]);
+
+                        writer.Write(")");
+                        break;
+
+                    case Opcode.Load:
+                        writer.Write($" a{instruction.Value}[%{instruction.Left}]");
+                        break;
+
+                    case Opcode.Store:
+                        writer.Write($" a{instruction.Value}[%{instruction.Left}], %{instruction.Right}");
+                        break;
+
+                    case Opcode.Clear:
+                        writer.Write($" a{instruction.Value}[{Arrays[(int)instruction.Value].Length}]");
+                        break;
+
+                    case Opcode.Kernel:
+                        DumpKernel(writer, instruction);
+                        break;
+
+                    case Opcode.Write:
+                        writer.Write(" \"" + Escape(Strings[(int)instruction.Value]) + "\"");
+                        break;
+
+                    case Opcode.Count:
+                    {
+                        IrCounter counter = Counters[(int)instruction.Value];
+                        writer.Write($" {counter.Function}[{counter.Index}]");
+                        break;
+                    }
+
+                    case Opcode.Jump:
+                        writer.Write($" L{instruction.Value}");
+                        break;
+
+                    case Opcode.Branch:
+                        writer.Write($" %{instruction.Left}, L{instruction.Value}");
+                        break;
+
+                    default:
+                        if (instruction.Left >= 0)
+                            writer.Write($" %{instruction.Left}");
+
+                        if (instruction.Right >= 0)
+                            writer.Write($", %{instruction.Right}");
+
+                        break;
+                }
+
+                writer.WriteLine();
+            }
+        }
+
+        // The arguments, then the lanes and the operations, with the invariants numbered from zero
+        private void DumpKernel(TextWriter writer, Instruction instruction)
+        {
+            IrKernel kernel = Kernels[(int)instruction.Value];
+
+            for (int argument = 0; argument < instruction.Right; argument++)
+                writer.Write(((argument > 0) ? ", %" : " %") + Arguments[instruction.Left + argument]);
+
+            writer.Write($": {kernel.Lanes} x {TypeName(kernel.Type)}");
+
+            for (int i = 0; i < kernel.Operations.Count; i++)
+            {
+                Instruction operation = kernel.Operations[i];
+
+                writer.Write(((i > 0) ? ", " : " ") + OpcodeNames[(int)operation.Op].ToLowerInvariant());
+
+                if (operation.Op == Opcode.Load || operation.Op == Opcode.Store)
+                    writer.Write($" a{operation.Value}");
+
+                else if (operation.Op == Opcode.Parameter)
+                    writer.Write($" {operation.Value}");
+            }
+        }
+
+        private static string Escape(string text)
+        {
+            return text.Replace("\\", "\\\\").Replace("\"", "\\\"").Replace("\n", "\\n").Replace("\r", "\\r").Replace("\t", "\\t");
+        }
+
+        private static string TypeName(Word type)
+        {
+            return type.ToString().ToLowerInvariant();
+        }
+    }
+}
@@ -0,0 +1,180 @@
+﻿using System;
+
+namespace Sage
+{
+    enum Word
+    {
+        None = 0,
+
+        // Keywords
+        Function,
+        For,
+        If,
+        Else,
+        Return,
+        Use,
+        While,
+
+        // Integer types
+        I8,
+        U8,
+        I16,
+        U16,
+        I32,
+        U32,
+        I64,
+        U64
+    }
+
+    internal static class Keywords
+    {
+        private struct Entry
+        {
+            public string Text;
+            public Word Word;
+            public Token Type;
+
+            public Entry(string text, Word word, Token type)
+            {
+                Text = text;
+                Word = word;
+                Type = type;
+            }
+        }
+
+        // Every reserved word of the language, adding a new one only needs a new entry here
+        private static readonly Entry[] Entries =
+        {
+            new Entry("function", Word.Function, Token.Keyword),
+            new Entry("for", Word.For, Token.Keyword),
+            new Entry("if", Word.If, Token.Keyword),
+            new Entry("else", Word.Else, Token.Keyword),
+            new Entry("return", Word.Return, Token.Keyword),
+            new Entry("use", Word.Use, Token.Keyword),
+            new Entry("while", Word.While, Token.Keyword),
+
+            new Entry("i8", Word.I8, Token.Integer),
+            new Entry("u8", Word.U8, Token.Integer),
+            new Entry("i16", Word.I16, Token.Integer),
+            new Entry("u16", Word.U16, Token.Integer),
+            new Entry("i32", Word.I32, Token.Integer),
+            new Entry("u32", Word.U32, Token.Integer),
+            new Entry("i64", Word.I64, Token.Integer),
+            new Entry("u64", Word.U64, Token.Integer)
+        };
+
+        private static readonly Entry[] Table;
+        private static readonly uint Seed;
+        private static readonly int Shift;
+        private static readonly int MinLength = int.MaxValue;
+        private static readonly int MaxLength;
+
+        static Keywords()
+        {
+            foreach (Entry entry in Entries)
+            {
+                MinLength = Math.Min(MinLength, entry.Text.Length);
+                MaxLength = Math.Max(MaxLength, entry.Text.Length);
+            }
+
+            // Search for a seed that maps every word to its own slot, growing the table when none is found
+            for (int bits = 5; bits <= 16; bits++)
+            {
+                Table = new Entry[1 << bits];
+                Shift = 32 - bits;
+
+                for (Seed = 0x9E3779B1; Seed < 0x9E3779B1 + 4096; Seed += 2)
+                {
+                    if (TryBuild())
+                        return;
+                }
+            }
+
+            throw new InvalidOperationException("Failed to build the keyword table.");
+        }
+
+        private static bool TryBuild()
+        {
+            Array.Clear(Table, 0, Table.Length);
+
+            foreach (Entry entry in Entries)
+            {
+                string text = entry.Text;
+                int slot = Hash(text[0], text[Math.Min(1, text.Length - 1)], text[text.Length - 1], text.Length);
+
+                if (Table[slot].Text != null)
+                    return false;
+
+                Table[slot] = entry;
+            }
+
+            return true;
+        }
+
+        private static int Hash(char first, char second, char last, int length)
+        {
+            uint key = (uint)first | ((uint)second << 8) | ((uint)last << 16) | ((uint)length << 24);
+            return (int)((key * Seed) >> Shift);
+        }
+
+        // Looks up a word of the buffer, returning its type and meaning when it is reserved
+        public static bool TryLookup(char[] buffer, int start, int length, out Token type, out Word word)
+        {
+            type = Token.Name;
+            word = Word.None;
+
+            if (length < MinLength || length > MaxLength)
+                return false;
+
+            int end = start + length - 1;
+            Entry entry = Table[Hash(buffer[start], buffer[Math.Min(start + 1, end)], buffer[end], length)];
+            string text = entry.Text;
+
+            if (text == null || text.Length != length)
+                return false;
+
+            for (int i = 0; i < length; i++)
+            {
+                if (buffer[start + i] != text[i])
+                    return false;
+            }
+
+            type = entry.Type;
+            word = entry.Word;
+            return true;
+        }
+
+        public static string TextOf(Word word)
+        {
+            foreach (Entry entry in Entries)
+            {
+                if (entry.Word == word)
+                    return entry.Text;
+            }
+
+            return "";
+        }
+
+        // Size in bytes of an integer type, the types go by pairs of a signed and an unsigned type of the same size
+        public static int SizeOf(Word type)
+        {
+            return 1 << ((type - Word.I8) >> 1);
+        }
+
+        public static bool IsSigned(Word type)
+        {
+            return ((type - Word.I8) & 1) == 0;
+        }
+
+        // Wraps a value to an integer type, extended to 64 bits with its sign or with zeros as it is held in a register
+        public static long Wrap(long value, Word type)
+        {
+            int bits = SizeOf(type) * 8;
+
+            if (bits == 64)
+                return value;
+
+            return IsSigned(type) ? (value << (64 - bits)) >> (64 - bits) : (long)((ulong)value & ((1UL << bits) - 1));
+        }
+    }
+}
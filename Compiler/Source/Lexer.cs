@@ -1,7 +1,8 @@
 ﻿using System;
-using System.IO;
+using System.Globalization;
 using System.Collections.Generic;
-using System.Linq;
+using System.IO;
+using System.Text;
 
 namespace Sage
 {
@@ -15,140 +16,824 @@ namespace Sage
         String
     }
 
+    // The tokens an incremental edit replaced, and the top level functions whose tokens changed
+    internal class RelexResult
+    {
+        public int FirstToken;
+        public int RemovedTokens;
+        public int InsertedTokens;
+        public List<string> ChangedFunctions = new List<string>();
+    }
+
     internal class Lexer
     {
-        private StreamReader Reader;
-        List<string> Tokens;
+        // Powers of ten that are exact in a double, used by the fast float path
+        private static readonly double[] Powers =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        // Characters of text held at once when reading a stream
+        private const int DefaultWindow = 1 << 16;
+
+        private readonly DiagnosticBag Diagnostics;
+        private readonly IInterner Names;
+        private readonly IInterner Strings;
+        private char[] Decoded = new char[256];
+        private TokenStream Tokens;
+        private char[] Buffer;
+        private int Length;
+        private int Position;
+        private int Line;
+        private int LineStart;
+
+        // Offset of the buffer in the text and the lines seen so far, for the streams read through a window
+        private int Base;
+        private List<int> LineStarts;
 
-        public void Read(string fileName)
+        public int ErrorCount { get; private set; }
+
+        public Lexer() : this(new DiagnosticBag())
+        {
+        }
+
+        public Lexer(DiagnosticBag diagnostics) : this(diagnostics, new Interner())
         {
-            if (File.Exists(fileName))
+        }
+
+        public Lexer(DiagnosticBag diagnostics, IInterner names) : this(diagnostics, names, new Interner())
+        {
+        }
+
+        // Errors are added to the diagnostics, so each source can keep its own.
+        // Names are interned in the name pool, and decoded string literals in the constant pool.
+        public Lexer(DiagnosticBag diagnostics, IInterner names, IInterner strings)
+        {
+            Diagnostics = diagnostics;
+            Names = names;
+            Strings = strings;
+        }
+
+        public TokenStream Read(string fileName)
+        {
+            SourceFile source = Open(fileName);
+            return (source != null) ? Read(source) : null;
+        }
+
+        // Opens a source, logging the error and returning null when it cannot be read
+        public SourceFile Open(string fileName)
+        {
+            if (!File.Exists(fileName))
             {
-                Reader = new StreamReader(fileName);
+                Diagnostics.Add(DiagnosticCode.FileNotFound, -1, 0);
+                ErrorCount++;
+                return null;
+            }
+
+            try
+            {
+                return SourceFile.Open(fileName);
+            }
 
-                string line;
+            catch (Exception exception) when (exception is IOException || exception is UnauthorizedAccessException)
+            {
+                Diagnostics.Add(DiagnosticCode.FileUnreadable, -1, 0, exception.Message);
+                ErrorCount++;
+                return null;
+            }
+        }
 
-                while ((line = Reader.ReadLine()) != null)
+        // Tokenizes the whole source, the returned stream owns the source and releases it when disposed
+        public TokenStream Read(SourceFile source)
+        {
+            Buffer = source.Text;
+            Length = source.Length;
+            Base = 0;
+            Position = 0;
+            Line = 1;
+            LineStart = 0;
+
+            TokenStream tokens = Tokens = new TokenStream(source);
+            tokens.Names = Names;
+            tokens.Strings = Strings;
+            Lexeme token;
+
+            while (Next(out token))
+                tokens.Add(token);
+
+            Tokens = null;
+            Buffer = null;
+            return tokens;
+        }
+
+        // Tokenizes a source read from a stream, such as the standard input, holding only a window of its text.
+        // The window is refilled at line breaks, which no token spans, so the tokens cut by a read are scanned whole with
+        // the next one. Only a line longer than the window makes it grow.
+        public TokenStream Read(Stream stream, string fileName, int window = DefaultWindow)
+        {
+            TokenStream tokens = Tokens = new TokenStream(fileName);
+            tokens.Names = Names;
+            tokens.Strings = Strings;
+
+            Buffer = BufferPool<char>.Rent(window);
+            Base = 0;
+            Position = 0;
+            Line = 1;
+            LineStart = 0;
+            LineStarts = new List<int> { 0 };
+
+            int filled = 0;
+            bool ended = false;
+            Lexeme token;
+
+            // The byte order mark is detected as for the files, sources without one are read as UTF-8
+            using (StreamReader reader = new StreamReader(stream, new UTF8Encoding(false), true, 1 << 12, true))
+            {
+                while (true)
                 {
-                    if (line.Length > 0)
+                    // Lex up to the last line break, or to the end of the text once it was read entirely
+                    Length = ended ? filled : Buffer.AsSpan(0, filled).LastIndexOf('\n') + 1;
+
+                    while (Next(out token))
+                    {
+                        token.Offset += Base;
+                        tokens.Add(token);
+                    }
+
+                    if (ended)
+                        break;
+
+                    // Move the unfinished line to the start of the window
+                    int kept = filled - Position;
+                    Array.Copy(Buffer, Position, Buffer, 0, kept);
+                    Base += Position;
+                    LineStart -= Position;
+                    filled = kept;
+                    Position = 0;
+
+                    if (filled == Buffer.Length)
                     {
-                        // Remove commentaries
-                        line = (line.Contains("//")) ? line.Substring(0, line.IndexOf("//")) : line;
+                        char[] buffer = BufferPool<char>.Rent(Buffer.Length * 2);
+                        Array.Copy(Buffer, buffer, filled);
+                        BufferPool<char>.Return(Buffer);
+                        Buffer = buffer;
+                    }
+
+                    int read = reader.Read(Buffer, filled, Buffer.Length - filled);
+                    ended = read == 0;
+                    filled += read;
+                }
+            }
+
+            tokens.SetLength(Base + filled);
+            tokens.LineStarts = LineStarts.ToArray();
+
+            BufferPool<char>.Return(Buffer);
+            Tokens = null;
+            Buffer = null;
+            LineStarts = null;
+            Base = 0;
+            return tokens;
+        }
+
+        // Applies an edit to the source of the stream and re-lexes only the lines it touched.
+        // No token spans a line break (strings and commentaries end with their line), so the scan restarts at the line of
+        // the edit, and stops at the first line after the edit where it produces a token identical to an old one.
+        // The diagnostics must be the ones the stream was lexed with: the errors of the scanned tokens replace the old
+        // ones, and the errors of the tokens kept move with them.
+        public RelexResult Relex(TokenStream tokens, int offset, int removed, string inserted)
+        {
+            char[] old = tokens.Source;
+            int lineStart = offset;
+
+            while (lineStart > 0 && old[lineStart - 1] != '\n')
+                lineStart--;
+
+            // Count the line of the restart point from the last token before it
+            int first = tokens.FindToken(lineStart);
+            int line = (first > 0) ? tokens[first - 1].Line : 1;
+
+            for (int i = (first > 0) ? tokens[first - 1].Offset : 0; i < lineStart; i++)
+            {
+                if (old[i] == '\n')
+                    line++;
+            }
+
+            int delta = inserted.Length - removed;
+            int lineDelta = 0;
+
+            for (int i = offset; i < offset + removed; i++)
+            {
+                if (old[i] == '\n')
+                    lineDelta--;
+            }
+
+            foreach (char c in inserted)
+            {
+                if (c == '\n')
+                    lineDelta++;
+            }
 
-                        line = Separate(line, ";");
-                        line = Separate(line, "::");
+            // The tokens starting inside the removed text are always replaced
+            int resync = tokens.FindToken(offset + removed);
+            int end = offset + inserted.Length;
 
-                        line = Separate(line, "+");
-                        line = Separate(line, "-");
-                        line = Separate(line, "*");
-                        line = Separate(line, "/");
+            tokens.ReplaceText(offset, removed, inserted);
 
-                        line = Separate(line, "(");
-                        line = Separate(line, ")");
-                        line = Separate(line, "[");
-                        line = Separate(line, "]");
-                        line = Separate(line, "{");
-                        line = Separate(line, "}");
+            Tokens = tokens;
+            Buffer = tokens.Source;
+            Length = tokens.SourceLength;
+            Base = 0;
+            Position = lineStart;
+            Line = line;
+            LineStart = lineStart;
 
-                        // Tokenize the line
-                        Tokens = line.Split(' ').ToList();
+            Lexeme[] scanned = new Lexeme[16];
+            int count = 0;
+            int numbers = tokens.NumberCount;
+            int diagnostics = Diagnostics.Count;
+            bool synchronized = false;
+            Lexeme token;
 
-                        // Remove empty tokens
-                        Tokens.RemoveAll(token => token == "");
+            while (Next(out token))
+            {
+                while (resync < tokens.Count && tokens[resync].Offset + delta < token.Offset)
+                    resync++;
+
+                // Tokens on a line starting after the edit keep their column, so the old ones can be kept from there on
+                if (LineStart > end && resync < tokens.Count && IsSameToken(tokens[resync], delta, token))
+                {
+                    synchronized = true;
+                    break;
+                }
 
-                        foreach (string token in Tokens)
-                            ClassifyToken(token);
+                if (count == scanned.Length)
+                    Array.Resize(ref scanned, count * 2);
+
+                scanned[count++] = token;
+            }
+
+            // The errors of the token found identical are the ones of the old token
+            int limit = synchronized ? token.Offset : int.MaxValue;
+
+            if (!synchronized)
+                resync = tokens.Count;
+
+            Diagnostics.Replace(diagnostics, lineStart, (resync < tokens.Count) ? tokens[resync].Offset : int.MaxValue, delta, limit);
+
+            // The tokens of the line before the edit are usually scanned again unchanged
+            int skipped = 0;
+
+            while (skipped < count && first < resync && scanned[skipped].Offset + scanned[skipped].Length <= offset && IsSameToken(tokens[first], 0, scanned[skipped]))
+            {
+                skipped++;
+                first++;
+            }
+
+            if (skipped > 0)
+            {
+                count -= skipped;
+                Array.Copy(scanned, skipped, scanned, 0, count);
+            }
+
+            // The literals of the replaced tokens and the ones scanned but not kept have no token left
+            int dead = tokens.NumberCount - numbers - CountNumbers(scanned, 0, count) + CountNumbers(tokens.Items, first, resync);
+
+            RelexResult result = new RelexResult { FirstToken = first, RemovedTokens = resync - first, InsertedTokens = count };
+            tokens.Splice(first, resync - first, scanned, count, delta, lineDelta);
+            tokens.ReleaseNumbers(dead);
+
+            if (result.RemovedTokens > 0 || result.InsertedTokens > 0)
+                FindChangedFunctions(tokens, result);
+
+            Tokens = null;
+            Buffer = null;
+            return result;
+        }
+
+        private static int CountNumbers(Lexeme[] tokens, int start, int end)
+        {
+            int count = 0;
+
+            for (int i = start; i < end; i++)
+            {
+                if (tokens[i].Type == Token.Number)
+                    count++;
+            }
+
+            return count;
+        }
 
+        private bool IsSameToken(Lexeme old, int delta, Lexeme token)
+        {
+            if (old.Offset + delta != token.Offset || old.Length != token.Length || old.Type != token.Type)
+                return false;
+
+            // Number literals refer to their own entry of the table, the text is the same anyway
+            return old.Type == Token.Number || old.Value == token.Value;
+        }
+
+        // Collects the top level functions whose tokens overlap the replaced ones, walking the braces of the stream
+        private void FindChangedFunctions(TokenStream tokens, RelexResult result)
+        {
+            int first = result.FirstToken;
+            int last = first + Math.Max(result.InsertedTokens, 1) - 1;
+            int function = -1;
+            int depth = 0;
+
+            for (int i = 0; i < tokens.Count && (function >= 0 || i <= last); i++)
+            {
+                Lexeme token = tokens[i];
+
+                if (token.Type == Token.Keyword && token.Value == (int)Word.Function && depth == 0)
+                    function = i;
+
+                else if (token.Type == Token.Operator && token.Length == 1)
+                {
+                    char c = (char)token.Value;
+
+                    if (c == '{')
+                        depth++;
+
+                    else if (c == '}' && depth > 0 && --depth == 0 && function >= 0)
+                    {
+                        if (i >= first)
+                        {
+                            AddChangedFunction(tokens, function, result);
+
+                            if (i >= last)
+                                return;
+                        }
+
+                        function = -1;
                     }
                 }
             }
 
+            // A function that is not closed yet runs until the end of the stream
+            if (function >= 0)
+                AddChangedFunction(tokens, function, result);
+        }
+
+        private void AddChangedFunction(TokenStream tokens, int keyword, RelexResult result)
+        {
+            if (keyword + 1 < tokens.Count && tokens[keyword + 1].Type == Token.Name)
+                result.ChangedFunctions.Add(tokens.Names.GetText(tokens[keyword + 1].Value));
+
             else
-                Console.WriteLine($"[ERROR] Failed to read the file \"{fileName}\".");
+                result.ChangedFunctions.Add("<unnamed>");
         }
 
-        private string Separate(string text, string newText)
+        // Scans the next token as a slice of the buffer
+        private bool Next(out Lexeme token)
         {
-            if (text.Contains(newText))
-                text = text.Replace(newText, $" {newText} ");
+            while (Position < Length)
+            {
+                char c = Buffer[Position];
+
+                // Skip whitespaces and keep track of the lines, runs of indentation are skipped four characters at a time
+                if (c == ' ' || c == '\t')
+                {
+                    Position = CharClass.SkipBlanks(Buffer, Position + 1, Length);
+                    continue;
+                }
+
+                if (c == '\r' || c == '\n')
+                {
+                    if (c == '\n')
+                    {
+                        Line++;
+                        LineStart = Position + 1;
+
+                        if (LineStarts != null)
+                            LineStarts.Add(Base + LineStart);
+                    }
 
-            return text;
+                    Position++;
+                    continue;
+                }
+
+                // Skip commentaries until the end of the line
+                if (c == '/' && Position + 1 < Length && Buffer[Position + 1] == '/')
+                {
+                    Position = CharClass.FindLineEnd(Buffer, Position + 2, Length);
+                    continue;
+                }
+
+                int start = Position;
+                token = new Lexeme(Token.Name, start, 0, Line, start - LineStart + 1);
+
+                if (c >= '0' && c <= '9')
+                {
+                    ScanNumber(ref token);
+                    return true;
+                }
+
+                if (CharClass.IsWordChar(c))
+                {
+                    Position = CharClass.SkipWord(Buffer, Position + 1, Length);
+                    token.Length = Position - start;
+                    ClassifyWord(ref token);
+                    return true;
+                }
+
+                if (c == '"')
+                {
+                    ScanString(ref token);
+                    return true;
+                }
+
+                token.Length = OperatorLength(Position);
+
+                if (token.Length > 0)
+                {
+                    token.Type = Token.Operator;
+                    token.Value = Lexeme.OperatorOf(c, (token.Length == 2) ? Buffer[Position + 1] : '\0');
+                    Position += token.Length;
+                    return true;
+                }
+
+                // Unknown characters are kept as single character names, interned as the others so they never take the
+                // symbol of another name
+                Position++;
+                token.Length = 1;
+                token.Value = Names.Intern(Buffer, start, 1);
+                return true;
+            }
+
+            token = default(Lexeme);
+            return false;
         }
 
-        private void ClassifyToken(string token)
+        private void ClassifyWord(ref Lexeme token)
         {
-            // Remove any tabs from the token
-            token = token.Replace("\t", "");
+            Token type;
+            Word word;
 
-            // Check if the token is a keyword
-            if (IsKeyword(token))
+            // Check if the token is a keyword or an integer
+            if (Keywords.TryLookup(Buffer, token.Offset, token.Length, out type, out word))
             {
-                Console.WriteLine($"{{ Value: \"{token}\" | Type: {Token.Keyword} }}");
+                token.Type = type;
+                token.Value = (int)word;
                 return;
             }
 
-            // Check if the token is an operator
-            if (IsOperator(token))
+            // Otherwise, consider the token as a name
+            token.Type = Token.Name;
+            token.Value = Names.Intern(Buffer, token.Offset, token.Length);
+        }
+
+        // Operators are recognized by their first character, then by the following one
+        private int OperatorLength(int position)
+        {
+            char next = (position + 1 < Length) ? Buffer[position + 1] : '\0';
+
+            switch (Buffer[position])
             {
-                Console.WriteLine($"{{ Value: \"{token}\" | Type: {Token.Operator} }}");
-                return;
+                case '-':
+                    return (next == '>') ? 2 : 1;
+
+                case ':':
+                    return (next == ':') ? 2 : 0;
+
+                case '=': case '<': case '>':
+                    return (next == '=') ? 2 : 1;
+
+                case '!':
+                    return (next == '=') ? 2 : 0;
+
+                case '+': case '*': case '/': case ';': case ',':
+                case '(': case ')': case '[': case ']': case '{': case '}':
+                    return 1;
+
+                default:
+                    return 0;
             }
+        }
 
-            // Check if the token is a string
-            if (IsString(token))
+        // Scans a string literal, storing its decoded content in the constant pool.
+        // Literals end with their line, so an edit never needs to re-lex more than the lines it touched.
+        private void ScanString(ref Lexeme token)
+        {
+            int start = ++Position;
+            bool escaped = false;
+
+            // Runs of plain characters are skipped four at a time, up to the next quote, backslash or line break
+            while ((Position = CharClass.FindStringStop(Buffer, Position, Length)) < Length && Buffer[Position] == '\\')
             {
-                Console.WriteLine($"{{ Value: \"{token}\" | Type: {Token.String} }}");
-                return;
+                escaped = true;
+                Position++;
+
+                if (Position < Length && Buffer[Position] == '\n')
+                    break;
+
+                if (Position < Length)
+                    Position++;
             }
 
-            // Check if the token is an integer
-            if (IsInteger(token))
+            int end = Position;
+            bool closed = Position < Length && Buffer[Position] == '"';
+
+            if (closed)
+                Position++;
+
+            token.Type = Token.String;
+            token.Length = Position - token.Offset;
+
+            if (!closed)
+                Error(token, DiagnosticCode.UnterminatedString);
+
+            // Literals without escapes are interned straight from the source
+            if (!escaped)
             {
-                Console.WriteLine($"{{ Value: \"{token}\" | Type: {Token.Integer} }}");
+                token.Value = Strings.Intern(Buffer, start, end - start);
                 return;
             }
 
-            // Check if the token is an integer
-            if (IsNumber(token))
+            int length = 0;
+
+            for (int i = start; i < end; i++)
             {
-                Console.WriteLine($"{{ Value: \"{token}\" | Type: {Token.Number} }}");
-                return;
+                if (length + 2 > Decoded.Length)
+                    Array.Resize(ref Decoded, Decoded.Length * 2);
+
+                char c = Buffer[i];
+
+                if (c != '\\')
+                {
+                    Decoded[length++] = c;
+                    continue;
+                }
+
+                // A backslash ending an unterminated literal was already reported with it
+                if (++i >= end)
+                {
+                    if (closed)
+                        Error(token, DiagnosticCode.InvalidEscape);
+
+                    break;
+                }
+
+                switch (Buffer[i])
+                {
+                    case 'n': Decoded[length++] = '\n'; break;
+                    case 'r': Decoded[length++] = '\r'; break;
+                    case 't': Decoded[length++] = '\t'; break;
+                    case '0': Decoded[length++] = '\0'; break;
+                    case '\\': Decoded[length++] = '\\'; break;
+                    case '"': Decoded[length++] = '"'; break;
+                    case '\'': Decoded[length++] = '\''; break;
+
+                    // \xHH and \u{H...} give the code of the character
+                    case 'x':
+                    case 'u':
+                        int code = 0;
+                        int digits = 0;
+                        bool braces = Buffer[i] == 'u';
+
+                        if (braces && (i + 1 >= end || Buffer[++i] != '{'))
+                        {
+                            Error(token, DiagnosticCode.ExpectedUnicodeBrace);
+                            break;
+                        }
+
+                        while (i + 1 < end && digits < (braces ? 6 : 2) && DigitValue(Buffer[i + 1], 16) >= 0 && DigitValue(Buffer[i + 1], 16) < 16)
+                        {
+                            code = code * 16 + DigitValue(Buffer[++i], 16);
+                            digits++;
+                        }
+
+                        if (braces && (i + 1 >= end || Buffer[++i] != '}'))
+                            digits = 0;
+
+                        if (digits == 0 || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+                        {
+                            Error(token, DiagnosticCode.InvalidEscape);
+                            break;
+                        }
+
+                        if (code > 0xFFFF)
+                        {
+                            string pair = char.ConvertFromUtf32(code);
+                            Decoded[length++] = pair[0];
+                            Decoded[length++] = pair[1];
+                        }
+
+                        else
+                            Decoded[length++] = (char)code;
+
+                        break;
+
+                    default:
+                        Error(token, DiagnosticCode.InvalidEscape);
+                        break;
+                }
             }
 
-            // Otherwise, consider the token as a name
-            Console.WriteLine($"{{ Value: \"{token}\" | Type: {Token.Name} }}");
+            token.Value = Strings.Intern(Decoded, 0, length);
         }
 
-        private bool IsKeyword(string token)
+        // Scans an integer or float literal and stores its value in the literal table
+        private void ScanNumber(ref Lexeme token)
         {
-            // List of keywords
-            string[] keywords = { "function", "for", "if", "return", "use", "while" };
-            return Array.Exists(keywords, k => k == token);
+            int start = Position;
+            int radix = 10;
+
+            if (Buffer[Position] == '0' && Position + 1 < Length)
+            {
+                char prefix = Buffer[Position + 1];
+
+                if (prefix == 'x' || prefix == 'X')
+                    radix = 16;
+
+                else if (prefix == 'b' || prefix == 'B')
+                    radix = 2;
+
+                if (radix != 10)
+                    Position += 2;
+            }
+
+            ulong value = 0;
+            int digits = 0;
+            int significant = 0;
+            bool overflow = false;
+            int digit;
+
+            while (Position < Length && (digit = DigitValue(Buffer[Position], radix)) >= 0)
+            {
+                Position++;
+
+                if (digit == 16)
+                    continue;
+
+                digits++;
+
+                if (value > (ulong.MaxValue - (ulong)digit) / (ulong)radix)
+                    overflow = true;
+
+                else
+                    value = value * (ulong)radix + (ulong)digit;
+
+                if (value != 0)
+                    significant++;
+            }
+
+            NumberLiteral literal = new NumberLiteral();
+            bool valid = digits > 0;
+
+            // A fraction or an exponent turns a decimal literal into a float
+            if (radix == 10 && valid && IsFloatPart())
+            {
+                int exponent = 0;
+
+                if (Buffer[Position] == '.')
+                {
+                    Position++;
+
+                    while (Position < Length && (digit = DigitValue(Buffer[Position], 10)) >= 0)
+                    {
+                        Position++;
+
+                        if (digit == 16)
+                            continue;
+
+                        if (value <= (ulong.MaxValue - 9) / 10)
+                        {
+                            value = value * 10 + (ulong)digit;
+                            exponent--;
+
+                            if (value != 0)
+                                significant++;
+                        }
+                    }
+                }
+
+                if (Position < Length && (Buffer[Position] == 'e' || Buffer[Position] == 'E'))
+                {
+                    Position++;
+
+                    int sign = 1;
+                    int power = 0;
+
+                    if (Position < Length && (Buffer[Position] == '+' || Buffer[Position] == '-'))
+                        sign = (Buffer[Position++] == '-') ? -1 : 1;
+
+                    valid = Position < Length && Buffer[Position] >= '0' && Buffer[Position] <= '9';
+
+                    while (Position < Length && Buffer[Position] >= '0' && Buffer[Position] <= '9')
+                        power = Math.Min(power * 10 + (Buffer[Position++] - '0'), 100000);
+
+                    exponent += sign * power;
+                }
+
+                double result;
+
+                overflow = !ParseFloat(start, value, significant, exponent, overflow, out result);
+                literal.IsFloat = true;
+                literal.Value = (ulong)BitConverter.DoubleToInt64Bits(result);
+            }
+
+            else
+                literal.Value = value;
+
+            // An integer type can follow the digits, for example 255u8
+            int suffix = Position;
+
+            Position = CharClass.SkipWord(Buffer, Position, Length);
+
+            if (Position > suffix)
+            {
+                Token type;
+                Word word;
+
+                if (!literal.IsFloat && Keywords.TryLookup(Buffer, suffix, Position - suffix, out type, out word) && type == Token.Integer)
+                    literal.Type = word;
+
+                else
+                    valid = false;
+            }
+
+            token.Type = Token.Number;
+            token.Length = Position - start;
+
+            if (!valid)
+                Error(token, DiagnosticCode.InvalidNumber);
+
+            else if (overflow || !Fits(literal))
+                Error(token, DiagnosticCode.NumberTooLarge);
+
+            token.Value = Tokens.AddNumber(literal);
+        }
+
+        private bool IsFloatPart()
+        {
+            if (Position >= Length)
+                return false;
+
+            if (Buffer[Position] == '.')
+                return Position + 1 < Length && Buffer[Position + 1] >= '0' && Buffer[Position + 1] <= '9';
+
+            return Buffer[Position] == 'e' || Buffer[Position] == 'E';
         }
 
-        private bool IsOperator(string token)
+        // Returns the value of a digit in the radix, 16 for separators and -1 for anything else
+        private int DigitValue(char c, int radix)
         {
-            // List of operators
-            string[] operators = { "+", "-", "*", "/", "=", ";", "->", "(", ")", "[", "]", "{", "}" };
-            return Array.Exists(operators, op => op == token);
+            int digit;
+
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+
+            else if (c >= 'a' && c <= 'f')
+                digit = c - 'a' + 10;
+
+            else if (c >= 'A' && c <= 'F')
+                digit = c - 'A' + 10;
+
+            else if (c == '_')
+                return 16;
+
+            else
+                return -1;
+
+            return (digit < radix) ? digit : -1;
         }
 
-        private bool IsString(string token)
+        private bool ParseFloat(int start, ulong mantissa, int significant, int exponent, bool overflow, out double result)
         {
-            // Check if the token starts and ends with double quotes
-            return token.StartsWith("\"") && token.EndsWith("\"");
+            // Small mantissas scaled by exact powers of ten are rounded correctly in a single operation
+            if (!overflow && significant <= 15 && exponent >= -22 && exponent <= 22)
+            {
+                result = (exponent < 0) ? mantissa / Powers[-exponent] : mantissa * Powers[exponent];
+                return true;
+            }
+
+            string text = new string(Buffer, start, Position - start).Replace("_", "");
+            return double.TryParse(text, NumberStyles.Float, CultureInfo.InvariantCulture, out result) && !double.IsInfinity(result);
         }
 
-        private bool IsInteger(string token)
+        // The minus of a negative literal is a token of its own, so the signed types also take the magnitude of their
+        // minimum, such as 128i8 for -128i8. The parser rejects it when it is not negated.
+        private bool Fits(NumberLiteral literal)
         {
-            string[] integers = { "i8", "u8", "i16", "u16", "i32", "u32", "i64", "u64" };
-            return Array.Exists(integers, k => k == token);
+            switch (literal.Type)
+            {
+                case Word.I8: return literal.Value <= (ulong)sbyte.MaxValue + 1;
+                case Word.U8: return literal.Value <= byte.MaxValue;
+                case Word.I16: return literal.Value <= (ulong)short.MaxValue + 1;
+                case Word.U16: return literal.Value <= ushort.MaxValue;
+                case Word.I32: return literal.Value <= (ulong)int.MaxValue + 1;
+                case Word.U32: return literal.Value <= uint.MaxValue;
+                case Word.I64: return literal.Value <= (ulong)long.MaxValue + 1;
+                default: return true;
+            }
         }
 
-        private bool IsNumber(string token)
+        private void Error(Lexeme token, DiagnosticCode code)
         {
-            string[] numbers = { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9" };
-            return Array.Exists(numbers, k => k == token);
+            Diagnostics.Add(code, Base + token.Offset, token.Length);
+            ErrorCount++;
         }
     }
 }
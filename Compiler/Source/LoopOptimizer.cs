@@ -0,0 +1,351 @@
+﻿using System.Collections.Generic;
+
+namespace Sage
+{
+    // The passes of -O2 over the loops of a function: moving the invariant instructions before the loop, replacing
+    // the multiplications of an induction variable by an addition in the loop, and merging the induction variables
+    // that always hold the same value. The loops come from structured statements: a loop runs from the label of its
+    // header to the jump going back to it, and the code before its header only enters it from the top.
+    internal static class LoopOptimizer
+    {
+        // A phi of a loop header whose value from the end of the loop is the phi plus or minus an invariant step
+        private struct InductionVariable
+        {
+            public int Phi;
+            public int Step;
+        }
+
+        // Returns true when some loop changed, the inner loops come before the loops containing them
+        public static bool Optimize(IrFunction function)
+        {
+            bool changed = false;
+            int header;
+            int end;
+
+            for (int loop = 0; FindLoop(function, loop, out header, out end); loop++)
+            {
+                changed |= Hoist(function, header, end);
+
+                FindLoop(function, loop, out header, out end);
+                changed |= ReduceStrength(function, header, end);
+
+                FindLoop(function, loop, out header, out end);
+                changed |= MergeInductionVariables(function, header, end);
+            }
+
+            return changed;
+        }
+
+        // The label and the jump back of the loop with the given index, in the order of their jumps
+        private static bool FindLoop(IrFunction function, int index, out int header, out int end)
+        {
+            Instruction[] code = function.Code;
+            int[] labels = new int[function.BlockCount];
+
+            for (int i = 0; i < labels.Length; i++)
+                labels[i] = -1;
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                if (code[i].Op == Opcode.Label)
+                    labels[(int)code[i].Value] = i;
+
+                else if (code[i].Op == Opcode.Jump && labels[(int)code[i].Value] >= 0 && index-- == 0)
+                {
+                    header = labels[(int)code[i].Value];
+                    end = i;
+                    return true;
+                }
+            }
+
+            header = -1;
+            end = -1;
+            return false;
+        }
+
+        // Moves the instructions of the loop that read no value computed in the loop right before its header. Only the
+        // instructions that cannot fault are moved, as the loop may not run them at all.
+        private static bool Hoist(IrFunction function, int header, int end)
+        {
+            Instruction[] code = function.Code;
+            int[] definitions = DefinitionsOf(function);
+            bool[] invariant = new bool[function.Registers.Count];
+            List<int> hoisted = new List<int>();
+
+            for (int i = header + 1; i < end; i++)
+            {
+                Instruction instruction = code[i];
+
+                if (!IsPure(instruction, code, definitions))
+                    continue;
+
+                if (IsInvariant(instruction.Left, header, definitions, invariant) && IsInvariant(instruction.Right, header, definitions, invariant))
+                {
+                    invariant[instruction.Target] = true;
+                    hoisted.Add(i);
+                }
+            }
+
+            if (hoisted.Count == 0)
+                return false;
+
+            Instruction[] result = new Instruction[code.Length];
+            bool[] moved = new bool[function.Count];
+            int count = 0;
+
+            for (int i = 0; i < header; i++)
+                result[count++] = code[i];
+
+            foreach (int i in hoisted)
+            {
+                result[count++] = code[i];
+                moved[i] = true;
+            }
+
+            for (int i = header; i < function.Count; i++)
+            {
+                if (!moved[i])
+                    result[count++] = code[i];
+            }
+
+            function.SetCode(result, count);
+            return true;
+        }
+
+        // Divisions fault on zero and on the overflowing division by -1, so only the ones by other constants are pure
+        private static bool IsPure(Instruction instruction, Instruction[] code, int[] definitions)
+        {
+            switch (instruction.Op)
+            {
+                case Opcode.Constant:
+                case Opcode.Copy:
+                case Opcode.Convert:
+                case Opcode.Add:
+                case Opcode.Subtract:
+                case Opcode.Multiply:
+                case Opcode.Negate:
+                case Opcode.Equal:
+                case Opcode.NotEqual:
+                case Opcode.Less:
+                case Opcode.LessEqual:
+                case Opcode.Greater:
+                case Opcode.GreaterEqual:
+                    return true;
+
+                case Opcode.Divide:
+                {
+                    Instruction divisor = code[definitions[instruction.Right]];
+                    return divisor.Op == Opcode.Constant && divisor.Value != 0 && divisor.Value != -1;
+                }
+
+                default:
+                    return false;
+            }
+        }
+
+        private static bool IsInvariant(int register, int header, int[] definitions, bool[] invariant)
+        {
+            return register < 0 || definitions[register] < header || invariant[register];
+        }
+
+        // Replaces every multiplication of an induction variable by an invariant with a new induction variable, which
+        // starts at the product of the start and steps by the product of the step
+        private static bool ReduceStrength(IrFunction function, int header, int end)
+        {
+            Instruction[] code = function.Code;
+            int[] definitions = DefinitionsOf(function);
+            List<InductionVariable> variables = InductionVariablesOf(function, header, end, definitions);
+
+            if (variables.Count == 0)
+                return false;
+
+            // The instructions inserted before every position, and the new phis by variable and factor
+            List<Instruction>[] inserted = new List<Instruction>[function.Count + 1];
+            Dictionary<long, int> reduced = new Dictionary<long, int>();
+
+            for (int i = header + 1; i < end; i++)
+            {
+                Instruction multiply = code[i];
+
+                if (multiply.Op != Opcode.Multiply)
+                    continue;
+
+                foreach (InductionVariable variable in variables)
+                {
+                    Instruction phi = code[variable.Phi];
+                    int factor = (multiply.Left == phi.Target) ? multiply.Right : (multiply.Right == phi.Target) ? multiply.Left : -1;
+
+                    if (factor < 0 || multiply.Type != phi.Type || definitions[factor] >= header)
+                        continue;
+
+                    long key = ((long)phi.Target << 32) | (uint)factor;
+                    int register;
+
+                    if (!reduced.TryGetValue(key, out register))
+                    {
+                        Instruction step = code[variable.Step];
+                        int start = function.NewRegister(phi.Type);
+                        int stride = function.NewRegister(phi.Type);
+                        int next = function.NewRegister(phi.Type);
+
+                        register = function.NewRegister(phi.Type);
+                        reduced[key] = register;
+
+                        Insert(inserted, header, Opcode.Multiply, phi.Type, start, phi.Left, factor);
+                        Insert(inserted, header, Opcode.Multiply, phi.Type, stride, InvariantOf(step, phi.Target), factor);
+                        Insert(inserted, header + 1, Opcode.Phi, phi.Type, register, start, next);
+                        Insert(inserted, variable.Step + 1, step.Op, phi.Type, next, register, stride);
+                    }
+
+                    code[i] = new Instruction { Op = Opcode.Copy, Type = multiply.Type, Target = multiply.Target, Left = register, Right = -1 };
+                    break;
+                }
+            }
+
+            if (reduced.Count == 0)
+                return false;
+
+            Instruction[] result = new Instruction[function.Count + reduced.Count * 4];
+            int count = 0;
+
+            for (int i = 0; i <= function.Count; i++)
+            {
+                if (inserted[i] != null)
+                {
+                    foreach (Instruction instruction in inserted[i])
+                        result[count++] = instruction;
+                }
+
+                if (i < function.Count)
+                    result[count++] = code[i];
+            }
+
+            function.SetCode(result, count);
+            return true;
+        }
+
+        // Makes the uses of an induction variable read another one with the same start and the same step, the phi
+        // left without uses is then removed with its step as dead code
+        private static bool MergeInductionVariables(IrFunction function, int header, int end)
+        {
+            Instruction[] code = function.Code;
+            int[] definitions = DefinitionsOf(function);
+            List<InductionVariable> variables = InductionVariablesOf(function, header, end, definitions);
+            bool changed = false;
+
+            for (int i = 0; i < variables.Count; i++)
+            {
+                for (int j = i + 1; j < variables.Count; j++)
+                {
+                    Instruction first = code[variables[i].Phi];
+                    Instruction second = code[variables[j].Phi];
+                    Instruction firstStep = code[variables[i].Step];
+                    Instruction secondStep = code[variables[j].Step];
+
+                    if (first.Type != second.Type || firstStep.Op != secondStep.Op)
+                        continue;
+
+                    if (!IsSame(first.Left, second.Left, code, definitions) || !IsSame(InvariantOf(firstStep, first.Target), InvariantOf(secondStep, second.Target), code, definitions))
+                        continue;
+
+                    Rename(function, variables[j].Phi, second.Target, first.Target);
+                    variables.RemoveAt(j--);
+                    changed = true;
+                }
+            }
+
+            return changed;
+        }
+
+        // The phis of the header that step by an invariant, through an instruction of the loop reading the phi
+        private static List<InductionVariable> InductionVariablesOf(IrFunction function, int header, int end, int[] definitions)
+        {
+            Instruction[] code = function.Code;
+            List<InductionVariable> variables = new List<InductionVariable>();
+
+            for (int i = header + 1; i < end && code[i].Op == Opcode.Phi; i++)
+            {
+                int step = definitions[code[i].Right];
+
+                if (step <= header || step >= end)
+                    continue;
+
+                Instruction instruction = code[step];
+                bool adds = instruction.Op == Opcode.Add && (instruction.Left == code[i].Target || instruction.Right == code[i].Target);
+                bool subtracts = instruction.Op == Opcode.Subtract && instruction.Left == code[i].Target;
+
+                if ((adds || subtracts) && instruction.Type == code[i].Type && definitions[InvariantOf(instruction, code[i].Target)] < header)
+                    variables.Add(new InductionVariable { Phi = i, Step = step });
+            }
+
+            return variables;
+        }
+
+        // The operand of a step that is not the induction variable
+        private static int InvariantOf(Instruction step, int phi)
+        {
+            return (step.Left == phi) ? step.Right : step.Left;
+        }
+
+        // The same register, or constants of the same value
+        private static bool IsSame(int left, int right, Instruction[] code, int[] definitions)
+        {
+            if (left == right)
+                return true;
+
+            Instruction first = code[definitions[left]];
+            Instruction second = code[definitions[right]];
+            return first.Op == Opcode.Constant && second.Op == Opcode.Constant && first.Type == second.Type && first.Value == second.Value;
+        }
+
+        private static void Rename(IrFunction function, int skipped, int from, int to)
+        {
+            Instruction[] code = function.Code;
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                Opcode op = code[i].Op;
+
+                if (i == skipped || IrFunction.HasArguments(op) || op == Opcode.Constant || op == Opcode.Parameter)
+                    continue;
+
+                if (code[i].Left == from)
+                    code[i].Left = to;
+
+                if (code[i].Right == from)
+                    code[i].Right = to;
+            }
+
+            for (int i = 0; i < function.Arguments.Count; i++)
+            {
+                if (function.Arguments[i] == from)
+                    function.Arguments[i] = to;
+            }
+        }
+
+        private static void Insert(List<Instruction>[] inserted, int position, Opcode op, Word type, int target, int left, int right)
+        {
+            if (inserted[position] == null)
+                inserted[position] = new List<Instruction>();
+
+            inserted[position].Add(new Instruction { Op = op, Type = type, Target = target, Left = left, Right = right });
+        }
+
+        // The position of the instruction defining every register, -1 for the registers defined nowhere
+        private static int[] DefinitionsOf(IrFunction function)
+        {
+            int[] definitions = new int[function.Registers.Count];
+
+            for (int i = 0; i < definitions.Length; i++)
+                definitions[i] = -1;
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                if (function.Code[i].Target >= 0)
+                    definitions[function.Code[i].Target] = i;
+            }
+
+            return definitions;
+        }
+    }
+}
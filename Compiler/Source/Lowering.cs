@@ -0,0 +1,798 @@
+﻿using System.Collections.Generic;
+
+namespace Sage
+{
+    // Lowers the functions of an analyzed module from its syntax tree to the instructions of the backend.
+    // Every expression is lowered to the type its context asks for, inserting conversions where the types differ.
+    internal class Lowering
+    {
+        // A function of the program as seen from its callers
+        private struct Signature
+        {
+            public string Name;
+            public Word ReturnType;
+            public Word[] Parameters;
+        }
+
+        private readonly ModuleGraph Graph;
+        private readonly Vectorizer Vectorizer;
+        private readonly bool Instrument;
+        private readonly Profile Profile;
+        private Module Module;
+        private Ast Tree;
+        private TokenStream Tokens;
+        private IrFunction Function;
+        private bool Terminated;
+        private int ErrorCount;
+
+        // The times the code being lowered ran in the profile, for the functions it has counts of
+        private long Count;
+
+        // The register holding the current value of every variable, by the node of its parameter or declaration, and
+        // the number of every array
+        private int[] Registers;
+
+        // The vectorizer is only given for the native code at -O2 and above. Instrumented functions count their calls
+        // and branches for --profile-generate, and the counts of a profile are given to the blocks for --profile-use.
+        public Lowering(ModuleGraph graph, Vectorizer vectorizer = null, bool instrument = false, Profile profile = null)
+        {
+            Graph = graph;
+            Vectorizer = vectorizer;
+            Instrument = instrument;
+            Profile = profile;
+        }
+
+        // Returns the functions of the module, or null when some of them cannot be lowered
+        public List<IrFunction> Lower(Module module)
+        {
+            List<IrFunction> functions = new List<IrFunction>();
+
+            Module = module;
+            Tree = module.Tree;
+            Tokens = module.Tree.Tokens;
+            Registers = new int[Tree.Count];
+            ErrorCount = 0;
+
+            Node[] nodes = Tree.Nodes;
+
+            for (int item = nodes[Tree.Root].Left; item >= 0; item = nodes[item].Next)
+            {
+                if (nodes[item].Kind == NodeKind.Function)
+                    functions.Add(LowerFunction(item));
+            }
+
+            Module = null;
+            Tree = null;
+            Tokens = null;
+            Registers = null;
+            Function = null;
+            return (ErrorCount == 0) ? functions : null;
+        }
+
+        private IrFunction LowerFunction(int node)
+        {
+            Signature signature = SignatureOf(Module, node);
+            Node function = Tree.Nodes[node];
+
+            Function = new IrFunction(signature.Name, signature.ReturnType, signature.Parameters);
+            Function.Instrumented = Instrument;
+            Terminated = false;
+            Count = 0;
+
+            long calls;
+
+            if (Profile != null && Profile.TryGetCalls(signature.Name, out calls))
+            {
+                Function.SetProfile(calls);
+                Count = calls;
+            }
+
+            int index = 0;
+
+            for (int parameter = function.Left; parameter >= 0; parameter = Tree.Nodes[parameter].Next, index++)
+            {
+                Word type = signature.Parameters[index];
+                int register = Function.NewRegister(type);
+
+                Function.Add(Opcode.Parameter, type, register, value: index);
+                Registers[parameter] = register;
+            }
+
+            if (Instrument)
+                AddCounter();
+
+            LowerBlock(function.Right);
+
+            if (!Terminated)
+            {
+                if (signature.ReturnType == Word.None)
+                    Function.Add(Opcode.Return, Word.None, -1);
+
+                else
+                    Error(function.Token, DiagnosticCode.MissingReturn);
+            }
+
+            return Function;
+        }
+
+        private void LowerBlock(int node)
+        {
+            for (int statement = Tree.Nodes[node].Left; statement >= 0 && !Terminated; statement = Tree.Nodes[statement].Next)
+                LowerStatement(statement);
+        }
+
+        private void LowerStatement(int node)
+        {
+            Node statement = Tree.Nodes[node];
+
+            switch (statement.Kind)
+            {
+                case NodeKind.Block:
+                    LowerBlock(node);
+                    break;
+
+                case NodeKind.Declaration:
+                {
+                    Word type = (Word)Tokens[statement.Extra].Value;
+
+                    // The elements of an array start at zero whenever its declaration is reached again
+                    if (statement.Right >= 0)
+                    {
+                        Registers[node] = Function.Arrays.Count;
+                        Function.Arrays.Add(new IrArray { Type = type, Length = (int)Tokens.Numbers[Tokens[Tree.Nodes[statement.Right].Token].Value].Value });
+                        Function.Add(Opcode.Clear, type, -1, value: Registers[node]);
+                        break;
+                    }
+
+                    int register = Function.NewRegister(type);
+
+                    // Variables without an initial value start at zero
+                    if (statement.Left >= 0)
+                        Function.Add(Opcode.Copy, type, register, LowerExpression(statement.Left, type));
+
+                    else
+                        Function.Add(Opcode.Constant, type, register, value: 0);
+
+                    Registers[node] = register;
+                    break;
+                }
+
+                case NodeKind.Assignment:
+                {
+                    int variable = Module.Bindings[node];
+
+                    if (variable >= 0 && statement.Right >= 0)
+                    {
+                        Word type = TypeOfVariable(variable);
+                        int index = LowerExpression(statement.Right, Word.I64);
+
+                        Function.Add(Opcode.Store, type, -1, index, LowerExpression(statement.Left, type), Registers[variable]);
+                    }
+
+                    // Every assignment defines a new register, which the variable then refers to
+                    else if (variable >= 0)
+                    {
+                        Word type = TypeOfVariable(variable);
+                        int value = LowerExpression(statement.Left, type);
+
+                        Registers[variable] = Function.NewRegister(type);
+                        Function.Add(Opcode.Copy, type, Registers[variable], value);
+                    }
+
+                    break;
+                }
+
+                case NodeKind.Return:
+                    if (Function.ReturnType == Word.None && statement.Left >= 0)
+                        Error(statement.Token, DiagnosticCode.ReturnFromNothing);
+
+                    else if (Function.ReturnType != Word.None && statement.Left < 0)
+                        Error(statement.Token, DiagnosticCode.MissingReturnValue);
+
+                    else
+                        Function.Add(Opcode.Return, Word.None, -1, (statement.Left >= 0) ? LowerExpression(statement.Left, Function.ReturnType) : -1);
+
+                    Terminated = true;
+                    break;
+
+                case NodeKind.Expression:
+                    LowerExpression(statement.Left, Word.None);
+                    break;
+
+                case NodeKind.If:
+                    LowerIf(node);
+                    break;
+
+                case NodeKind.While:
+                    LowerWhile(node);
+                    break;
+            }
+        }
+
+        // The then block falls through from the branch, the else block is jumped to, and the variables either block
+        // assigns get a phi where both meet
+        private void LowerIf(int node)
+        {
+            Node statement = Tree.Nodes[node];
+            List<int> variables = AssignedVariables(node);
+            int[] before = ValuesOf(variables);
+            int otherwise = Function.NewBlock();
+            long held;
+            long failed;
+
+            CountBranch(statement, out held, out failed);
+
+            if (Instrument)
+                AddCounter();
+
+            LowerCondition(statement.Left, otherwise);
+            AddLabel(Function.NewBlock(), held);
+
+            if (Instrument)
+                AddCounter();
+
+            LowerStatement(statement.Right);
+
+            bool thenTerminated = Terminated;
+            int[] then = ValuesOf(variables);
+            long thenCount = thenTerminated ? 0 : Count;
+
+            Terminated = false;
+
+            if (statement.Extra < 0)
+            {
+                AddLabel(otherwise, thenCount + failed);
+
+                // The branch comes first in the code, so the values from before the statement are on the left
+                if (thenTerminated)
+                    SetValues(variables, before);
+
+                else
+                    Merge(variables, before, then);
+
+                return;
+            }
+
+            int join = Function.NewBlock();
+
+            if (!thenTerminated)
+                Function.Add(Opcode.Jump, Word.None, -1, value: join);
+
+            AddLabel(otherwise, failed);
+            SetValues(variables, before);
+            LowerStatement(statement.Extra);
+
+            if (thenTerminated && Terminated)
+                return;
+
+            int[] values = ValuesOf(variables);
+            AddLabel(join, thenCount + (Terminated ? 0 : Count));
+
+            if (thenTerminated)
+                SetValues(variables, values);
+
+            else if (Terminated)
+                SetValues(variables, then);
+
+            else
+                Merge(variables, then, values);
+
+            Terminated = false;
+        }
+
+        // The header of the loop starts with a phi for every variable the body assigns, which reads the value from
+        // before the loop and the one from the end of the body. The condition leaves to the exit when it does not hold.
+        private void LowerWhile(int node)
+        {
+            Node statement = Tree.Nodes[node];
+
+            if (Vectorizer != null && Tokens[statement.Token].Type == Token.Keyword && Tokens[statement.Token].Value == (int)Word.For)
+                LowerKernel(node);
+
+            List<int> variables = AssignedVariables(node);
+            int header = Function.NewBlock();
+            int exit = Function.NewBlock();
+            int[] phis = new int[variables.Count];
+            long held;
+            long failed;
+
+            CountBranch(statement, out held, out failed);
+            AddLabel(header, held + failed);
+
+            for (int i = 0; i < variables.Count; i++)
+            {
+                int variable = variables[i];
+                Word type = TypeOfVariable(variable);
+                int register = Function.NewRegister(type);
+
+                phis[i] = Function.Add(Opcode.Phi, type, register, Registers[variable]);
+                Registers[variable] = register;
+            }
+
+            if (Instrument)
+                AddCounter();
+
+            // Loops without a condition only end through a return
+            if (statement.Left >= 0)
+                LowerCondition(statement.Left, exit);
+
+            AddLabel(Function.NewBlock(), held);
+
+            if (Instrument)
+                AddCounter();
+
+            LowerStatement(statement.Right);
+
+            for (int i = 0; i < variables.Count; i++)
+            {
+                Instruction[] code = Function.Code;
+                code[phis[i]].Right = Terminated ? code[phis[i]].Target : Registers[variables[i]];
+                Registers[variables[i]] = code[phis[i]].Target;
+            }
+
+            if (!Terminated)
+                Function.Add(Opcode.Jump, Word.None, -1, value: header);
+
+            Terminated = statement.Left < 0;
+
+            if (!Terminated)
+                AddLabel(exit, failed);
+        }
+
+        // The times the condition of the statement held and did not hold in the profile, both the count before the
+        // statement when the profile has none for it. Instrumented functions count the tests of the condition in
+        // the next counter and the times it held in the one after.
+        private void CountBranch(Node statement, out long held, out long failed)
+        {
+            Lexeme token = Tokens[statement.Token];
+            string position = $"{token.Line}:{token.Column}";
+            long tested;
+
+            if (Instrument)
+                Function.Branches.Add(position);
+
+            if (Function.BlockCounts != null && Profile.TryGetBranch(Function.Name, position, out tested, out held))
+                failed = tested - held;
+
+            else
+            {
+                held = Count;
+                failed = Count;
+            }
+        }
+
+        private void AddCounter()
+        {
+            Function.Add(Opcode.Count, Word.None, -1, value: Function.Counters.Count);
+            Function.Counters.Add(new IrCounter { Function = Function.Name, Index = Function.Counters.Count });
+        }
+
+        // Starts the block, which ran the given times in the profile. Its code then runs as often, up to its next branch.
+        private void AddLabel(int block, long count)
+        {
+            Function.Add(Opcode.Label, Word.None, -1, value: block);
+
+            if (Function.BlockCounts != null)
+                Function.SetBlockCount(block, count);
+
+            Count = count;
+        }
+
+        // Runs the elements the vectorizer can handle a vector at a time before the loop, which then goes on from the
+        // index the kernel stopped at with the elements that remain
+        private void LowerKernel(int node)
+        {
+            List<int> invariants = new List<int>();
+            int variable;
+            int end;
+            IrKernel kernel = Vectorizer.Vectorize(Module, Function, Registers, node, invariants, out variable, out end);
+
+            if (kernel == null)
+                return;
+
+            Word type = TypeOfVariable(variable);
+            int arguments = Function.Arguments.Count;
+            int start = Registers[variable];
+            int bound = LowerExpression(end, type);
+            List<int> values = new List<int>();
+
+            foreach (int invariant in invariants)
+                values.Add(LowerExpression(invariant, kernel.Type));
+
+            Function.Arguments.Add(start);
+            Function.Arguments.Add(bound);
+            Function.Arguments.AddRange(values);
+            Function.Kernels.Add(kernel);
+
+            Registers[variable] = Function.NewRegister(type);
+            Function.Add(Opcode.Kernel, type, Registers[variable], arguments, Function.Arguments.Count - arguments, Function.Kernels.Count - 1);
+        }
+
+        // Branches to the block when the condition does not hold, comparisons compare in the type of their operands
+        private void LowerCondition(int node, int block)
+        {
+            Node condition = Tree.Nodes[node];
+            Word type = TypeOf(node);
+            int value;
+
+            if (condition.Kind == NodeKind.Compare)
+            {
+                int left = LowerExpression(condition.Left, type);
+                int right = LowerExpression(condition.Right, type);
+
+                value = Function.NewRegister(Word.I32);
+                Function.Add(CompareOf(Tokens[condition.Token].Value), type, value, left, right);
+            }
+
+            // Other conditions hold when they are not zero
+            else
+                value = LowerExpression(node, type);
+
+            Function.Add(Opcode.Branch, Word.None, -1, value, value: block);
+        }
+
+        // The variables a statement assigns, leaving out the ones it declares itself
+        private List<int> AssignedVariables(int node)
+        {
+            List<int> variables = new List<int>();
+            HashSet<int> declared = new HashSet<int>();
+
+            AddAssignedVariables(node, variables, declared);
+            return variables;
+        }
+
+        private void AddAssignedVariables(int node, List<int> variables, HashSet<int> declared)
+        {
+            Node statement = Tree.Nodes[node];
+
+            switch (statement.Kind)
+            {
+                case NodeKind.Block:
+                    for (int child = statement.Left; child >= 0; child = Tree.Nodes[child].Next)
+                        AddAssignedVariables(child, variables, declared);
+
+                    break;
+
+                case NodeKind.Declaration:
+                    declared.Add(node);
+                    break;
+
+                // The elements of the arrays are not values of the registers
+                case NodeKind.Assignment:
+                {
+                    int variable = Module.Bindings[node];
+
+                    if (variable >= 0 && statement.Right < 0 && !declared.Contains(variable) && !variables.Contains(variable))
+                        variables.Add(variable);
+
+                    break;
+                }
+
+                case NodeKind.If:
+                    AddAssignedVariables(statement.Right, variables, declared);
+
+                    if (statement.Extra >= 0)
+                        AddAssignedVariables(statement.Extra, variables, declared);
+
+                    break;
+
+                case NodeKind.While:
+                    AddAssignedVariables(statement.Right, variables, declared);
+                    break;
+            }
+        }
+
+        private int[] ValuesOf(List<int> variables)
+        {
+            int[] values = new int[variables.Count];
+
+            for (int i = 0; i < values.Length; i++)
+                values[i] = Registers[variables[i]];
+
+            return values;
+        }
+
+        private void SetValues(List<int> variables, int[] values)
+        {
+            for (int i = 0; i < values.Length; i++)
+                Registers[variables[i]] = values[i];
+        }
+
+        // Gives the variables a phi where their values differ, right after the label of the join
+        private void Merge(List<int> variables, int[] left, int[] right)
+        {
+            for (int i = 0; i < left.Length; i++)
+            {
+                int variable = variables[i];
+
+                if (left[i] == right[i])
+                    Registers[variable] = left[i];
+
+                else
+                {
+                    Registers[variable] = Function.NewRegister(TypeOfVariable(variable));
+                    Function.Add(Opcode.Phi, TypeOfVariable(variable), Registers[variable], left[i], right[i]);
+                }
+            }
+        }
+
+        // Lowers an expression to a register of the given type, or of its own type when the type is None
+        private int LowerExpression(int node, Word type)
+        {
+            Node expression = Tree.Nodes[node];
+
+            if (type == Word.None && expression.Kind != NodeKind.Call)
+                type = TypeOf(node);
+
+            switch (expression.Kind)
+            {
+                case NodeKind.Number:
+                {
+                    NumberLiteral literal = Tokens.Numbers[Tokens[expression.Token].Value];
+
+                    if (literal.IsFloat)
+                        return Error(expression.Token, DiagnosticCode.FloatNotSupported);
+
+                    int register = Function.NewRegister(literal.Type != Word.None ? literal.Type : type);
+                    Function.Add(Opcode.Constant, Function.Registers[register], register, value: Keywords.Wrap((long)literal.Value, Function.Registers[register]));
+                    return Convert(register, type);
+                }
+
+                case NodeKind.String:
+                    return Error(expression.Token, DiagnosticCode.StringNotSupported);
+
+                case NodeKind.Name:
+                {
+                    if (expression.Extra != expression.Token)
+                        return Error(expression.Token, DiagnosticCode.ExpectedVariable);
+
+                    int variable = Module.Bindings[node];
+                    return (variable >= 0) ? Convert(Registers[variable], type) : -1;
+                }
+
+                case NodeKind.Negate:
+                {
+                    int register = Function.NewRegister(type);
+                    Function.Add(Opcode.Negate, type, register, LowerExpression(expression.Left, type));
+                    return register;
+                }
+
+                case NodeKind.Binary:
+                {
+                    int left = LowerExpression(expression.Left, type);
+                    int right = LowerExpression(expression.Right, type);
+                    int register = Function.NewRegister(type);
+
+                    Function.Add(OpcodeOf((char)Tokens[expression.Token].Value), type, register, left, right);
+                    return register;
+                }
+
+                case NodeKind.Index:
+                {
+                    Node name = Tree.Nodes[expression.Left];
+
+                    if (name.Extra != name.Token)
+                        return Error(name.Token, DiagnosticCode.ExpectedVariable);
+
+                    int variable = Module.Bindings[expression.Left];
+
+                    if (variable < 0)
+                        return -1;
+
+                    int index = LowerExpression(expression.Right, Word.I64);
+                    int register = Function.NewRegister(TypeOfVariable(variable));
+
+                    Function.Add(Opcode.Load, TypeOfVariable(variable), register, index, value: Registers[variable]);
+                    return Convert(register, type);
+                }
+
+                case NodeKind.Call:
+                    return LowerCall(expression, type);
+            }
+
+            return Error(expression.Token, DiagnosticCode.ExpectedExpression);
+        }
+
+        private int LowerCall(Node call, Word type)
+        {
+            Node callee = Tree.Nodes[call.Left];
+            Signature signature;
+
+            if (IsWrite(callee))
+                return LowerWrite(call, type);
+
+            if (!TryResolve(callee, out signature))
+                return -1;
+
+            List<int> arguments = new List<int>();
+            int index = 0;
+
+            for (int argument = call.Right; argument >= 0; argument = Tree.Nodes[argument].Next, index++)
+            {
+                if (index < signature.Parameters.Length)
+                    arguments.Add(LowerExpression(argument, signature.Parameters[index]));
+            }
+
+            if (index != signature.Parameters.Length)
+                return Error(callee.Token, DiagnosticCode.ArgumentCount, signature.Name, signature.Parameters.Length, index);
+
+            if (signature.ReturnType == Word.None && type != Word.None)
+                return Error(callee.Token, DiagnosticCode.ReturnsNothing, signature.Name);
+
+            int target = (signature.ReturnType != Word.None) ? Function.NewRegister(signature.ReturnType) : -1;
+            int callees = Function.Callees.IndexOf(signature.Name);
+
+            if (callees < 0)
+            {
+                callees = Function.Callees.Count;
+                Function.Callees.Add(signature.Name);
+            }
+
+            Function.Add(Opcode.Call, signature.ReturnType, target, Function.Arguments.Count, arguments.Count, callees);
+            Function.Arguments.AddRange(arguments);
+            return (target >= 0 && type != Word.None) ? Convert(target, type) : target;
+        }
+
+        // Console::Write of the runtime, which the backend copies to the buffer of the output itself
+        private bool IsWrite(Node callee)
+        {
+            if (callee.Extra == callee.Token || Tokens.GetText(callee.Extra) != "Write")
+                return false;
+
+            int target = Graph.Find(ModuleGraph.PathOf(Tree, callee.Token, callee.Extra - 2));
+            return target >= 0 && Graph.Modules[target].IsRuntime && Graph.Modules[target].Name == "Console";
+        }
+
+        // The string goes to the constant pool of the function, which keeps one copy of every string
+        private int LowerWrite(Node call, Word type)
+        {
+            Node callee = Tree.Nodes[call.Left];
+            int count = 0;
+
+            for (int argument = call.Right; argument >= 0; argument = Tree.Nodes[argument].Next)
+                count++;
+
+            if (count != 1)
+                return Error(callee.Token, DiagnosticCode.ArgumentCount, "Console::Write", 1, count);
+
+            Node text = Tree.Nodes[call.Right];
+
+            if (text.Kind != NodeKind.String)
+                return Error(text.Token, DiagnosticCode.ExpectedString, "Console::Write");
+
+            if (type != Word.None)
+                return Error(callee.Token, DiagnosticCode.ReturnsNothing, "Console::Write");
+
+            string value = Tokens.Strings.GetText(Tokens[text.Token].Value);
+            int index = Function.Strings.IndexOf(value);
+
+            if (index < 0)
+            {
+                index = Function.Strings.Count;
+                Function.Strings.Add(value);
+            }
+
+            Function.Add(Opcode.Write, Word.None, -1, value: index);
+            return -1;
+        }
+
+        // Finds the function called through a path
+        private bool TryResolve(Node callee, out Signature signature)
+        {
+            signature = default(Signature);
+
+            Module module = Module;
+
+            if (callee.Extra != callee.Token)
+            {
+                int target = Graph.Find(ModuleGraph.PathOf(Tree, callee.Token, callee.Extra - 2));
+
+                if (target < 0 || (target != Module.Index && !Module.Dependencies.Contains(target)))
+                {
+                    Error(callee.Extra, DiagnosticCode.UnknownFunction);
+                    return false;
+                }
+
+                module = Graph.Modules[target];
+            }
+
+            if (module.IsRuntime)
+            {
+                Error(callee.Token, DiagnosticCode.RuntimeNotSupported, module.Name);
+                return false;
+            }
+
+            int function;
+
+            if (!module.Functions.TryGetValue(Tokens[callee.Extra].Value, out function))
+            {
+                Error(callee.Extra, DiagnosticCode.UnknownFunction);
+                return false;
+            }
+
+            signature = SignatureOf(module, function);
+            return true;
+        }
+
+        private static Signature SignatureOf(Module module, int node)
+        {
+            Ast tree = module.Tree;
+            Node function = tree.Nodes[node];
+            List<Word> parameters = new List<Word>();
+
+            for (int parameter = function.Left; parameter >= 0; parameter = tree.Nodes[parameter].Next)
+                parameters.Add((Word)tree.Tokens[tree.Nodes[parameter].Extra].Value);
+
+            return new Signature
+            {
+                Name = module.Name + "::" + tree.Tokens.GetText(function.Token),
+                ReturnType = (function.Extra >= 0) ? (Word)tree.Tokens[function.Extra].Value : Word.None,
+                Parameters = parameters.ToArray()
+            };
+        }
+
+        // The type an expression has on its own as the type checker found it, i32 for the untyped literals
+        private Word TypeOf(int node)
+        {
+            return TypeTable.WordOf(Module.Types[node]);
+        }
+
+        private int Convert(int register, Word type)
+        {
+            if (register < 0 || type == Word.None || Function.Registers[register] == type)
+                return register;
+
+            int converted = Function.NewRegister(type);
+            Function.Add(Opcode.Convert, type, converted, register);
+            return converted;
+        }
+
+        private static Opcode OpcodeOf(char c)
+        {
+            switch (c)
+            {
+                case '+':
+                    return Opcode.Add;
+
+                case '-':
+                    return Opcode.Subtract;
+
+                case '*':
+                    return Opcode.Multiply;
+
+                default:
+                    return Opcode.Divide;
+            }
+        }
+
+        private static Opcode CompareOf(int token)
+        {
+            if (token == Lexeme.OperatorOf('=', '='))
+                return Opcode.Equal;
+
+            if (token == Lexeme.OperatorOf('!', '='))
+                return Opcode.NotEqual;
+
+            if (token == Lexeme.OperatorOf('<'))
+                return Opcode.Less;
+
+            if (token == Lexeme.OperatorOf('<', '='))
+                return Opcode.LessEqual;
+
+            return (token == Lexeme.OperatorOf('>')) ? Opcode.Greater : Opcode.GreaterEqual;
+        }
+
+        // Parameters and declarations both give the token of their type in Extra
+        private Word TypeOfVariable(int node)
+        {
+            return (Word)Tokens[Tree.Nodes[node].Extra].Value;
+        }
+
+        private int Error(int token, DiagnosticCode code, string text = null, int argument = 0, int extra = 0)
+        {
+            ModuleGraph.Error(Module, token, code, text, argument, extra);
+            ErrorCount++;
+            return -1;
+        }
+    }
+}
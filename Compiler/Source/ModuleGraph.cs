@@ -0,0 +1,296 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+
+namespace Sage
+{
+    // A use declaration of a module, Target is -1 when the module is unknown
+    internal struct ModuleUse
+    {
+        public int Target;
+        public int Node;
+
+        // The use closes a cycle, so it is left out of the dependencies
+        public bool Cyclic;
+    }
+
+    // Every source is a module named after its file, it can use the others with "use Name;"
+    internal class Module
+    {
+        public int Index;
+        public string Name;
+
+        // Null for the modules provided by the runtime
+        public Ast Tree;
+
+        // Shared with the file of the module, the file table gives both the same id
+        public DiagnosticBag Diagnostics;
+        public int ErrorCount;
+
+        // Printed after the diagnostics, such as the dumped code of the module
+        public StringWriter Output = new StringWriter();
+
+        public List<ModuleUse> Uses = new List<ModuleUse>();
+
+        // The modules that are analyzed before this one, without duplicates nor the uses closing a cycle
+        public List<int> Dependencies = new List<int>();
+
+        // Symbol id of the name of every function to its node, filled when the module is analyzed
+        public Dictionary<int, int> Functions = new Dictionary<int, int>();
+
+        // The parameter or declaration node every variable node refers to, -1 for the other nodes
+        public int[] Bindings;
+
+        // The type of every expression node, filled by the type checker
+        public TypeId[] Types;
+
+        // The code generated for the module, null when no output is asked for or when it could not be generated
+        public List<IrFunction> Code;
+        public string Assembly;
+
+        public bool IsRuntime
+        {
+            get { return Tree == null; }
+        }
+    }
+
+    // The modules of the program and the uses between them
+    internal class ModuleGraph
+    {
+        // Modules every program can use without a source
+        private static readonly string[] RuntimeModules = { "Console" };
+
+        private readonly Dictionary<string, int> Indexes = new Dictionary<string, int>(StringComparer.Ordinal);
+
+        public List<Module> Modules { get; private set; }
+
+        public ModuleGraph()
+        {
+            Modules = new List<Module>();
+
+            foreach (string name in RuntimeModules)
+                Register(new Module { Name = name, Diagnostics = new DiagnosticBag() });
+        }
+
+        // Adds the module of a parsed source, returning null when another source already defines a module of that name
+        public Module Add(Ast tree, DiagnosticBag diagnostics)
+        {
+            Module module = new Module { Name = NameOf(tree), Tree = tree, Diagnostics = diagnostics };
+            int existing;
+
+            if (Indexes.TryGetValue(module.Name, out existing))
+            {
+                Module other = Modules[existing];
+
+                if (other.IsRuntime)
+                    diagnostics.Add(DiagnosticCode.ModuleDefinedByRuntime, -1, 0, module.Name);
+
+                else
+                    diagnostics.Add(DiagnosticCode.ModuleDefinedTwice, -1, 0, module.Name, other.Diagnostics.File);
+
+                return null;
+            }
+
+            Register(module);
+            return module;
+        }
+
+        public int Find(string name)
+        {
+            int index;
+            return Indexes.TryGetValue(name, out index) ? index : -1;
+        }
+
+        // Resolves the uses of every module and reports the cycles they form
+        public void Link()
+        {
+            foreach (Module module in Modules)
+            {
+                if (module.IsRuntime)
+                    continue;
+
+                Node[] nodes = module.Tree.Nodes;
+
+                for (int item = nodes[module.Tree.Root].Left; item >= 0; item = nodes[item].Next)
+                {
+                    if (nodes[item].Kind != NodeKind.Use)
+                        continue;
+
+                    int target = Find(PathOf(module.Tree, nodes[item].Token, nodes[item].Extra));
+
+                    if (target < 0)
+                        Error(module, nodes[item].Token, nodes[item].Extra, DiagnosticCode.UnknownModule);
+
+                    module.Uses.Add(new ModuleUse { Target = target, Node = item });
+                }
+            }
+
+            FindCycles();
+
+            foreach (Module module in Modules)
+            {
+                foreach (ModuleUse use in module.Uses)
+                {
+                    if (use.Target >= 0 && !use.Cyclic && !module.Dependencies.Contains(use.Target))
+                        module.Dependencies.Add(use.Target);
+                }
+            }
+        }
+
+        // Depth first search over the uses, every use reaching a module still on the path closes a cycle
+        private void FindCycles()
+        {
+            const int NotVisited = 0;
+            const int OnPath = 1;
+            const int Visited = 2;
+
+            int[] states = new int[Modules.Count];
+            List<int> path = new List<int>();
+            List<int> nextUses = new List<int>();
+
+            for (int start = 0; start < Modules.Count; start++)
+            {
+                if (states[start] != NotVisited)
+                    continue;
+
+                states[start] = OnPath;
+                path.Add(start);
+                nextUses.Add(0);
+
+                while (path.Count > 0)
+                {
+                    Module module = Modules[path[path.Count - 1]];
+                    int next = nextUses[nextUses.Count - 1];
+
+                    if (next == module.Uses.Count)
+                    {
+                        states[module.Index] = Visited;
+                        path.RemoveAt(path.Count - 1);
+                        nextUses.RemoveAt(nextUses.Count - 1);
+                        continue;
+                    }
+
+                    nextUses[nextUses.Count - 1] = next + 1;
+
+                    ModuleUse use = module.Uses[next];
+
+                    if (use.Target < 0)
+                        continue;
+
+                    if (states[use.Target] == NotVisited)
+                    {
+                        states[use.Target] = OnPath;
+                        path.Add(use.Target);
+                        nextUses.Add(0);
+                    }
+
+                    else if (states[use.Target] == OnPath)
+                    {
+                        use.Cyclic = true;
+                        module.Uses[next] = use;
+                        ReportCycle(path, use.Target);
+                    }
+                }
+            }
+        }
+
+        // Reports the chain of uses from the target back to itself, at the use closing the cycle
+        private void ReportCycle(List<int> path, int target)
+        {
+            int first = path.IndexOf(target);
+            StringBuilder chain = new StringBuilder();
+
+            for (int i = first; i < path.Count; i++)
+                chain.Append('"').Append(Modules[path[i]].Name).Append("\" -> ");
+
+            chain.Append('"').Append(Modules[target].Name).Append('"');
+
+            Module last = Modules[path[path.Count - 1]];
+            Node closing = last.Tree.Nodes[FindUse(last, target)];
+            Error(last, closing.Token, closing.Extra, DiagnosticCode.CyclicUse, chain.ToString());
+
+            // Every step of the chain, so the whole cycle can be broken from the report
+            for (int i = first; i < path.Count; i++)
+            {
+                Module module = Modules[path[i]];
+                int next = (i + 1 < path.Count) ? path[i + 1] : target;
+                Node use = module.Tree.Nodes[FindUse(module, next)];
+                Lexeme start = module.Tree.Tokens[use.Token];
+                Lexeme end = module.Tree.Tokens[use.Extra];
+
+                last.Diagnostics.Add(new Diagnostic
+                {
+                    Code = DiagnosticCode.UseInCycle,
+                    File = module.Diagnostics.File,
+                    Start = start.Offset,
+                    Length = end.Offset + end.Length - start.Offset,
+                    Text = module.Name
+                });
+            }
+        }
+
+        private static int FindUse(Module module, int target)
+        {
+            foreach (ModuleUse use in module.Uses)
+            {
+                if (use.Target == target)
+                    return use.Node;
+            }
+
+            return -1;
+        }
+
+        private void Register(Module module)
+        {
+            module.Index = Modules.Count;
+            Indexes.Add(module.Name, module.Index);
+            Modules.Add(module);
+        }
+
+        // The text of a path, from its first to its last name
+        public static string PathOf(Ast tree, int first, int last)
+        {
+            StringBuilder builder = new StringBuilder();
+
+            for (int token = first; token <= last; token += 2)
+            {
+                if (token > first)
+                    builder.Append("::");
+
+                builder.Append(tree.Tokens.GetText(token));
+            }
+
+            return builder.ToString();
+        }
+
+        private static string NameOf(Ast tree)
+        {
+            return Path.GetFileNameWithoutExtension(tree.Tokens.FileName);
+        }
+
+        public static void Error(Module module, int token, DiagnosticCode code, string text = null, int argument = 0, int extra = 0)
+        {
+            Error(module, token, token, code, text, argument, extra);
+        }
+
+        // An error spanning the tokens from the first to the last one
+        public static void Error(Module module, int first, int last, DiagnosticCode code, string text = null, int argument = 0, int extra = 0)
+        {
+            Lexeme start = module.Tree.Tokens[first];
+            Lexeme end = module.Tree.Tokens[last];
+
+            module.Diagnostics.Add(code, start.Offset, end.Offset + end.Length - start.Offset, text, argument, extra);
+            module.ErrorCount++;
+        }
+
+        // A warning does not count as an error, so the module is still lowered
+        public static void Warning(Module module, int first, int last, DiagnosticCode code, string text = null, int argument = 0, int extra = 0)
+        {
+            Lexeme start = module.Tree.Tokens[first];
+            Lexeme end = module.Tree.Tokens[last];
+
+            module.Diagnostics.Add(code, start.Offset, end.Offset + end.Length - start.Offset, text, argument, extra);
+        }
+    }
+}
@@ -0,0 +1,214 @@
+﻿using System.Collections.Generic;
+using System.Text;
+
+namespace Sage
+{
+    // The native code of the runtime modules, assembled with the program. The Console module keeps its output in a
+    // buffer, which the code of the program copies its constant strings to without calling anything. The buffer goes
+    // to the standard output when it is full, when the program exits, and at every line of an interactive output.
+    // The functions are called with the registers of the System V convention, as the code of the program is, and
+    // call the C runtime with the convention of the system. The Profile module of an instrumented program writes the
+    // counters of its functions when it exits, in the format Profile reads.
+    internal static class NativeRuntime
+    {
+        public const int BufferSize = 8192;
+
+        public const string Buffer = "Console.Buffer";
+        public const string Used = "Console.Used";
+        public const string Interactive = "Console.Interactive";
+
+        // Console.Start sets Interactive and Console.Flush empties the buffer, both are called by the entry point.
+        // Console.Write takes the address of a string in rdi and its length in rsi, for the strings the code of the
+        // program does not copy itself.
+        public const string Start = "Console.Start";
+        public const string Flush = "Console.Flush";
+        public const string Write = "Console.Write";
+
+        // Called by the entry point of an instrumented program after its main function returned
+        public const string WriteProfile = "Profile.Write";
+
+        // The counters of the function, its calls followed by the tests and the holds of every branch
+        public static string CountersOf(string function)
+        {
+            return $".L{X64Emitter.SymbolOf(function)}.counts";
+        }
+
+        public static string EmitConsole(bool windows)
+        {
+            StringBuilder output = new StringBuilder();
+
+            // The arguments of the C functions, and the room the Windows convention reserves for them
+            string first = windows ? "ecx" : "edi";
+            string second = windows ? "rdx" : "rsi";
+            string third = windows ? "r8" : "rdx";
+            int shadow = windows ? 32 : 0;
+
+            output.Append($"\n    .lcomm {Buffer}, {BufferSize}\n    .lcomm {Used}, 8\n    .lcomm {Interactive}, 8\n");
+
+            output.Append($"\n{Start}:\n");
+            Line(output, $"sub rsp, {shadow + 8}");
+            Line(output, $"mov {first}, 1");
+            Line(output, "call isatty");
+            Line(output, $"mov byte ptr [rip + {Interactive}], al");
+            Line(output, $"add rsp, {shadow + 8}");
+            Line(output, "ret");
+
+            // Writes until the whole buffer is out, an output that fails loses what it did not take
+            output.Append($"\n{Flush}:\n");
+            Line(output, "push rbx");
+            Line(output, $"sub rsp, {shadow}");
+            Line(output, "xor ebx, ebx");
+            output.Append($".L{Flush}.loop:\n");
+            Line(output, $"mov {third}, qword ptr [rip + {Used}]");
+            Line(output, $"sub {third}, rbx");
+            Line(output, $"jle .L{Flush}.done");
+            Line(output, $"mov {first}, 1");
+            Line(output, $"lea {second}, [rip + {Buffer}]");
+            Line(output, $"add {second}, rbx");
+            EmitWrite(output, windows);
+            Line(output, "test rax, rax");
+            Line(output, $"jle .L{Flush}.done");
+            Line(output, "add rbx, rax");
+            Line(output, $"jmp .L{Flush}.loop");
+            output.Append($".L{Flush}.done:\n");
+            Line(output, $"mov qword ptr [rip + {Used}], 0");
+            Line(output, $"add rsp, {shadow}");
+            Line(output, "pop rbx");
+            Line(output, "ret");
+
+            // Copies the string after what the buffer holds, or writes it at once when it is larger than the buffer
+            output.Append($"\n{Write}:\n");
+            Line(output, "push rbx");
+            Line(output, "push r12");
+            Line(output, $"sub rsp, {shadow + 8}");
+            Line(output, "mov rbx, rdi");
+            Line(output, "mov r12, rsi");
+            Line(output, $"mov rax, qword ptr [rip + {Used}]");
+            Line(output, "add rax, r12");
+            Line(output, $"cmp rax, {BufferSize}");
+            Line(output, $"jbe .L{Write}.copy");
+            Line(output, $"call {Flush}");
+            Line(output, $"cmp r12, {BufferSize}");
+            Line(output, $"jb .L{Write}.copy");
+            output.Append($".L{Write}.direct:\n");
+            Line(output, "test r12, r12");
+            Line(output, $"jz .L{Write}.done");
+            Line(output, $"mov {first}, 1");
+            Line(output, $"mov {second}, rbx");
+            Line(output, $"mov {third}, r12");
+            EmitWrite(output, windows);
+            Line(output, "test rax, rax");
+            Line(output, $"jle .L{Write}.done");
+            Line(output, "add rbx, rax");
+            Line(output, "sub r12, rax");
+            Line(output, $"jmp .L{Write}.direct");
+            output.Append($".L{Write}.copy:\n");
+            Line(output, $"lea {(windows ? "rcx" : "rdi")}, [rip + {Buffer}]");
+            Line(output, $"add {(windows ? "rcx" : "rdi")}, qword ptr [rip + {Used}]");
+            Line(output, $"mov {second}, rbx");
+            Line(output, $"mov {third}, r12");
+            Line(output, "call memcpy");
+            Line(output, $"add qword ptr [rip + {Used}], r12");
+            output.Append($".L{Write}.done:\n");
+            Line(output, $"add rsp, {shadow + 8}");
+            Line(output, "pop r12");
+            Line(output, "pop rbx");
+            Line(output, "ret");
+
+            return output.ToString();
+        }
+
+        // Writes a line for every function and every branch with stdio, a profile that cannot be opened is not written
+        public static string EmitProfile(List<IrFunction> functions, string fileName, bool windows)
+        {
+            StringBuilder output = new StringBuilder();
+            List<string> formats = new List<string>();
+
+            // The stream and the formats are the first two arguments of fprintf, the counts the two after
+            string stream = windows ? "rcx" : "rdi";
+            string format = windows ? "rdx" : "rsi";
+            string[] counts = windows ? new[] { "r8", "r9" } : new[] { "rdx", "rcx" };
+            int shadow = windows ? 32 : 0;
+
+            output.Append($"\n{WriteProfile}:\n");
+            Line(output, "push rbx");
+            Line(output, $"sub rsp, {shadow}");
+            Line(output, $"lea {stream}, [rip + .L{WriteProfile}.file]");
+            Line(output, $"lea {format}, [rip + .L{WriteProfile}.mode]");
+            Line(output, "call fopen");
+            Line(output, "test rax, rax");
+            Line(output, $"jz .L{WriteProfile}.done");
+            Line(output, "mov rbx, rax");
+
+            foreach (IrFunction function in functions)
+            {
+                string counters = CountersOf(function.Name);
+
+                for (int branch = -1; branch < function.Branches.Count; branch++)
+                {
+                    formats.Add((branch < 0) ? $"function {function.Name} %llu\n" : $"branch {function.Name} {function.Branches[branch]} %llu %llu\n");
+
+                    Line(output, $"mov {stream}, rbx");
+                    Line(output, $"lea {format}, [rip + .L{WriteProfile}.f{formats.Count - 1}]");
+
+                    if (branch < 0)
+                        Line(output, $"mov {counts[0]}, qword ptr [rip + {counters}]");
+
+                    else
+                    {
+                        Line(output, $"mov {counts[0]}, qword ptr [rip + {counters} + {8 * (2 * branch + 1)}]");
+                        Line(output, $"mov {counts[1]}, qword ptr [rip + {counters} + {8 * (2 * branch + 2)}]");
+                    }
+
+                    // The vector registers of the variadic arguments, of which there are none
+                    if (!windows)
+                        Line(output, "xor eax, eax");
+
+                    Line(output, "call fprintf");
+                }
+            }
+
+            Line(output, $"mov {stream}, rbx");
+            Line(output, "call fclose");
+            output.Append($".L{WriteProfile}.done:\n");
+            Line(output, $"add rsp, {shadow}");
+            Line(output, "pop rbx");
+            Line(output, "ret");
+
+            output.Append(windows ? "\n    .section .rdata,\"dr\"\n" : "\n    .section .rodata\n");
+            Text(output, $".L{WriteProfile}.file", fileName);
+            Text(output, $".L{WriteProfile}.mode", "w");
+
+            for (int i = 0; i < formats.Count; i++)
+                Text(output, $".L{WriteProfile}.f{i}", formats[i]);
+
+            output.Append("    .text\n");
+            return output.ToString();
+        }
+
+        // A string of the C runtime, ending with a zero
+        private static void Text(StringBuilder output, string label, string text)
+        {
+            output.Append(label).Append(":\n    .byte ");
+
+            foreach (byte value in Encoding.UTF8.GetBytes(text))
+                output.Append(value).Append(", ");
+
+            output.Append("0\n");
+        }
+
+        // The write of Windows returns an int, the one of the other systems a 64 bit count
+        private static void EmitWrite(StringBuilder output, bool windows)
+        {
+            Line(output, "call write");
+
+            if (windows)
+                Line(output, "movsxd rax, eax");
+        }
+
+        private static void Line(StringBuilder output, string text)
+        {
+            output.Append("    ").Append(text).Append('\n');
+        }
+    }
+}
@@ -0,0 +1,304 @@
+﻿namespace Sage
+{
+    // Passes over the SSA form of a function: constant propagation and folding, copy propagation and the elimination
+    // of dead code. Every register is defined once, before its uses, so one pass in the order of the code sees the
+    // definition of every operand before the instructions reading it, but for the phis of the loop headers.
+    internal static class Optimizer
+    {
+        // The level of -O: 0 keeps the code as lowered, 1 folds and removes dead code, 2 and 3 also optimize the loops
+        public const int DefaultLevel = 1;
+
+        public static void Optimize(IrFunction function, int level = DefaultLevel)
+        {
+            if (level <= 0)
+                return;
+
+            Simplify(function);
+
+            if (level >= 2 && LoopOptimizer.Optimize(function))
+                Simplify(function);
+        }
+
+        private static void Simplify(IrFunction function)
+        {
+            // A phi of a loop header can only be found to have one value once the end of the loop was seen
+            while (Propagate(function))
+            {
+            }
+
+            EliminateDeadCode(function);
+        }
+
+        // Folds the instructions whose operands are known and makes every use of a copy read its source instead.
+        // Returns true when a phi of a loop header turned out to have a single value, which needs one more pass.
+        private static bool Propagate(IrFunction function)
+        {
+            int registers = function.Registers.Count;
+
+            // The register holding the same value as every register, the register itself unless it is a copy
+            int[] values = new int[registers];
+            bool[] known = new bool[registers];
+            long[] constants = new long[registers];
+
+            for (int i = 0; i < registers; i++)
+                values[i] = i;
+
+            Instruction[] code = function.Code;
+            bool[] single = new bool[registers];
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                if (IrFunction.HasArguments(code[i].Op))
+                {
+                    for (int argument = 0; argument < code[i].Right; argument++)
+                        function.Arguments[code[i].Left + argument] = values[function.Arguments[code[i].Left + argument]];
+
+                    continue;
+                }
+
+                if (code[i].Op != Opcode.Constant && code[i].Op != Opcode.Parameter)
+                {
+                    if (code[i].Left >= 0)
+                        code[i].Left = values[code[i].Left];
+
+                    if (code[i].Right >= 0)
+                        code[i].Right = values[code[i].Right];
+                }
+
+                Instruction instruction = code[i];
+                int left = instruction.Left;
+                int right = instruction.Right;
+
+                switch (instruction.Op)
+                {
+                    case Opcode.Constant:
+                        known[instruction.Target] = true;
+                        constants[instruction.Target] = instruction.Value;
+                        break;
+
+                    case Opcode.Copy:
+                        values[instruction.Target] = left;
+                        break;
+
+                    // The phi stays until the dead code is removed, without any register reading it
+                    case Opcode.Phi:
+                        if (left == right || right == instruction.Target)
+                        {
+                            values[instruction.Target] = left;
+                            single[instruction.Target] = true;
+                        }
+
+                        break;
+
+                    case Opcode.Equal:
+                    case Opcode.NotEqual:
+                    case Opcode.Less:
+                    case Opcode.LessEqual:
+                    case Opcode.Greater:
+                    case Opcode.GreaterEqual:
+                        if (known[left] && known[right])
+                        {
+                            code[i] = Constant(instruction, Compare(instruction.Op, instruction.Type, constants[left], constants[right]) ? 1 : 0, known, constants);
+                            code[i].Type = function.Registers[instruction.Target];
+                        }
+
+                        break;
+
+                    case Opcode.Convert:
+                        if (known[left])
+                            code[i] = Constant(instruction, Keywords.Wrap(constants[left], instruction.Type), known, constants);
+
+                        break;
+
+                    case Opcode.Negate:
+                        if (known[left])
+                            code[i] = Constant(instruction, Keywords.Wrap(unchecked(-constants[left]), instruction.Type), known, constants);
+
+                        break;
+
+                    case Opcode.Add:
+                    case Opcode.Subtract:
+                    case Opcode.Multiply:
+                    case Opcode.Divide:
+                    {
+                        long result;
+
+                        if (known[left] && known[right])
+                        {
+                            if (TryFold(instruction.Op, instruction.Type, constants[left], constants[right], out result))
+                                code[i] = Constant(instruction, result, known, constants);
+                        }
+
+                        // Adding zero or multiplying by one keeps the other operand, multiplying by zero gives zero
+                        else if (known[right] && constants[right] == ((instruction.Op == Opcode.Add || instruction.Op == Opcode.Subtract) ? 0 : 1))
+                            values[instruction.Target] = left;
+
+                        else if (known[left] && constants[left] == ((instruction.Op == Opcode.Add) ? 0 : 1) && instruction.Op != Opcode.Subtract && instruction.Op != Opcode.Divide)
+                            values[instruction.Target] = right;
+
+                        else if (instruction.Op == Opcode.Multiply && ((known[left] && constants[left] == 0) || (known[right] && constants[right] == 0)))
+                            code[i] = Constant(instruction, 0, known, constants);
+
+                        break;
+                    }
+                }
+            }
+
+            // The values at the end of the loops are only known now
+            bool changed = false;
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                if (code[i].Op != Opcode.Phi || single[code[i].Target])
+                    continue;
+
+                code[i].Right = values[code[i].Right];
+                changed |= code[i].Left == code[i].Right || code[i].Right == code[i].Target;
+            }
+
+            return changed;
+        }
+
+        private static bool Compare(Opcode op, Word type, long left, long right)
+        {
+            int order = Keywords.IsSigned(type) ? left.CompareTo(right) : ((ulong)left).CompareTo((ulong)right);
+
+            switch (op)
+            {
+                case Opcode.Equal:
+                    return order == 0;
+
+                case Opcode.NotEqual:
+                    return order != 0;
+
+                case Opcode.Less:
+                    return order < 0;
+
+                case Opcode.LessEqual:
+                    return order <= 0;
+
+                case Opcode.Greater:
+                    return order > 0;
+
+                default:
+                    return order >= 0;
+            }
+        }
+
+        private static Instruction Constant(Instruction instruction, long value, bool[] known, long[] constants)
+        {
+            known[instruction.Target] = true;
+            constants[instruction.Target] = value;
+            return new Instruction { Op = Opcode.Constant, Type = instruction.Type, Target = instruction.Target, Left = -1, Right = -1, Value = value };
+        }
+
+        // Computes an operation as the machine does on the extended values, except for the divisions by zero and the
+        // overflowing ones, which have no value and are left to the program
+        private static bool TryFold(Opcode op, Word type, long left, long right, out long result)
+        {
+            switch (op)
+            {
+                case Opcode.Add:
+                    result = unchecked(left + right);
+                    break;
+
+                case Opcode.Subtract:
+                    result = unchecked(left - right);
+                    break;
+
+                case Opcode.Multiply:
+                    result = unchecked(left * right);
+                    break;
+
+                default:
+                    if (right == 0 || (Keywords.IsSigned(type) && left == long.MinValue && right == -1))
+                    {
+                        result = 0;
+                        return false;
+                    }
+
+                    result = Keywords.IsSigned(type) ? left / right : (long)((ulong)left / (ulong)right);
+                    break;
+            }
+
+            result = Keywords.Wrap(result, type);
+            return true;
+        }
+
+        // Removes the instructions whose results are never read. Calls, returns, the control flow, the output and the
+        // writes to the arrays are always kept, and so are the parameters, which are moved in place together on entry.
+        // The phis of the loops read registers defined after them, so the live instructions are found from those roots
+        // through a worklist.
+        private static void EliminateDeadCode(IrFunction function)
+        {
+            Instruction[] code = function.Code;
+            int[] definitions = new int[function.Registers.Count];
+            bool[] live = new bool[function.Count];
+            int[] work = new int[function.Count];
+            int count = 0;
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                if (code[i].Target >= 0)
+                    definitions[code[i].Target] = i;
+            }
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                switch (code[i].Op)
+                {
+                    case Opcode.Call:
+                    case Opcode.Write:
+                    case Opcode.Count:
+                    case Opcode.Store:
+                    case Opcode.Clear:
+                    case Opcode.Kernel:
+                    case Opcode.Return:
+                    case Opcode.Parameter:
+                    case Opcode.Label:
+                    case Opcode.Jump:
+                    case Opcode.Branch:
+                        live[i] = true;
+                        work[count++] = i;
+                        break;
+                }
+            }
+
+            while (count > 0)
+            {
+                Instruction instruction = code[work[--count]];
+
+                if (IrFunction.HasArguments(instruction.Op))
+                {
+                    for (int argument = 0; argument < instruction.Right; argument++)
+                        MarkLive(definitions[function.Arguments[instruction.Left + argument]], live, work, ref count);
+                }
+
+                else if (instruction.Op != Opcode.Constant && instruction.Op != Opcode.Parameter)
+                {
+                    if (instruction.Left >= 0)
+                        MarkLive(definitions[instruction.Left], live, work, ref count);
+
+                    if (instruction.Right >= 0)
+                        MarkLive(definitions[instruction.Right], live, work, ref count);
+                }
+            }
+
+            bool[] removed = new bool[function.Count];
+
+            for (int i = 0; i < function.Count; i++)
+                removed[i] = !live[i];
+
+            function.Remove(removed);
+        }
+
+        private static void MarkLive(int instruction, bool[] live, int[] work, ref int count)
+        {
+            if (live[instruction])
+                return;
+
+            live[instruction] = true;
+            work[count++] = instruction;
+        }
+    }
+}
@@ -0,0 +1,345 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace Sage
+{
+    // What the compiler writes to the output file
+    enum OutputKind
+    {
+        Executable = 0,
+        Object,
+        Assembly
+    }
+
+    internal class Options
+    {
+        public const string Usage =
+            "Usage: Sage [options] <files or directories, or - for the standard input>\n" +
+            "\n" +
+            "Options:\n" +
+            "  -j, --jobs <count>   Number of files compiled in parallel (default: processor count)\n" +
+            "  --parallel-functions Optimize and emit the functions of every file in parallel too\n" +
+            "  -o, --output <file>  Write the program as an executable to the file\n" +
+            "  -c                   Write an object file instead of an executable\n" +
+            "  -S                   Write x86-64 assembly instead of an executable\n" +
+            "  --run                Run the program in the virtual machine instead of writing it\n" +
+            "  -O<level>            Optimize at the level: 0 not at all, 1 folding and dead code (default),\n" +
+            "                       2 or -O also inlining and loops, 3 inlining larger functions\n" +
+            "  --avx2               Vectorize the loops over arrays with AVX2 instead of SSE2, from -O2\n" +
+            "  --report-vectors     Report which loops were vectorized, and why the others were not\n" +
+            "  --profile-generate <file>\n" +
+            "                       Make the program count its calls and branches, written to the file when it exits\n" +
+            "  --profile-use <file> Inline, lay out the blocks and allocate the registers after the counts of the file\n" +
+            "  --dump-tokens        Print the tokens of every file\n" +
+            "  --dump-ast           Print the syntax tree of every file\n" +
+            "  --dump-ir            Print the optimized code of every function\n" +
+            "  --max-errors <count> Print at most this many errors, or all of them with 0 (default: 100)\n" +
+            "  --watch              Recompile the files whenever they change\n" +
+            "  --server             Compile for the clients of a pipe, keeping unchanged files in memory\n" +
+            "  --connect            Compile through the server, or in this process when none is running\n" +
+            "  --pipe <name>        Name of the pipe of the server (default: sage-<user>)\n" +
+            "  --cache <directory>  Reuse the tokens and trees of unchanged files from the directory\n" +
+            "  --stdin-name <file>  Name of the source read from the standard input (default: Main.sg)\n" +
+            "  --time-passes        Print the time and the memory taken by every pass and file\n" +
+            "  --trace <file>       Write the passes as a Chrome trace to the file\n" +
+            "  -h, --help           Print this message";
+
+        // Used when no input is given, relative to the output directory of the project
+        private const string DefaultInput = "../../Code/Main.sg";
+
+        private const int DefaultMaxErrors = 100;
+
+        // The input naming the standard input, which gets the module of its name
+        public const string StandardInput = "-";
+        private const string DefaultStdinName = "Main.sg";
+
+        public List<string> Files { get; private set; }
+        public int Jobs { get; private set; }
+        public bool ParallelFunctions { get; private set; }
+        public string Output { get; private set; }
+        public OutputKind OutputKind { get; private set; }
+        public bool Run { get; private set; }
+        public int OptimizationLevel { get; private set; }
+        public bool Avx2 { get; private set; }
+        public bool ReportVectors { get; private set; }
+        public string ProfileGenerate { get; private set; }
+        public string ProfileUse { get; private set; }
+        public bool DumpTokens { get; private set; }
+        public bool DumpAst { get; private set; }
+        public bool DumpIr { get; private set; }
+        public int MaxErrors { get; private set; }
+        public bool Watch { get; private set; }
+        public bool Server { get; private set; }
+        public bool Connect { get; private set; }
+        public string PipeName { get; private set; }
+        public string CacheDirectory { get; private set; }
+        public string StdinName { get; private set; }
+        public bool TimePasses { get; private set; }
+        public string TraceFile { get; private set; }
+        public bool Help { get; private set; }
+
+        private Options()
+        {
+            Files = new List<string>();
+            Jobs = Environment.ProcessorCount;
+            MaxErrors = DefaultMaxErrors;
+            OptimizationLevel = Optimizer.DefaultLevel;
+            StdinName = DefaultStdinName;
+            PipeName = "sage-" + Environment.UserName;
+        }
+
+        // Parses the command line, returning null and an error message when it is invalid
+        public static Options Parse(string[] args, out string error)
+        {
+            Options options = new Options();
+            List<string> inputs = new List<string>();
+            error = null;
+
+            for (int i = 0; i < args.Length; i++)
+            {
+                string arg = args[i];
+
+                switch (arg)
+                {
+                    case "-h":
+                    case "--help":
+                        options.Help = true;
+                        break;
+
+                    case "--dump-tokens":
+                        options.DumpTokens = true;
+                        break;
+
+                    case "--dump-ast":
+                        options.DumpAst = true;
+                        break;
+
+                    case "--dump-ir":
+                        options.DumpIr = true;
+                        break;
+
+                    case "--max-errors":
+                        int maxErrors;
+
+                        if (i + 1 >= args.Length || !int.TryParse(args[++i], out maxErrors) || maxErrors < 0)
+                        {
+                            error = $"The option \"{arg}\" expects a number.";
+                            return null;
+                        }
+
+                        options.MaxErrors = maxErrors;
+                        break;
+
+                    case "--watch":
+                        options.Watch = true;
+                        break;
+
+                    case "--cache":
+                        if (i + 1 >= args.Length)
+                        {
+                            error = $"The option \"{arg}\" expects a directory.";
+                            return null;
+                        }
+
+                        options.CacheDirectory = args[++i];
+                        break;
+
+                    case "--stdin-name":
+                        if (i + 1 >= args.Length)
+                        {
+                            error = $"The option \"{arg}\" expects a file.";
+                            return null;
+                        }
+
+                        options.StdinName = args[++i];
+                        break;
+
+                    case "--parallel-functions":
+                        options.ParallelFunctions = true;
+                        break;
+
+                    case "--server":
+                        options.Server = true;
+                        break;
+
+                    case "--connect":
+                        options.Connect = true;
+                        break;
+
+                    case "--pipe":
+                        if (i + 1 >= args.Length)
+                        {
+                            error = $"The option \"{arg}\" expects a name.";
+                            return null;
+                        }
+
+                        options.PipeName = args[++i];
+                        break;
+
+                    case "--time-passes":
+                        options.TimePasses = true;
+                        break;
+
+                    case "--trace":
+                        if (i + 1 >= args.Length)
+                        {
+                            error = $"The option \"{arg}\" expects a file.";
+                            return null;
+                        }
+
+                        options.TraceFile = args[++i];
+                        break;
+
+                    case "-o":
+                    case "--output":
+                        if (i + 1 >= args.Length)
+                        {
+                            error = $"The option \"{arg}\" expects a file.";
+                            return null;
+                        }
+
+                        options.Output = args[++i];
+                        break;
+
+                    case "-c":
+                        options.OutputKind = OutputKind.Object;
+                        break;
+
+                    case "-S":
+                        options.OutputKind = OutputKind.Assembly;
+                        break;
+
+                    case "--run":
+                        options.Run = true;
+                        break;
+
+                    case "-O":
+                        options.OptimizationLevel = 2;
+                        break;
+
+                    case "-O0":
+                    case "-O1":
+                    case "-O2":
+                    case "-O3":
+                        options.OptimizationLevel = arg[2] - '0';
+                        break;
+
+                    case "--avx2":
+                        options.Avx2 = true;
+                        break;
+
+                    case "--report-vectors":
+                        options.ReportVectors = true;
+                        break;
+
+                    case "--profile-generate":
+                        if (i + 1 >= args.Length)
+                        {
+                            error = $"The option \"{arg}\" expects a file.";
+                            return null;
+                        }
+
+                        options.ProfileGenerate = args[++i];
+                        break;
+
+                    case "--profile-use":
+                        if (i + 1 >= args.Length)
+                        {
+                            error = $"The option \"{arg}\" expects a file.";
+                            return null;
+                        }
+
+                        options.ProfileUse = args[++i];
+                        break;
+
+                    case "-j":
+                    case "--jobs":
+                        int jobs;
+
+                        if (i + 1 >= args.Length || !int.TryParse(args[++i], out jobs) || jobs < 1)
+                        {
+                            error = $"The option \"{arg}\" expects a positive number.";
+                            return null;
+                        }
+
+                        options.Jobs = jobs;
+                        break;
+
+                    default:
+                        if (arg.Length > 1 && arg[0] == '-')
+                        {
+                            error = $"Unknown option \"{arg}\".";
+                            return null;
+                        }
+
+                        inputs.Add(arg);
+                        break;
+                }
+            }
+
+            if (options.OutputKind != OutputKind.Executable && options.Output == null)
+            {
+                error = "The options \"-c\" and \"-S\" need an output file given with \"-o\".";
+                return null;
+            }
+
+            if (options.Run && options.Output != null)
+            {
+                error = "The option \"--run\" cannot be combined with \"-o\".";
+                return null;
+            }
+
+            // The virtual machine has no counters, only the native programs are profiled
+            if (options.ProfileGenerate != null && options.Output == null)
+            {
+                error = "The option \"--profile-generate\" needs an output file given with \"-o\".";
+                return null;
+            }
+
+            if (options.Server && (options.Connect || options.Watch))
+            {
+                error = "The option \"--server\" cannot be combined with \"--connect\" nor \"--watch\".";
+                return null;
+            }
+
+            if (inputs.Count == 0)
+                inputs.Add(DefaultInput);
+
+            options.CollectFiles(inputs);
+
+            if (options.Watch && options.Files.Contains(StandardInput))
+            {
+                error = "The standard input cannot be watched.";
+                return null;
+            }
+
+            return options;
+        }
+
+        // Expands directories into their sources, keeping the order of the command line
+        private void CollectFiles(List<string> inputs)
+        {
+            HashSet<string> seen = new HashSet<string>(StringComparer.Ordinal);
+
+            foreach (string input in inputs)
+            {
+                if (Directory.Exists(input))
+                {
+                    string[] files = Directory.GetFiles(input, "*.sg", SearchOption.AllDirectories);
+                    Array.Sort(files, StringComparer.Ordinal);
+
+                    foreach (string file in files)
+                    {
+                        if (seen.Add(Path.GetFullPath(file)))
+                            Files.Add(file);
+                    }
+                }
+
+                // Missing files are kept, so the lexer reports them in order
+                else if (seen.Add(Path.GetFullPath(input)))
+                    Files.Add(input);
+            }
+        }
+    }
+}
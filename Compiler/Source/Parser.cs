@@ -0,0 +1,826 @@
+﻿using System;
+
+namespace Sage
+{
+    // Recursive descent parser building the syntax tree of a token stream
+    internal class Parser
+    {
+        // Arrays live in the frame of their function, which keeps them small
+        public const int MaxArrayLength = 1 << 20;
+
+        // Blocks and expressions nested deeper make the function they are in an error, so no source can exhaust the
+        // stack of the compiler. Every block, parenthesis, call, index, negation and operator of a chain is a level.
+        public const int MaxDepth = 2000;
+
+        private readonly DiagnosticBag Diagnostics;
+        private TokenStream Tokens;
+        private Ast Tree;
+        private int Position;
+        private int Depth;
+
+        // Set once the nesting went too deep: every level then returns at once without errors of its own, up to the
+        // function, which is skipped
+        private bool TooDeep;
+
+        public int ErrorCount { get; private set; }
+
+        public Parser() : this(new DiagnosticBag())
+        {
+        }
+
+        public Parser(DiagnosticBag diagnostics)
+        {
+            Diagnostics = diagnostics;
+        }
+
+        public Ast Parse(TokenStream tokens)
+        {
+            Tokens = tokens;
+            Tree = new Ast(tokens);
+            Position = 0;
+            Depth = 0;
+            TooDeep = false;
+
+            int module = Tree.Add(NodeKind.Module, 0);
+            int last = -1;
+
+            while (Position < Tokens.Count)
+            {
+                int start = Position;
+                int item = ParseItem();
+
+                if (item >= 0)
+                    last = Append(module, last, item);
+
+                // Always make progress, even on tokens that cannot start an item
+                if (Position == start)
+                    Position++;
+            }
+
+            Ast tree = Tree;
+            Tokens = null;
+            Tree = null;
+            return tree;
+        }
+
+        private int ParseItem()
+        {
+            if (IsKeyword(Word.Use))
+                return ParseUse();
+
+            if (IsKeyword(Word.Function))
+                return ParseFunction();
+
+            Error(DiagnosticCode.ExpectedItem);
+            return SkipItem();
+        }
+
+        // use Name (:: Name)* ;
+        private int ParseUse()
+        {
+            Position++;
+
+            int node = Tree.Add(NodeKind.Use, Position);
+
+            if (!ParsePath(node))
+                return SkipItem();
+
+            Expect(';');
+            return node;
+        }
+
+        // function Name ( Parameters ) -> Type Block
+        private int ParseFunction()
+        {
+            Position++;
+
+            if (!Is(Token.Name))
+            {
+                Error(DiagnosticCode.ExpectedFunctionName);
+                return SkipItem();
+            }
+
+            int node = Tree.Add(NodeKind.Function, Position++);
+
+            if (!Expect('('))
+                return SkipItem();
+
+            int last = -1;
+
+            while (!IsOperator(')') && Position < Tokens.Count)
+            {
+                if (last >= 0 && !Expect(','))
+                    break;
+
+                int parameter = ParseParameter();
+
+                if (parameter < 0)
+                    break;
+
+                last = Append(node, last, parameter);
+            }
+
+            if (!Expect(')'))
+                return SkipItem();
+
+            if (IsOperator('-', '>'))
+            {
+                Position++;
+
+                if (!Is(Token.Integer))
+                {
+                    Error(DiagnosticCode.ExpectedReturnType);
+                    return SkipItem();
+                }
+
+                Tree.Nodes[node].Extra = Position++;
+            }
+
+            if (!IsOperator('{'))
+            {
+                Error(DiagnosticCode.ExpectedOperator, "{");
+                return SkipItem();
+            }
+
+            // The nodes may move while the children are parsed, so a child is only stored once it is parsed
+            int body = ParseBlock();
+
+            if (TooDeep)
+            {
+                TooDeep = false;
+                return SkipItem();
+            }
+
+            Tree.Nodes[node].Right = body;
+            return node;
+        }
+
+        // Type Name
+        private int ParseParameter()
+        {
+            if (!Is(Token.Integer))
+            {
+                Error(DiagnosticCode.ExpectedParameterType);
+                return -1;
+            }
+
+            int type = Position++;
+
+            if (!Is(Token.Name))
+            {
+                Error(DiagnosticCode.ExpectedParameterName);
+                return -1;
+            }
+
+            int node = Tree.Add(NodeKind.Parameter, Position++);
+            Tree.Nodes[node].Extra = type;
+            return node;
+        }
+
+        // { Statement* }
+        private int ParseBlock()
+        {
+            int node = Tree.Add(NodeKind.Block, Position++);
+            int last = -1;
+
+            if (!Enter())
+                return node;
+
+            while (Position < Tokens.Count && !IsOperator('}') && !TooDeep)
+            {
+                int start = Position;
+                int statement = ParseStatement();
+
+                if (statement >= 0)
+                    last = Append(node, last, statement);
+
+                if (Position == start)
+                    Position++;
+            }
+
+            Depth--;
+            Expect('}');
+            return node;
+        }
+
+        private int ParseStatement()
+        {
+            if (IsOperator('{'))
+                return ParseBlock();
+
+            // return Expression? ;
+            if (IsKeyword(Word.Return))
+            {
+                int node = Tree.Add(NodeKind.Return, Position++);
+
+                if (!IsOperator(';'))
+                {
+                    int value = ParseExpression();
+                    Tree.Nodes[node].Left = value;
+
+                    if (value < 0)
+                        return Recover();
+                }
+
+                return EndStatement(node);
+            }
+
+            if (IsKeyword(Word.If))
+                return ParseIf();
+
+            if (IsKeyword(Word.While))
+                return ParseWhile();
+
+            if (IsKeyword(Word.For))
+                return ParseFor();
+
+            if (Is(Token.Keyword))
+            {
+                Error(DiagnosticCode.UnexpectedKeyword);
+                return Recover();
+            }
+
+            int statement = ParseSimpleStatement();
+            return (statement >= 0) ? EndStatement(statement) : -1;
+        }
+
+        // The statements a for loop can start and step with, each ended by the caller
+        private int ParseSimpleStatement()
+        {
+            // Type ([ Number ])? Name (= Expression)?
+            if (Is(Token.Integer))
+            {
+                int type = Position++;
+                int length = -1;
+
+                if (IsOperator('['))
+                {
+                    Position++;
+
+                    if (!IsArrayLength())
+                    {
+                        Error(DiagnosticCode.ExpectedArrayLength, MaxArrayLength.ToString());
+                        return Recover();
+                    }
+
+                    length = Tree.Add(NodeKind.Number, Position++);
+
+                    if (!Expect(']'))
+                        return Recover();
+                }
+
+                if (!Is(Token.Name))
+                {
+                    Error(DiagnosticCode.ExpectedVariableName);
+                    return Recover();
+                }
+
+                int node = Tree.Add(NodeKind.Declaration, Position++);
+                Tree.Nodes[node].Right = length;
+                Tree.Nodes[node].Extra = type;
+
+                if (IsOperator('='))
+                {
+                    if (length >= 0)
+                    {
+                        Error(DiagnosticCode.ArrayInitialized);
+                        return Recover();
+                    }
+
+                    Position++;
+
+                    int value = ParseExpression();
+                    Tree.Nodes[node].Left = value;
+
+                    if (value < 0)
+                        return Recover();
+                }
+
+                return node;
+            }
+
+            // Name = Expression
+            if (Is(Token.Name) && IsOperator(Position + 1, '='))
+            {
+                int node = Tree.Add(NodeKind.Assignment, Position);
+                Position += 2;
+
+                int value = ParseExpression();
+                Tree.Nodes[node].Left = value;
+
+                return (value >= 0) ? node : Recover();
+            }
+
+            // Name [ Expression ] = Expression, or an expression starting with the element
+            if (Is(Token.Name) && IsOperator(Position + 1, '['))
+            {
+                int name = Position;
+                int element = ParseExpression();
+
+                if (element < 0)
+                    return Recover();
+
+                if (Tree.Nodes[element].Kind == NodeKind.Index && IsOperator('='))
+                {
+                    int node = Tree.Add(NodeKind.Assignment, name);
+                    Position++;
+
+                    int value = ParseExpression();
+                    Tree.Nodes[node].Left = value;
+                    Tree.Nodes[node].Right = Tree.Nodes[element].Right;
+
+                    return (value >= 0) ? node : Recover();
+                }
+
+                int statement = Tree.Add(NodeKind.Expression, name);
+                Tree.Nodes[statement].Left = element;
+                return statement;
+            }
+
+            // Expression
+            int expression = Tree.Add(NodeKind.Expression, Position);
+            int left = ParseExpression();
+
+            Tree.Nodes[expression].Left = left;
+            return (left >= 0) ? expression : Recover();
+        }
+
+        // if ( Condition ) Block (else (If | Block))?
+        private int ParseIf()
+        {
+            int node = Tree.Add(NodeKind.If, Position++);
+            int condition = ParseParenthesizedCondition();
+
+            if (condition < 0)
+                return Recover();
+
+            if (!IsOperator('{'))
+            {
+                Error(DiagnosticCode.ExpectedOperator, "{");
+                return Recover();
+            }
+
+            int then = ParseBlock();
+            int otherwise = -1;
+
+            if (IsKeyword(Word.Else))
+            {
+                Position++;
+
+                // Every else if nests in the if before it
+                if (IsKeyword(Word.If))
+                {
+                    if (!Enter())
+                        return -1;
+
+                    otherwise = ParseIf();
+                    Depth--;
+                }
+
+                else if (IsOperator('{'))
+                    otherwise = ParseBlock();
+
+                else
+                {
+                    Error(DiagnosticCode.ExpectedOperator, "{");
+                    return Recover();
+                }
+
+                if (otherwise < 0)
+                    return -1;
+            }
+
+            Tree.Nodes[node].Left = condition;
+            Tree.Nodes[node].Right = then;
+            Tree.Nodes[node].Extra = otherwise;
+            return node;
+        }
+
+        // while ( Condition ) Block
+        private int ParseWhile()
+        {
+            int node = Tree.Add(NodeKind.While, Position++);
+            int condition = ParseParenthesizedCondition();
+
+            if (condition < 0)
+                return Recover();
+
+            if (!IsOperator('{'))
+            {
+                Error(DiagnosticCode.ExpectedOperator, "{");
+                return Recover();
+            }
+
+            int body = ParseBlock();
+
+            Tree.Nodes[node].Left = condition;
+            Tree.Nodes[node].Right = body;
+            return node;
+        }
+
+        // for ( Statement? ; Condition? ; Statement? ) Block, as { Statement; while ( Condition ) { Block Statement; } }
+        private int ParseFor()
+        {
+            int keyword = Position++;
+
+            if (!Expect('('))
+                return Recover();
+
+            int outer = Tree.Add(NodeKind.Block, keyword);
+            int initializer = -1;
+            int condition = -1;
+            int step = -1;
+
+            if (!IsOperator(';'))
+            {
+                initializer = ParseSimpleStatement();
+
+                if (initializer < 0)
+                    return -1;
+            }
+
+            if (!Expect(';'))
+                return Recover();
+
+            if (!IsOperator(';'))
+            {
+                condition = ParseCondition();
+
+                if (condition < 0)
+                    return Recover();
+            }
+
+            if (!Expect(';'))
+                return Recover();
+
+            if (!IsOperator(')'))
+            {
+                step = ParseSimpleStatement();
+
+                if (step < 0)
+                    return -1;
+            }
+
+            if (!Expect(')'))
+                return Recover();
+
+            if (!IsOperator('{'))
+            {
+                Error(DiagnosticCode.ExpectedOperator, "{");
+                return Recover();
+            }
+
+            int loop = Tree.Add(NodeKind.While, keyword);
+            int inner = Tree.Add(NodeKind.Block, keyword);
+            int body = ParseBlock();
+
+            Tree.Nodes[body].Next = step;
+            Tree.Nodes[inner].Left = body;
+            Tree.Nodes[loop].Left = condition;
+            Tree.Nodes[loop].Right = inner;
+            Append(outer, (initializer >= 0) ? Append(outer, -1, initializer) : -1, loop);
+            return outer;
+        }
+
+        private int ParseParenthesizedCondition()
+        {
+            if (!Expect('('))
+                return -1;
+
+            int condition = ParseCondition();
+            return (condition >= 0 && Expect(')')) ? condition : -1;
+        }
+
+        // Condition := Expression (( == | != | < | <= | > | >= ) Expression)?
+        private int ParseCondition()
+        {
+            int left = ParseExpression();
+
+            if (left < 0 || !IsComparison())
+                return left;
+
+            int node = Tree.Add(NodeKind.Compare, Position++);
+            int right = ParseExpression();
+
+            Tree.Nodes[node].Left = left;
+            Tree.Nodes[node].Right = right;
+            return (right >= 0) ? node : -1;
+        }
+
+        // The lexer lets the literals of signed types reach the magnitude of their minimum, which only a minus makes
+        // a value of the type
+        private int ParseNumber(bool negated)
+        {
+            NumberLiteral literal = Tokens.Numbers[Tokens.Items[Position].Value];
+
+            if (!negated && !literal.IsFloat && literal.Type != Word.None && Keywords.IsSigned(literal.Type) && literal.Value > (1UL << (Keywords.SizeOf(literal.Type) * 8 - 1)) - 1)
+                Error(DiagnosticCode.NumberTooLarge);
+
+            return Tree.Add(NodeKind.Number, Position++);
+        }
+
+        // A number without a suffix, which the array can hold in its frame
+        private bool IsArrayLength()
+        {
+            if (!Is(Token.Number))
+                return false;
+
+            NumberLiteral literal = Tokens.Numbers[Tokens.Items[Position].Value];
+            return !literal.IsFloat && literal.Type == Word.None && literal.Value >= 1 && literal.Value <= MaxArrayLength;
+        }
+
+        private bool IsComparison()
+        {
+            return IsOperator('=', '=') || IsOperator('!', '=') || IsOperator('<') || IsOperator('<', '=') || IsOperator('>') || IsOperator('>', '=');
+        }
+
+        private int EndStatement(int node)
+        {
+            return Expect(';') ? node : Recover();
+        }
+
+        // Expression := Term (( + | - ) Term)*
+        private int ParseExpression()
+        {
+            if (!Enter())
+                return -1;
+
+            int depth = Depth;
+            int left = ParseTerm();
+
+            // Every operator of the chain nests the terms before it one level deeper
+            while (left >= 0 && (IsOperator('+') || IsOperator('-')) && Enter())
+            {
+                int node = Tree.Add(NodeKind.Binary, Position++);
+                int right = ParseTerm();
+
+                Tree.Nodes[node].Left = left;
+                Tree.Nodes[node].Right = right;
+                left = (right >= 0) ? node : -1;
+            }
+
+            Depth = depth - 1;
+            return TooDeep ? -1 : left;
+        }
+
+        // Term := Unary (( * | / ) Unary)*
+        private int ParseTerm()
+        {
+            int depth = Depth;
+            int left = ParseUnary();
+
+            while (left >= 0 && (IsOperator('*') || IsOperator('/')) && Enter())
+            {
+                int node = Tree.Add(NodeKind.Binary, Position++);
+                int right = ParseUnary();
+
+                Tree.Nodes[node].Left = left;
+                Tree.Nodes[node].Right = right;
+                left = (right >= 0) ? node : -1;
+            }
+
+            Depth = depth;
+            return TooDeep ? -1 : left;
+        }
+
+        // Unary := - Unary | Primary
+        private int ParseUnary()
+        {
+            if (IsOperator('-'))
+            {
+                if (!Enter())
+                    return -1;
+
+                int node = Tree.Add(NodeKind.Negate, Position++);
+                int operand = Is(Token.Number) ? ParseNumber(true) : ParseUnary();
+
+                Depth--;
+                Tree.Nodes[node].Left = operand;
+                return (operand >= 0) ? node : -1;
+            }
+
+            return ParsePrimary();
+        }
+
+        // Primary := Number | String | Path Arguments? | Path [ Expression ] | ( Expression )
+        private int ParsePrimary()
+        {
+            if (Is(Token.Number))
+                return ParseNumber(false);
+
+            if (Is(Token.String))
+                return Tree.Add(NodeKind.String, Position++);
+
+            if (IsOperator('('))
+            {
+                Position++;
+                int expression = ParseExpression();
+                return Expect(')') ? expression : -1;
+            }
+
+            if (!Is(Token.Name))
+            {
+                Error(DiagnosticCode.ExpectedExpression);
+                return -1;
+            }
+
+            int name = Tree.Add(NodeKind.Name, Position);
+
+            if (!ParsePath(name))
+                return -1;
+
+            if (IsOperator('['))
+            {
+                int index = Tree.Add(NodeKind.Index, Position++);
+                int value = ParseExpression();
+
+                Tree.Nodes[index].Left = name;
+                Tree.Nodes[index].Right = value;
+                return (value >= 0 && Expect(']')) ? index : -1;
+            }
+
+            if (!IsOperator('('))
+                return name;
+
+            int call = Tree.Add(NodeKind.Call, Position++);
+            int last = -1;
+
+            Tree.Nodes[call].Left = name;
+
+            while (!IsOperator(')') && Position < Tokens.Count)
+            {
+                if (last >= 0 && !Expect(','))
+                    return -1;
+
+                int argument = ParseExpression();
+
+                if (argument < 0)
+                    return -1;
+
+                if (last < 0)
+                    Tree.Nodes[call].Right = argument;
+
+                else
+                    Tree.Nodes[last].Next = argument;
+
+                last = argument;
+            }
+
+            return Expect(')') ? call : -1;
+        }
+
+        // Name (:: Name)*, storing the last name in the Extra field of the node
+        private bool ParsePath(int node)
+        {
+            if (!Is(Token.Name))
+            {
+                Error(DiagnosticCode.ExpectedName);
+                return false;
+            }
+
+            Tree.Nodes[node].Token = Position;
+            Tree.Nodes[node].Extra = Position++;
+
+            while (IsOperator(':', ':'))
+            {
+                Position++;
+
+                if (!Is(Token.Name))
+                {
+                    Error(DiagnosticCode.ExpectedNameAfterPath);
+                    return false;
+                }
+
+                Tree.Nodes[node].Extra = Position++;
+            }
+
+            return true;
+        }
+
+        // Appends a node to the list of the parent, returning the new last node of the list
+        private int Append(int parent, int last, int node)
+        {
+            if (last < 0)
+                Tree.Nodes[parent].Left = node;
+
+            else
+                Tree.Nodes[last].Next = node;
+
+            return node;
+        }
+
+        private bool Is(Token type)
+        {
+            return Position < Tokens.Count && Tokens.Items[Position].Type == type;
+        }
+
+        private bool IsKeyword(Word word)
+        {
+            return Is(Token.Keyword) && Tokens.Items[Position].Value == (int)word;
+        }
+
+        private bool IsOperator(char c)
+        {
+            return IsOperator(Position, c);
+        }
+
+        private bool IsOperator(int position, char c)
+        {
+            if (position >= Tokens.Count)
+                return false;
+
+            Lexeme token = Tokens.Items[position];
+            return token.Type == Token.Operator && token.Value == Lexeme.OperatorOf(c);
+        }
+
+        private bool IsOperator(char first, char second)
+        {
+            if (Position >= Tokens.Count)
+                return false;
+
+            Lexeme token = Tokens.Items[Position];
+            return token.Type == Token.Operator && token.Value == Lexeme.OperatorOf(first, second);
+        }
+
+        private bool Expect(char c)
+        {
+            if (IsOperator(c))
+            {
+                Position++;
+                return true;
+            }
+
+            Error(DiagnosticCode.ExpectedOperator, DiagnosticMessages.TextOf(c));
+            return false;
+        }
+
+        // Skips to the end of the current statement, so one mistake does not cascade into many errors
+        private int Recover()
+        {
+            if (!TooDeep)
+                Synchronize();
+
+            return -1;
+        }
+
+        // Goes one level deeper, or reports that the nesting is too deep
+        private bool Enter()
+        {
+            if (TooDeep)
+                return false;
+
+            if (Depth == MaxDepth)
+            {
+                Error(DiagnosticCode.NestingTooDeep, MaxDepth.ToString());
+                TooDeep = true;
+                return false;
+            }
+
+            Depth++;
+            return true;
+        }
+
+        private void Synchronize()
+        {
+            while (Position < Tokens.Count)
+            {
+                if (IsOperator(';'))
+                {
+                    Position++;
+                    return;
+                }
+
+                if (IsOperator('}') || IsOperator('{') || IsKeyword(Word.Function) || IsKeyword(Word.Use))
+                    return;
+
+                Position++;
+            }
+        }
+
+        // Skips to the next item of the module after an invalid declaration
+        private int SkipItem()
+        {
+            while (Position < Tokens.Count && !IsKeyword(Word.Function) && !IsKeyword(Word.Use))
+                Position++;
+
+            return -1;
+        }
+
+        private void Error(DiagnosticCode code, string text = null)
+        {
+            if (TooDeep)
+                return;
+
+            if (Tokens.Count == 0)
+                Diagnostics.Add(code, -1, 0, text);
+
+            else
+            {
+                Lexeme token = Tokens.Items[Math.Min(Position, Tokens.Count - 1)];
+                Diagnostics.Add(code, token.Offset, token.Length, text);
+            }
+
+            ErrorCount++;
+        }
+    }
+}
@@ -0,0 +1,113 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+
+namespace Sage
+{
+    // The counts a program built with --profile-generate wrote when it exited, read by --profile-use. Every line is
+    // either "function <name> <calls>" or "branch <name> <line>:<column> <tested> <held>", a branch being an if, a
+    // while or a for by the position of its keyword. The counts of a function found several times are added, so the
+    // profiles of several runs can simply be concatenated.
+    internal class Profile
+    {
+        private struct Branch
+        {
+            public long Tested;
+            public long Held;
+        }
+
+        private readonly Dictionary<string, long> Calls = new Dictionary<string, long>(StringComparer.Ordinal);
+        private readonly Dictionary<string, Branch> Branches = new Dictionary<string, Branch>(StringComparer.Ordinal);
+
+        // The blocks running at least this often are hot, a hundredth of the count of the hottest function or branch
+        public long HotCount { get; private set; }
+
+        private Profile()
+        {
+        }
+
+        // Returns null when the file cannot be read or has a line of neither kind, after printing why
+        public static Profile Load(string fileName, TextWriter output)
+        {
+            string[] lines;
+
+            try
+            {
+                lines = File.ReadAllLines(fileName);
+            }
+
+            catch (Exception exception) when (exception is IOException || exception is UnauthorizedAccessException)
+            {
+                output.WriteLine($"[ERROR] Failed to read the profile \"{fileName}\": {exception.Message}");
+                return null;
+            }
+
+            Profile profile = new Profile();
+            long hottest = 0;
+
+            for (int i = 0; i < lines.Length; i++)
+            {
+                string[] fields = lines[i].Split(' ', StringSplitOptions.RemoveEmptyEntries);
+
+                if (fields.Length == 0 || fields[0].StartsWith('#'))
+                    continue;
+
+                long calls;
+                long tested;
+                long held;
+                long total;
+                Branch branch;
+
+                if (fields.Length == 3 && fields[0] == "function" && TryParse(fields[2], out calls))
+                {
+                    profile.Calls.TryGetValue(fields[1], out total);
+                    profile.Calls[fields[1]] = total + calls;
+                    hottest = Math.Max(hottest, total + calls);
+                }
+
+                else if (fields.Length == 5 && fields[0] == "branch" && TryParse(fields[3], out tested) && TryParse(fields[4], out held) && held <= tested)
+                {
+                    string key = KeyOf(fields[1], fields[2]);
+                    profile.Branches.TryGetValue(key, out branch);
+                    profile.Branches[key] = new Branch { Tested = branch.Tested + tested, Held = branch.Held + held };
+                    hottest = Math.Max(hottest, branch.Tested + tested);
+                }
+
+                else
+                {
+                    output.WriteLine($"[ERROR] The line {i + 1} of the profile \"{fileName}\" is not the count of a function nor of a branch.");
+                    return null;
+                }
+            }
+
+            profile.HotCount = Math.Max(1, hottest / 100);
+            return profile;
+        }
+
+        public bool TryGetCalls(string function, out long calls)
+        {
+            return Calls.TryGetValue(function, out calls);
+        }
+
+        public bool TryGetBranch(string function, string position, out long tested, out long held)
+        {
+            Branch branch;
+            bool found = Branches.TryGetValue(KeyOf(function, position), out branch);
+
+            tested = branch.Tested;
+            held = branch.Held;
+            return found;
+        }
+
+        private static string KeyOf(string function, string position)
+        {
+            return function + " " + position;
+        }
+
+        private static bool TryParse(string text, out long count)
+        {
+            return long.TryParse(text, NumberStyles.None, CultureInfo.InvariantCulture, out count);
+        }
+    }
+}
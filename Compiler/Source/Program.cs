@@ -1,12 +1,41 @@
-﻿
+﻿using System;
+
 namespace Sage
 {
     class Program
     {
-        static void Main()
+        static int Main(string[] args)
         {
-            Lexer lexer = new Lexer();
-            lexer.Read("../../Code/Main.sg");
+            string error;
+            Options options = Options.Parse(args, out error);
+
+            if (options == null)
+            {
+                Console.WriteLine($"[ERROR] {error}");
+                Console.WriteLine(Options.Usage);
+                return 1;
+            }
+
+            if (options.Help)
+            {
+                Console.WriteLine(Options.Usage);
+                return 0;
+            }
+
+            if (options.Server)
+                return new CompileServer(options.PipeName).Run();
+
+            // The files watched and the standard input stay with this process
+            if (options.Connect && !options.Watch && !options.Files.Contains(Options.StandardInput))
+            {
+                int exitCode;
+
+                if (CompileServer.TryCompile(options.PipeName, args, out exitCode))
+                    return exitCode;
+            }
+
+            Driver driver = new Driver(options);
+            return driver.Run();
         }
     }
 }
@@ -0,0 +1,285 @@
+﻿using System;
+using System.Collections.Generic;
+
+namespace Sage
+{
+    // Linear scan allocation of the virtual registers of a function, as described by Poletto and Sarkar.
+    // Every virtual register lives from its first definition to its last use, the intervals are visited by their start
+    // and take a free machine register, or the one of the active interval ending last, which then moves to the stack.
+    // With a profile the interval whose definition and uses ran the least is the one moved instead.
+    internal class RegisterAllocator
+    {
+        // Location of a virtual register that is never defined
+        public const int Unused = int.MinValue;
+
+        private readonly int[] CallerSaved;
+        private readonly int[] CalleeSaved;
+
+        // Machine register of every virtual register, or the stack slot encoded as -(slot + 1)
+        public int[] Locations { get; private set; }
+        public int SlotCount { get; private set; }
+
+        // The callee saved registers the function uses, which it must save and restore
+        public List<int> UsedCalleeSaved { get; private set; }
+
+        // Values live across a call can only be kept in the registers the call preserves
+        public RegisterAllocator(int[] callerSaved, int[] calleeSaved)
+        {
+            CallerSaved = callerSaved;
+            CalleeSaved = calleeSaved;
+        }
+
+        public static bool IsSlot(int location)
+        {
+            return location < 0 && location != Unused;
+        }
+
+        public static int SlotOf(int location)
+        {
+            return -location - 1;
+        }
+
+        public void Allocate(IrFunction function)
+        {
+            int registers = function.Registers.Count;
+            int[] starts = new int[registers];
+            int[] ends = new int[registers];
+            List<int> calls = new List<int>();
+
+            // The times the definition and the uses of every register ran in the profile
+            long[] weights = (function.BlockCounts != null) ? new long[registers] : null;
+            long count = function.EntryCount;
+
+            for (int i = 0; i < registers; i++)
+                starts[i] = -1;
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                Instruction instruction = function.Code[i];
+
+                if (instruction.Op == Opcode.Label && weights != null)
+                    count = function.CountOf((int)instruction.Value);
+
+                // The output calls the runtime when its buffer is full
+                if (instruction.Op == Opcode.Call || instruction.Op == Opcode.Write)
+                    calls.Add(i);
+
+                if (IrFunction.HasArguments(instruction.Op))
+                {
+                    for (int argument = 0; argument < instruction.Right; argument++)
+                        Use(function.Arguments[instruction.Left + argument], i, ends, weights, count);
+                }
+
+                else
+                {
+                    Use(instruction.Left, i, ends, weights, count);
+
+                    if (instruction.Op != Opcode.Constant && instruction.Op != Opcode.Parameter)
+                        Use(instruction.Right, i, ends, weights, count);
+                }
+
+                if (instruction.Target >= 0)
+                {
+                    if (starts[instruction.Target] < 0)
+                        starts[instruction.Target] = i;
+
+                    Use(instruction.Target, i, ends, weights, count);
+                }
+            }
+
+            // The parameters are all moved in place on entry, so they must not share a register before the first instruction
+            for (int i = 0; i < function.Count && function.Code[i].Op == Opcode.Parameter; i++)
+                ends[function.Code[i].Target] = Math.Max(ends[function.Code[i].Target], function.Parameters.Length);
+
+            ExtendOverLoops(function, starts, ends);
+
+            List<int> order = new List<int>();
+
+            for (int i = 0; i < registers; i++)
+            {
+                if (starts[i] >= 0)
+                    order.Add(i);
+            }
+
+            order.Sort((left, right) => (starts[left] != starts[right]) ? starts[left].CompareTo(starts[right]) : left.CompareTo(right));
+
+            Locations = new int[registers];
+            SlotCount = 0;
+            UsedCalleeSaved = new List<int>();
+
+            for (int i = 0; i < registers; i++)
+                Locations[i] = Unused;
+
+            HashSet<int> free = new HashSet<int>(CallerSaved);
+            free.UnionWith(CalleeSaved);
+
+            // Active intervals, sorted by their end
+            List<int> active = new List<int>();
+
+            foreach (int current in order)
+            {
+                // An interval ending where the current one starts frees its register, an instruction reads its operands
+                // before it writes its result
+                while (active.Count > 0 && ends[active[0]] <= starts[current])
+                {
+                    free.Add(Locations[active[0]]);
+                    active.RemoveAt(0);
+                }
+
+                bool acrossCall = CrossesCall(calls, starts[current], ends[current]);
+                int register = TakeFree(free, acrossCall ? null : CallerSaved);
+
+                if (register >= 0)
+                {
+                    Locations[current] = register;
+                    Insert(active, current, ends);
+                    continue;
+                }
+
+                // No register is free, the interval ending last goes to the stack, or the lightest one with a profile
+                int spill = -1;
+
+                for (int i = active.Count - 1; i >= 0; i--)
+                {
+                    if (acrossCall && Array.IndexOf(CalleeSaved, Locations[active[i]]) < 0)
+                        continue;
+
+                    if (spill < 0 || weights[active[i]] < weights[active[spill]])
+                        spill = i;
+
+                    if (weights == null)
+                        break;
+                }
+
+                if (spill >= 0 && IsSpilledBefore(active[spill], current, ends, weights))
+                {
+                    int victim = active[spill];
+
+                    Locations[current] = Locations[victim];
+                    Locations[victim] = -(SlotCount++ + 1);
+                    active.RemoveAt(spill);
+                    Insert(active, current, ends);
+                }
+
+                else
+                    Locations[current] = -(SlotCount++ + 1);
+            }
+
+            foreach (int register in CalleeSaved)
+            {
+                if (Array.IndexOf(Locations, register) >= 0)
+                    UsedCalleeSaved.Add(register);
+            }
+        }
+
+        // A register defined before a loop and read in it is read again by the next turn, so it lives until the jump
+        // back. Extending a register over an inner loop can make it reach into the outer one, so this goes on until
+        // no interval grows.
+        private static void ExtendOverLoops(IrFunction function, int[] starts, int[] ends)
+        {
+            Instruction[] code = function.Code;
+            List<int> headers = new List<int>();
+            List<int> jumps = new List<int>();
+            int[] labels = new int[function.BlockCount];
+
+            for (int i = 0; i < labels.Length; i++)
+                labels[i] = -1;
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                if (code[i].Op == Opcode.Label)
+                    labels[(int)code[i].Value] = i;
+
+                // The label of a block jumped to backwards was already seen
+                else if (code[i].Op == Opcode.Jump && labels[(int)code[i].Value] >= 0)
+                {
+                    headers.Add(labels[(int)code[i].Value]);
+                    jumps.Add(i);
+                }
+            }
+
+            bool changed = headers.Count > 0;
+
+            while (changed)
+            {
+                changed = false;
+
+                for (int loop = 0; loop < headers.Count; loop++)
+                {
+                    for (int register = 0; register < starts.Length; register++)
+                    {
+                        if (starts[register] >= 0 && starts[register] < headers[loop] && ends[register] >= headers[loop] && ends[register] < jumps[loop])
+                        {
+                            ends[register] = jumps[loop];
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        private static void Use(int register, int position, int[] ends, long[] weights, long count)
+        {
+            if (register < 0)
+                return;
+
+            ends[register] = Math.Max(ends[register], position);
+
+            if (weights != null)
+                weights[register] += count;
+        }
+
+        // Whether the active interval rather than the current one goes to the stack. Of intervals that ran as often,
+        // the one ending last does, as it would keep the register the longest.
+        private static bool IsSpilledBefore(int active, int current, int[] ends, long[] weights)
+        {
+            if (weights != null && weights[active] != weights[current])
+                return weights[active] < weights[current];
+
+            return ends[active] > ends[current];
+        }
+
+        // A call at the first or last position of the interval defines or reads it, without keeping it across the call
+        private static bool CrossesCall(List<int> calls, int start, int end)
+        {
+            foreach (int call in calls)
+            {
+                if (call > start && call < end)
+                    return true;
+            }
+
+            return false;
+        }
+
+        // Takes a free register, preferring the preferred ones and falling back on the callee saved ones
+        private int TakeFree(HashSet<int> free, int[] preferred)
+        {
+            if (preferred != null)
+            {
+                foreach (int register in preferred)
+                {
+                    if (free.Remove(register))
+                        return register;
+                }
+            }
+
+            foreach (int register in CalleeSaved)
+            {
+                if (free.Remove(register))
+                    return register;
+            }
+
+            return -1;
+        }
+
+        private static void Insert(List<int> active, int interval, int[] ends)
+        {
+            int index = active.Count;
+
+            while (index > 0 && ends[active[index - 1]] > ends[interval])
+                index--;
+
+            active.Insert(index, interval);
+        }
+    }
+}
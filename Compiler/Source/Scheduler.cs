@@ -0,0 +1,190 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Threading;
+
+namespace Sage
+{
+    // Runs one task for every node of an acyclic dependency graph, starting a task once all its dependencies finished.
+    // Every worker takes the tasks it made ready from the end of its own queue, and steals from the start of the others.
+    internal class Scheduler
+    {
+        // Double ended queue of ready tasks, the owner works at the end and thieves at the start
+        private class WorkQueue
+        {
+            private int[] Items = new int[16];
+            private int Start;
+            private int Count;
+
+            public void Push(int task)
+            {
+                lock (this)
+                {
+                    if (Count == Items.Length)
+                    {
+                        int[] items = new int[Items.Length * 2];
+
+                        for (int i = 0; i < Count; i++)
+                            items[i] = Items[(Start + i) & (Items.Length - 1)];
+
+                        Items = items;
+                        Start = 0;
+                    }
+
+                    Items[(Start + Count) & (Items.Length - 1)] = task;
+                    Count++;
+                }
+            }
+
+            public bool TryPop(out int task)
+            {
+                lock (this)
+                {
+                    if (Count == 0)
+                    {
+                        task = -1;
+                        return false;
+                    }
+
+                    Count--;
+                    task = Items[(Start + Count) & (Items.Length - 1)];
+                    return true;
+                }
+            }
+
+            public bool TrySteal(out int task)
+            {
+                lock (this)
+                {
+                    if (Count == 0)
+                    {
+                        task = -1;
+                        return false;
+                    }
+
+                    task = Items[Start];
+                    Start = (Start + 1) & (Items.Length - 1);
+                    Count--;
+                    return true;
+                }
+            }
+        }
+
+        private readonly Action<int> Work;
+        private readonly List<int>[] Dependents;
+        private readonly int[] Remaining;
+        private readonly WorkQueue[] Queues;
+
+        // Released once for every task made ready, so idle workers sleep until there is something to steal
+        private readonly SemaphoreSlim Ready = new SemaphoreSlim(0);
+        private int Pending;
+
+        private Scheduler(List<int>[] dependencies, int jobs, Action<int> work)
+        {
+            Work = work;
+            Dependents = new List<int>[dependencies.Length];
+            Remaining = new int[dependencies.Length];
+            Queues = new WorkQueue[jobs];
+            Pending = dependencies.Length;
+
+            for (int i = 0; i < jobs; i++)
+                Queues[i] = new WorkQueue();
+
+            for (int i = 0; i < dependencies.Length; i++)
+                Dependents[i] = new List<int>();
+
+            for (int i = 0; i < dependencies.Length; i++)
+            {
+                Remaining[i] = dependencies[i].Count;
+
+                foreach (int dependency in dependencies[i])
+                    Dependents[dependency].Add(i);
+            }
+        }
+
+        // The dependencies must not contain cycles, the tasks of a cycle would never start
+        public static void Run(List<int>[] dependencies, int jobs, Action<int> work)
+        {
+            if (dependencies.Length == 0)
+                return;
+
+            jobs = Math.Max(1, Math.Min(jobs, dependencies.Length));
+
+            Scheduler scheduler = new Scheduler(dependencies, jobs, work);
+            int next = 0;
+
+            // The first ready tasks are dealt to the workers in turn
+            for (int i = 0; i < dependencies.Length; i++)
+            {
+                if (scheduler.Remaining[i] == 0)
+                    scheduler.MakeReady(next++ % jobs, i);
+            }
+
+            Thread[] workers = new Thread[jobs - 1];
+
+            for (int i = 0; i < workers.Length; i++)
+            {
+                int index = i + 1;
+                workers[i] = new Thread(() => scheduler.Run(index)) { IsBackground = true, Name = $"Sage Scheduler {index}" };
+                workers[i].Start();
+            }
+
+            // The calling thread takes the part of the first worker
+            scheduler.Run(0);
+
+            foreach (Thread worker in workers)
+                worker.Join();
+
+            scheduler.Ready.Dispose();
+        }
+
+        private void Run(int worker)
+        {
+            while (Volatile.Read(ref Pending) > 0)
+            {
+                int task;
+
+                if (!Queues[worker].TryPop(out task) && !TrySteal(worker, out task))
+                {
+                    Ready.Wait();
+                    continue;
+                }
+
+                try
+                {
+                    Work(task);
+                }
+
+                finally
+                {
+                    foreach (int dependent in Dependents[task])
+                    {
+                        if (Interlocked.Decrement(ref Remaining[dependent]) == 0)
+                            MakeReady(worker, dependent);
+                    }
+
+                    // The last task wakes every sleeping worker, so they see that nothing is pending anymore
+                    if (Interlocked.Decrement(ref Pending) == 0)
+                        Ready.Release(Queues.Length);
+                }
+            }
+        }
+
+        private bool TrySteal(int worker, out int task)
+        {
+            for (int i = 1; i < Queues.Length; i++)
+            {
+                if (Queues[(worker + i) % Queues.Length].TrySteal(out task))
+                    return true;
+            }
+
+            task = -1;
+            return false;
+        }
+
+        private void MakeReady(int worker, int task)
+        {
+            Queues[worker].Push(task);
+            Ready.Release();
+        }
+    }
+}
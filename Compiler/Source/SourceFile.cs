@@ -0,0 +1,148 @@
+﻿using System;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Text;
+
+namespace Sage
+{
+    // The whole text of a source file, decoded once into a single pooled buffer
+    internal sealed class SourceFile : IDisposable
+    {
+        // Files from this size on are mapped instead of read into a byte buffer
+        private const long MapThreshold = 1 << 20;
+
+        public string FileName { get; private set; }
+        public Encoding Encoding { get; private set; }
+
+        // The buffer is pooled, so it is usually longer than the text
+        public char[] Text { get; private set; }
+        public int Length { get; private set; }
+
+        private SourceFile(string fileName)
+        {
+            FileName = fileName;
+        }
+
+        public static SourceFile Open(string fileName)
+        {
+            SourceFile source = new SourceFile(fileName);
+            long size = new FileInfo(fileName).Length;
+
+            if (size > int.MaxValue)
+                throw new IOException($"The file \"{fileName}\" is too large.");
+
+            if (size >= MapThreshold)
+                source.Map(size);
+
+            else
+                source.Load((int)size);
+
+            return source;
+        }
+
+        private void Load(int size)
+        {
+            byte[] bytes = BufferPool<byte>.Rent(size);
+
+            try
+            {
+                int count = 0;
+
+                using (FileStream stream = new FileStream(FileName, FileMode.Open, FileAccess.Read, FileShare.Read, 1, FileOptions.SequentialScan))
+                {
+                    int read;
+
+                    while (count < size && (read = stream.Read(bytes, count, size - count)) > 0)
+                        count += read;
+                }
+
+                int bom;
+                Encoding = DetectEncoding(bytes[0], bytes[1], bytes[2], bytes[3], count, out bom);
+
+                Text = BufferPool<char>.Rent(Encoding.GetMaxCharCount(count - bom));
+                Length = Encoding.GetChars(bytes, bom, count - bom, Text, 0);
+            }
+
+            finally
+            {
+                BufferPool<byte>.Return(bytes);
+            }
+        }
+
+        private unsafe void Map(long size)
+        {
+            using (MemoryMappedFile file = MemoryMappedFile.CreateFromFile(FileName, FileMode.Open, null, 0, MemoryMappedFileAccess.Read))
+            using (MemoryMappedViewAccessor view = file.CreateViewAccessor(0, size, MemoryMappedFileAccess.Read))
+            {
+                byte* pointer = null;
+                view.SafeMemoryMappedViewHandle.AcquirePointer(ref pointer);
+
+                try
+                {
+                    byte* bytes = pointer + view.PointerOffset;
+                    int count = (int)size;
+
+                    int bom;
+                    Encoding = DetectEncoding(bytes[0], bytes[1], bytes[2], bytes[3], count, out bom);
+
+                    Text = BufferPool<char>.Rent(Encoding.GetMaxCharCount(count - bom));
+
+                    fixed (char* text = Text)
+                        Length = Encoding.GetChars(bytes + bom, count - bom, text, Text.Length);
+                }
+
+                finally
+                {
+                    view.SafeMemoryMappedViewHandle.ReleasePointer();
+                }
+            }
+        }
+
+        // Detects the encoding from the byte order mark, sources without one are read as UTF-8
+        private static Encoding DetectEncoding(byte b0, byte b1, byte b2, byte b3, int count, out int bom)
+        {
+            if (count >= 4 && b0 == 0xFF && b1 == 0xFE && b2 == 0 && b3 == 0)
+            {
+                bom = 4;
+                return new UTF32Encoding(false, false);
+            }
+
+            if (count >= 2 && b0 == 0xFF && b1 == 0xFE)
+            {
+                bom = 2;
+                return new UnicodeEncoding(false, false);
+            }
+
+            if (count >= 2 && b0 == 0xFE && b1 == 0xFF)
+            {
+                bom = 2;
+                return new UnicodeEncoding(true, false);
+            }
+
+            bom = (count >= 3 && b0 == 0xEF && b1 == 0xBB && b2 == 0xBF) ? 3 : 0;
+            return new UTF8Encoding(false);
+        }
+
+        // Replaces a range of the text by another one, used when a source is edited in place
+        public void Replace(int offset, int removed, string inserted)
+        {
+            int length = Length - removed + inserted.Length;
+            char[] text = BufferPool<char>.Rent(length);
+
+            Array.Copy(Text, 0, text, 0, offset);
+            inserted.CopyTo(0, text, offset, inserted.Length);
+            Array.Copy(Text, offset + removed, text, offset + inserted.Length, Length - offset - removed);
+
+            BufferPool<char>.Return(Text);
+            Text = text;
+            Length = length;
+        }
+
+        public void Dispose()
+        {
+            BufferPool<char>.Return(Text);
+            Text = null;
+            Length = 0;
+        }
+    }
+}
@@ -0,0 +1,158 @@
+﻿using System;
+
+namespace Sage
+{
+    // The names in scope while a function is walked, in one flat table keyed by their interned symbol ids.
+    // Declaring a name saves the binding it hides in an undo log, so closing a scope only replays the log back to its
+    // mark, and no scope allocates anything. Slots are never emptied: a name that went out of scope keeps its slot
+    // with a negative depth, which keeps the probe chains intact without tombstones.
+    internal class SymbolTable
+    {
+        private struct Undo
+        {
+            public int Symbol;
+            public int Value;
+            public int Depth;
+        }
+
+        private int[] Symbols;
+        private int[] Values;
+
+        // Depth of the scope that declared the visible binding, -1 when the name is not in scope
+        private int[] Depths;
+
+        // The slots of other generations are free, so clearing the table only starts a new one
+        private int[] Generations;
+        private int Generation = 1;
+        private int Used;
+        private int Mask;
+
+        private Undo[] Log = new Undo[64];
+        private int LogCount;
+
+        public int Depth { get; private set; }
+
+        public SymbolTable(int capacity = 64)
+        {
+            int size = 16;
+
+            while (size < capacity * 2)
+                size *= 2;
+
+            Allocate(size);
+        }
+
+        private void Allocate(int size)
+        {
+            Symbols = new int[size];
+            Values = new int[size];
+            Depths = new int[size];
+            Generations = new int[size];
+            Mask = size - 1;
+            Used = 0;
+        }
+
+        public void Clear()
+        {
+            Generation++;
+            Used = 0;
+            LogCount = 0;
+            Depth = 0;
+        }
+
+        // Opens a scope, returning the mark Pop goes back to
+        public int Push()
+        {
+            Depth++;
+            return LogCount;
+        }
+
+        public void Pop(int mark)
+        {
+            while (LogCount > mark)
+            {
+                Undo undo = Log[--LogCount];
+                int slot = FindSlot(undo.Symbol);
+                Values[slot] = undo.Value;
+                Depths[slot] = undo.Depth;
+            }
+
+            Depth--;
+        }
+
+        // Binds a name in the innermost scope, returning false when that scope already declares it
+        public bool Declare(int symbol, int value)
+        {
+            int slot = FindSlot(symbol);
+
+            if (Generations[slot] != Generation)
+            {
+                // Half full at most, so the probes stay short
+                if ((Used + 1) * 2 > Symbols.Length)
+                {
+                    Grow();
+                    slot = FindSlot(symbol);
+                }
+
+                Generations[slot] = Generation;
+                Symbols[slot] = symbol;
+                Depths[slot] = -1;
+                Used++;
+            }
+
+            else if (Depths[slot] == Depth)
+                return false;
+
+            if (LogCount == Log.Length)
+                Array.Resize(ref Log, LogCount * 2);
+
+            Log[LogCount++] = new Undo { Symbol = symbol, Value = Values[slot], Depth = Depths[slot] };
+            Values[slot] = value;
+            Depths[slot] = Depth;
+            return true;
+        }
+
+        public bool TryFind(int symbol, out int value)
+        {
+            int slot = FindSlot(symbol);
+            bool found = Generations[slot] == Generation && Depths[slot] >= 0;
+
+            value = found ? Values[slot] : -1;
+            return found;
+        }
+
+        // The slot of the symbol, or the free slot it would take
+        private int FindSlot(int symbol)
+        {
+            int slot = (int)((uint)symbol * 0x9E3779B1u) & Mask;
+
+            while (Generations[slot] == Generation && Symbols[slot] != symbol)
+                slot = (slot + 1) & Mask;
+
+            return slot;
+        }
+
+        private void Grow()
+        {
+            int[] symbols = Symbols;
+            int[] values = Values;
+            int[] depths = Depths;
+            int[] generations = Generations;
+
+            Allocate(symbols.Length * 2);
+
+            for (int i = 0; i < symbols.Length; i++)
+            {
+                if (generations[i] != Generation)
+                    continue;
+
+                int slot = FindSlot(symbols[i]);
+                Generations[slot] = Generation;
+                Symbols[slot] = symbols[i];
+                Values[slot] = values[i];
+                Depths[slot] = depths[i];
+                Used++;
+            }
+        }
+    }
+}
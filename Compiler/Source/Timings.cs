@@ -0,0 +1,214 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Text;
+using System.Threading;
+
+namespace Sage
+{
+    // The clock and the allocation counter when a measured pass started
+    internal struct TimingMark
+    {
+        public long Ticks;
+        public long Allocated;
+        public long ThreadAllocated;
+    }
+
+    // One measured pass, of the whole program when File is null
+    internal struct TimingEvent
+    {
+        public string Name;
+        public string File;
+        public int Thread;
+        public long Start;
+        public long Duration;
+        public long Allocated;
+        public int Tokens;
+    }
+
+    // Records the time and the memory of every pass, reported by --time-passes and exported by --trace
+    internal class Timings
+    {
+        private readonly Stopwatch Clock = Stopwatch.StartNew();
+        private readonly List<TimingEvent> Events = new List<TimingEvent>();
+        private readonly int[] Collections = new int[3];
+
+        public Timings()
+        {
+            for (int i = 0; i < Collections.Length; i++)
+                Collections[i] = GC.CollectionCount(i);
+        }
+
+        public TimingMark Start()
+        {
+            return new TimingMark { Ticks = Clock.ElapsedTicks, Allocated = GC.GetTotalAllocatedBytes(true), ThreadAllocated = GC.GetAllocatedBytesForCurrentThread() };
+        }
+
+        public void Stop(TimingMark start, string name, string file = null, int tokens = 0)
+        {
+            TimingEvent timing = new TimingEvent
+            {
+                Name = name,
+                File = file,
+                Thread = Thread.CurrentThread.ManagedThreadId,
+                Start = start.Ticks,
+                Duration = Clock.ElapsedTicks - start.Ticks,
+                Allocated = Allocated(start, file),
+                Tokens = tokens
+            };
+
+            lock (Events)
+                Events.Add(timing);
+        }
+
+        // The pass of a file runs on one thread, so its allocations are exact whatever the number of jobs
+        private static long Allocated(TimingMark start, string file)
+        {
+            if (file != null)
+                return GC.GetAllocatedBytesForCurrentThread() - start.ThreadAllocated;
+
+            return GC.GetTotalAllocatedBytes(true) - start.Allocated;
+        }
+
+        public void Report(TextWriter writer)
+        {
+            writer.WriteLine("[INFO] Time of the passes:");
+            writer.WriteLine($"  {"Pass",-24} {"Time (ms)",12} {"Allocated (KB)",16}");
+
+            foreach (TimingEvent timing in Events)
+            {
+                if (timing.File == null)
+                    writer.WriteLine($"  {timing.Name,-24} {Milliseconds(timing.Duration),12:F2} {timing.Allocated / 1024,16}");
+            }
+
+            writer.Write($"  Collections of generations 0, 1 and 2:");
+
+            for (int i = 0; i < Collections.Length; i++)
+                writer.Write($" {GC.CollectionCount(i) - Collections[i]}");
+
+            writer.WriteLine();
+
+            // One row for every file, in the order of its first pass
+            List<string> files = new List<string>();
+            Dictionary<string, TimingEvent[]> rows = new Dictionary<string, TimingEvent[]>(StringComparer.Ordinal);
+            string[] columns = { "Read", "Lex", "Parse", "Cache", "Analyze", "Lower", "Optimize", "Generate" };
+
+            foreach (TimingEvent timing in Events)
+            {
+                if (timing.File == null)
+                    continue;
+
+                TimingEvent[] row;
+
+                if (!rows.TryGetValue(timing.File, out row))
+                {
+                    row = new TimingEvent[columns.Length];
+                    rows.Add(timing.File, row);
+                    files.Add(timing.File);
+                }
+
+                int column = Array.IndexOf(columns, timing.Name);
+
+                row[column].Duration += timing.Duration;
+                row[column].Allocated += timing.Allocated;
+                row[column].Tokens += timing.Tokens;
+            }
+
+            if (files.Count == 0)
+                return;
+
+            writer.WriteLine("[INFO] Time of the files, in milliseconds:");
+            writer.Write("  ");
+
+            foreach (string column in columns)
+                writer.Write($"{column,10} ");
+
+            writer.WriteLine($"{"Tokens",10} {"Allocated (KB)",16}  File");
+
+            foreach (string file in files)
+            {
+                TimingEvent[] row = rows[file];
+                long allocated = 0;
+                int tokens = 0;
+
+                writer.Write("  ");
+
+                foreach (TimingEvent cell in row)
+                {
+                    writer.Write($"{Milliseconds(cell.Duration),10:F2} ");
+                    allocated += cell.Allocated;
+                    tokens += cell.Tokens;
+                }
+
+                writer.WriteLine($"{tokens,10} {allocated / 1024,16}  {file}");
+            }
+        }
+
+        // Writes the passes in the trace event format, which chrome://tracing and Perfetto can open
+        public void WriteTrace(string fileName)
+        {
+            StringBuilder builder = new StringBuilder();
+            int process = Process.GetCurrentProcess().Id;
+
+            builder.Append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+            for (int i = 0; i < Events.Count; i++)
+            {
+                TimingEvent timing = Events[i];
+
+                if (i > 0)
+                    builder.Append(',');
+
+                builder.Append("\n{\"name\":");
+                AppendString(builder, (timing.File != null) ? $"{timing.Name} {Path.GetFileName(timing.File)}" : timing.Name);
+                builder.Append(",\"cat\":\"").Append((timing.File != null) ? "file" : "pass").Append('"');
+                builder.Append(",\"ph\":\"X\",\"pid\":").Append(process).Append(",\"tid\":").Append(timing.Thread);
+                builder.Append(",\"ts\":").Append(Microseconds(timing.Start).ToString("F1", CultureInfo.InvariantCulture));
+                builder.Append(",\"dur\":").Append(Microseconds(timing.Duration).ToString("F1", CultureInfo.InvariantCulture));
+                builder.Append(",\"args\":{\"allocated\":").Append(timing.Allocated);
+
+                if (timing.File != null)
+                {
+                    builder.Append(",\"tokens\":").Append(timing.Tokens).Append(",\"file\":");
+                    AppendString(builder, timing.File);
+                }
+
+                builder.Append("}}");
+            }
+
+            builder.Append("\n]}\n");
+            File.WriteAllText(fileName, builder.ToString());
+        }
+
+        private static void AppendString(StringBuilder builder, string text)
+        {
+            builder.Append('"');
+
+            foreach (char c in text)
+            {
+                if (c == '"' || c == '\\')
+                    builder.Append('\\').Append(c);
+
+                else if (c < ' ')
+                    builder.Append("\\u").Append(((int)c).ToString("x4"));
+
+                else
+                    builder.Append(c);
+            }
+
+            builder.Append('"');
+        }
+
+        private static double Milliseconds(long ticks)
+        {
+            return ticks * 1000.0 / Stopwatch.Frequency;
+        }
+
+        private static double Microseconds(long ticks)
+        {
+            return ticks * 1000000.0 / Stopwatch.Frequency;
+        }
+    }
+}
@@ -0,0 +1,370 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+
+namespace Sage
+{
+    // Keeps the tokens and the syntax tree of every source on disk, keyed by the hash of its text and the compiler build.
+    // Names and string constants are stored as text and interned again when loaded, since their ids only live in a process.
+    internal unsafe class TokenCache
+    {
+        private const int Magic = 0x43544753; // "SGTC"
+        private const int FormatVersion = 1;
+        private const int HeaderSize = 4 * 2 + 16 + 8 + 4 * 8;
+
+        // Deterministic builds give the module the same id for the same compiler sources, and a new one for any change
+        private static readonly Guid CompilerVersion = typeof(TokenCache).Assembly.ManifestModule.ModuleVersionId;
+
+        private readonly string Directory;
+        private readonly IInterner Names;
+        private readonly IInterner Strings;
+
+        public TokenCache(string directory, IInterner names, IInterner strings)
+        {
+            Directory = directory;
+            Names = names;
+            Strings = strings;
+
+            System.IO.Directory.CreateDirectory(directory);
+        }
+
+        public static ulong HashOf(SourceFile source)
+        {
+            fixed (char* text = source.Text)
+                return Hash64((byte*)text, source.Length * sizeof(char));
+        }
+
+        // Loads the tokens and the tree of an unchanged source, the stream takes ownership of the source
+        public bool TryLoad(SourceFile source, ulong hash, out TokenStream tokens, out Ast tree)
+        {
+            tokens = null;
+            tree = null;
+
+            string fileName = PathOf(hash);
+
+            if (!File.Exists(fileName))
+                return false;
+
+            try
+            {
+                long size = new FileInfo(fileName).Length;
+
+                if (size < HeaderSize)
+                    return false;
+
+                using (MemoryMappedFile file = MemoryMappedFile.CreateFromFile(fileName, FileMode.Open, null, 0, MemoryMappedFileAccess.Read))
+                using (MemoryMappedViewAccessor view = file.CreateViewAccessor(0, size, MemoryMappedFileAccess.Read))
+                {
+                    byte* pointer = null;
+                    view.SafeMemoryMappedViewHandle.AcquirePointer(ref pointer);
+
+                    try
+                    {
+                        return Load(pointer + view.PointerOffset, size, source, hash, out tokens, out tree);
+                    }
+
+                    finally
+                    {
+                        view.SafeMemoryMappedViewHandle.ReleasePointer();
+                    }
+                }
+            }
+
+            // Another compiler may be writing or deleting the entry, which is then simply a miss
+            catch (Exception exception) when (exception is IOException || exception is UnauthorizedAccessException)
+            {
+                return false;
+            }
+        }
+
+        private bool Load(byte* data, long size, SourceFile source, ulong hash, out TokenStream tokens, out Ast tree)
+        {
+            tokens = null;
+            tree = null;
+
+            int* header = (int*)data;
+
+            if (header[0] != Magic || header[1] != FormatVersion || *(Guid*)(data + 8) != CompilerVersion || *(ulong*)(data + 24) != hash)
+                return false;
+
+            int* counts = (int*)(data + 32);
+            int sourceLength = counts[0];
+            int tokenCount = counts[1];
+            int numberCount = counts[2];
+            int nodeCount = counts[3];
+            int nameCount = counts[4];
+            int nameChars = counts[5];
+            int stringCount = counts[6];
+            int stringChars = counts[7];
+
+            long expected = HeaderSize + (long)(nameCount + stringCount) * sizeof(int) + (long)(nameChars + stringChars) * sizeof(char) +
+                (long)tokenCount * sizeof(Lexeme) + (long)numberCount * sizeof(NumberLiteral) + (long)Math.Max(nodeCount, 0) * sizeof(Node);
+
+            if (sourceLength != source.Length || expected != size)
+                return false;
+
+            byte* position = data + HeaderSize;
+
+            int[] nameIds = InternAll(Names, ref position, nameCount, nameChars);
+            int[] stringIds = InternAll(Strings, ref position, stringCount, stringChars);
+
+            Lexeme[] items = new Lexeme[Math.Max(tokenCount, 16)];
+            Copy(ref position, items, tokenCount);
+
+            NumberLiteral[] numbers = new NumberLiteral[Math.Max(numberCount, 16)];
+            Copy(ref position, numbers, numberCount);
+
+            for (int i = 0; i < tokenCount; i++)
+            {
+                if (items[i].Type == Token.Name)
+                    items[i].Value = nameIds[items[i].Value];
+
+                else if (items[i].Type == Token.String)
+                    items[i].Value = stringIds[items[i].Value];
+            }
+
+            tokens = new TokenStream(source, items, tokenCount, numbers, numberCount) { Names = Names, Strings = Strings };
+
+            if (nodeCount >= 0)
+            {
+                Node[] nodes = new Node[Math.Max(nodeCount, 16)];
+                Copy(ref position, nodes, nodeCount);
+                tree = new Ast(tokens, nodes, nodeCount);
+            }
+
+            return true;
+        }
+
+        // Stores the tokens and the tree of a source, which is skipped when it had errors so they are reported again
+        public void Save(ulong hash, TokenStream tokens, Ast tree)
+        {
+            List<int> names = new List<int>();
+            List<int> strings = new List<int>();
+            Dictionary<int, int> nameIndexes = new Dictionary<int, int>();
+            Dictionary<int, int> stringIndexes = new Dictionary<int, int>();
+
+            Lexeme[] items = new Lexeme[tokens.Count];
+            Array.Copy(tokens.Items, items, tokens.Count);
+
+            for (int i = 0; i < items.Length; i++)
+            {
+                if (items[i].Type == Token.Name)
+                    items[i].Value = LocalIndex(items[i].Value, names, nameIndexes);
+
+                else if (items[i].Type == Token.String)
+                    items[i].Value = LocalIndex(items[i].Value, strings, stringIndexes);
+            }
+
+            string fileName = PathOf(hash);
+            string temporary = fileName + "." + Guid.NewGuid().ToString("N") + ".tmp";
+
+            try
+            {
+                using (FileStream stream = new FileStream(temporary, FileMode.CreateNew, FileAccess.Write, FileShare.None, 1 << 16))
+                using (BinaryWriter writer = new BinaryWriter(stream))
+                {
+                    string[] nameTexts = TextsOf(Names, names);
+                    string[] stringTexts = TextsOf(Strings, strings);
+
+                    writer.Write(Magic);
+                    writer.Write(FormatVersion);
+                    writer.Write(CompilerVersion.ToByteArray());
+                    writer.Write(hash);
+
+                    writer.Write(tokens.SourceLength);
+                    writer.Write(items.Length);
+                    writer.Write(tokens.NumberCount);
+                    writer.Write((tree != null) ? tree.Count : -1);
+                    writer.Write(nameTexts.Length);
+                    writer.Write(TotalLength(nameTexts));
+                    writer.Write(stringTexts.Length);
+                    writer.Write(TotalLength(stringTexts));
+
+                    WriteTexts(writer, nameTexts);
+                    WriteTexts(writer, stringTexts);
+                    writer.Flush();
+
+                    Write(stream, items, items.Length);
+                    Write(stream, tokens.Numbers, tokens.NumberCount);
+
+                    if (tree != null)
+                        Write(stream, tree.Nodes, tree.Count);
+                }
+
+                // The entry only appears once complete, replacing the one of an older compiler
+                if (File.Exists(fileName))
+                    File.Delete(fileName);
+
+                File.Move(temporary, fileName);
+            }
+
+            catch (Exception exception) when (exception is IOException || exception is UnauthorizedAccessException)
+            {
+                if (File.Exists(temporary))
+                    File.Delete(temporary);
+            }
+        }
+
+        private string PathOf(ulong hash)
+        {
+            return Path.Combine(Directory, hash.ToString("x16") + ".sgc");
+        }
+
+        private static int LocalIndex(int id, List<int> ids, Dictionary<int, int> indexes)
+        {
+            int index;
+
+            if (!indexes.TryGetValue(id, out index))
+            {
+                index = ids.Count;
+                ids.Add(id);
+                indexes.Add(id, index);
+            }
+
+            return index;
+        }
+
+        private static string[] TextsOf(IInterner interner, List<int> ids)
+        {
+            string[] texts = new string[ids.Count];
+
+            for (int i = 0; i < texts.Length; i++)
+                texts[i] = interner.GetText(ids[i]);
+
+            return texts;
+        }
+
+        private static int TotalLength(string[] texts)
+        {
+            int length = 0;
+
+            foreach (string text in texts)
+                length += text.Length;
+
+            return length;
+        }
+
+        // The lengths of the texts, followed by all their characters
+        private static void WriteTexts(BinaryWriter writer, string[] texts)
+        {
+            foreach (string text in texts)
+                writer.Write(text.Length);
+
+            foreach (string text in texts)
+            {
+                foreach (char c in text)
+                    writer.Write((ushort)c);
+            }
+        }
+
+        // Interns the texts of a table, returning the ids of the pool for every local index
+        private static int[] InternAll(IInterner interner, ref byte* position, int count, int chars)
+        {
+            int* lengths = (int*)position;
+            char[] text = new char[chars];
+            int[] ids = new int[count];
+
+            position += count * sizeof(int);
+            Copy(ref position, text, chars);
+
+            for (int i = 0, start = 0; i < count; start += lengths[i], i++)
+                ids[i] = interner.Intern(text, start, lengths[i]);
+
+            return ids;
+        }
+
+        private static void Copy<T>(ref byte* position, T[] array, int count) where T : unmanaged
+        {
+            long bytes = (long)count * sizeof(T);
+
+            fixed (T* target = array)
+                Buffer.MemoryCopy(position, target, (long)array.Length * sizeof(T), bytes);
+
+            position += bytes;
+        }
+
+        private static void Write<T>(Stream stream, T[] array, int count) where T : unmanaged
+        {
+            fixed (T* source = array)
+            {
+                using (UnmanagedMemoryStream memory = new UnmanagedMemoryStream((byte*)source, (long)count * sizeof(T)))
+                    memory.CopyTo(stream);
+            }
+        }
+
+        // XXH64 of the data, fast enough to be negligible next to lexing
+        private static ulong Hash64(byte* data, int length)
+        {
+            const ulong Prime1 = 11400714785074694791;
+            const ulong Prime2 = 14029467366897019727;
+            const ulong Prime3 = 1609587929392839161;
+            const ulong Prime4 = 9650029242287828579;
+            const ulong Prime5 = 2870177450012600261;
+
+            byte* end = data + length;
+            ulong hash;
+
+            if (length >= 32)
+            {
+                ulong v1 = unchecked(Prime1 + Prime2);
+                ulong v2 = Prime2;
+                ulong v3 = 0;
+                ulong v4 = unchecked(0 - Prime1);
+
+                for (; data + 32 <= end; data += 32)
+                {
+                    v1 = Round(v1, *(ulong*)data);
+                    v2 = Round(v2, *(ulong*)(data + 8));
+                    v3 = Round(v3, *(ulong*)(data + 16));
+                    v4 = Round(v4, *(ulong*)(data + 24));
+                }
+
+                hash = Rotate(v1, 1) + Rotate(v2, 7) + Rotate(v3, 12) + Rotate(v4, 18);
+                hash = Merge(hash, v1);
+                hash = Merge(hash, v2);
+                hash = Merge(hash, v3);
+                hash = Merge(hash, v4);
+            }
+
+            else
+                hash = Prime5;
+
+            hash += (ulong)length;
+
+            for (; data + 8 <= end; data += 8)
+                hash = Rotate(hash ^ Round(0, *(ulong*)data), 27) * Prime1 + Prime4;
+
+            if (data + 4 <= end)
+            {
+                hash = Rotate(hash ^ (*(uint*)data * Prime1), 23) * Prime2 + Prime3;
+                data += 4;
+            }
+
+            for (; data < end; data++)
+                hash = Rotate(hash ^ (*data * Prime5), 11) * Prime1;
+
+            hash ^= hash >> 33;
+            hash *= Prime2;
+            hash ^= hash >> 29;
+            hash *= Prime3;
+            hash ^= hash >> 32;
+            return hash;
+        }
+
+        private static ulong Round(ulong accumulator, ulong input)
+        {
+            return Rotate(accumulator + input * 14029467366897019727, 31) * 11400714785074694791;
+        }
+
+        private static ulong Merge(ulong hash, ulong accumulator)
+        {
+            return (hash ^ Round(0, accumulator)) * 11400714785074694791 + 9650029242287828579;
+        }
+
+        private static ulong Rotate(ulong value, int count)
+        {
+            return (value << count) | (value >> (64 - count));
+        }
+    }
+}
@@ -0,0 +1,343 @@
+﻿using System;
+using System.Globalization;
+using System.IO;
+
+namespace Sage
+{
+    internal struct Lexeme
+    {
+        public Token Type;
+        public int Offset;
+        public int Length;
+        public int Line;
+        public int Column;
+
+        // Meaning of the token: the Word of keywords and integer types, the symbol id of names, the characters of
+        // operators, the index of a number literal or the constant id of the decoded content of a string
+        public int Value;
+
+        public Lexeme(Token type, int offset, int length, int line, int column)
+        {
+            Type = type;
+            Offset = offset;
+            Length = length;
+            Line = line;
+            Column = column;
+            Value = 0;
+        }
+
+        // Value of the operator made of the characters, the second one is zero for operators of one character
+        public static int OperatorOf(char first, char second = '\0')
+        {
+            return first | (second << 16);
+        }
+    }
+
+    internal struct NumberLiteral
+    {
+        // The integer value, or the bits of the double for floats
+        public ulong Value;
+
+        // The integer type given as suffix, None when the literal has no suffix
+        public Word Type;
+
+        public bool IsFloat;
+
+        public double Float
+        {
+            get { return BitConverter.Int64BitsToDouble((long)Value); }
+        }
+    }
+
+    internal class TokenStream : IDisposable
+    {
+        // Cached names, so dumping does not format the enum for every token
+        private static readonly string[] TypeNames = Enum.GetNames<Token>();
+
+        public SourceFile File { get; private set; }
+        public string FileName { get; private set; }
+
+        // Null for the streams read from a Stream, whose text was not kept
+        public char[] Source { get; private set; }
+        public int SourceLength { get; private set; }
+
+        // Starts of the lines of the streams without source, so their diagnostics can still be located
+        public int[] LineStarts { get; set; }
+
+        // The pools the names and the string constants of the stream are interned in
+        public IInterner Names { get; set; }
+        public IInterner Strings { get; set; }
+
+        public Lexeme[] Items { get; private set; }
+        public int Count { get; private set; }
+
+        // Values of the number literals, parsed once by the lexer
+        public NumberLiteral[] Numbers { get; private set; }
+        public int NumberCount { get; private set; }
+
+        // Entries of the table no token refers to anymore, left behind by the edits
+        private int DeadNumbers;
+
+        public TokenStream(char[] source, int sourceLength)
+        {
+            Source = source;
+            SourceLength = sourceLength;
+
+            // Most sources produce about one token every four characters
+            Items = new Lexeme[Math.Max(16, sourceLength / 4)];
+            Numbers = new NumberLiteral[16];
+        }
+
+        public TokenStream(SourceFile file) : this(file.Text, file.Length)
+        {
+            File = file;
+            FileName = file.FileName;
+        }
+
+        // A stream whose tokens are added as the text goes by, and which never holds the whole text
+        public TokenStream(string fileName)
+        {
+            FileName = fileName;
+            Items = new Lexeme[1024];
+            Numbers = new NumberLiteral[16];
+        }
+
+        public void SetLength(int sourceLength)
+        {
+            SourceLength = sourceLength;
+        }
+
+        // Builds a stream from tokens that were already lexed, such as the ones of the cache
+        public TokenStream(SourceFile file, Lexeme[] items, int count, NumberLiteral[] numbers, int numberCount)
+        {
+            File = file;
+            FileName = file.FileName;
+            Source = file.Text;
+            SourceLength = file.Length;
+            Items = items;
+            Count = count;
+            Numbers = numbers;
+            NumberCount = numberCount;
+        }
+
+        public Lexeme this[int index]
+        {
+            get { return Items[index]; }
+        }
+
+        public void Add(Lexeme token)
+        {
+            if (Count == Items.Length)
+            {
+                Lexeme[] items = new Lexeme[Items.Length * 2];
+                Array.Copy(Items, items, Count);
+                Items = items;
+            }
+
+            Items[Count++] = token;
+        }
+
+        public int AddNumber(NumberLiteral literal)
+        {
+            if (NumberCount == Numbers.Length)
+            {
+                NumberLiteral[] numbers = new NumberLiteral[Numbers.Length * 2];
+                Array.Copy(Numbers, numbers, NumberCount);
+                Numbers = numbers;
+            }
+
+            Numbers[NumberCount] = literal;
+            return NumberCount++;
+        }
+
+        // Drops the entries no token refers to once they are the larger part of the table, so editing the same
+        // literals again and again does not grow it
+        public void ReleaseNumbers(int count)
+        {
+            DeadNumbers += count;
+
+            if (DeadNumbers <= NumberCount / 2)
+                return;
+
+            NumberLiteral[] numbers = new NumberLiteral[Math.Max(16, (NumberCount - DeadNumbers) * 2)];
+            int numberCount = 0;
+
+            for (int i = 0; i < Count; i++)
+            {
+                if (Items[i].Type == Token.Number)
+                {
+                    numbers[numberCount] = Numbers[Items[i].Value];
+                    Items[i].Value = numberCount++;
+                }
+            }
+
+            Numbers = numbers;
+            NumberCount = numberCount;
+            DeadNumbers = 0;
+        }
+
+        // Replaces a range of the source text, the tokens themselves are updated by Lexer.Relex
+        public void ReplaceText(int offset, int removed, string inserted)
+        {
+            if (File != null)
+            {
+                File.Replace(offset, removed, inserted);
+                Source = File.Text;
+                SourceLength = File.Length;
+                return;
+            }
+
+            char[] text = new char[SourceLength - removed + inserted.Length];
+
+            Array.Copy(Source, 0, text, 0, offset);
+            inserted.CopyTo(0, text, offset, inserted.Length);
+            Array.Copy(Source, offset + removed, text, offset + inserted.Length, SourceLength - offset - removed);
+
+            Source = text;
+            SourceLength = text.Length;
+        }
+
+        // Replaces the tokens of [start, start + count) and moves the following ones by the size of the edit
+        public void Splice(int start, int count, Lexeme[] tokens, int tokenCount, int offsetDelta, int lineDelta)
+        {
+            int tail = Count - start - count;
+            int newCount = start + tokenCount + tail;
+
+            if (newCount > Items.Length)
+            {
+                Lexeme[] items = new Lexeme[Math.Max(newCount, Items.Length * 2)];
+                Array.Copy(Items, items, start);
+                Array.Copy(Items, start + count, items, start + tokenCount, tail);
+                Items = items;
+            }
+
+            else
+                Array.Copy(Items, start + count, Items, start + tokenCount, tail);
+
+            Array.Copy(tokens, 0, Items, start, tokenCount);
+            Count = newCount;
+
+            for (int i = start + tokenCount; i < Count; i++)
+            {
+                Items[i].Offset += offsetDelta;
+                Items[i].Line += lineDelta;
+            }
+        }
+
+        // Returns the index of the first token starting at or after the offset
+        public int FindToken(int offset)
+        {
+            int low = 0;
+            int high = Count;
+
+            while (low < high)
+            {
+                int middle = (low + high) >> 1;
+
+                if (Items[middle].Offset < offset)
+                    low = middle + 1;
+
+                else
+                    high = middle;
+            }
+
+            return low;
+        }
+
+        public string GetText(int index)
+        {
+            if (Source != null)
+                return new string(Source, Items[index].Offset, Items[index].Length);
+
+            // Without the source, the text is written back from the meaning of the token
+            Lexeme token = Items[index];
+
+            switch (token.Type)
+            {
+                case Token.Name:
+                    return Names.GetText(token.Value);
+
+                case Token.Keyword:
+                case Token.Integer:
+                    return Keywords.TextOf((Word)token.Value);
+
+                case Token.Operator:
+                    return (token.Length == 2) ? new string(new[] { (char)token.Value, (char)(token.Value >> 16) }) : ((char)token.Value).ToString();
+
+                case Token.String:
+                    return "\"" + Strings.GetText(token.Value) + "\"";
+
+                default:
+                    NumberLiteral literal = Numbers[token.Value];
+                    string text = literal.IsFloat ? literal.Float.ToString("R", CultureInfo.InvariantCulture) : literal.Value.ToString(CultureInfo.InvariantCulture);
+                    return (literal.Type != Word.None) ? text + Keywords.TextOf(literal.Type) : text;
+            }
+        }
+
+        // Writes the text from the first token to the end of the last one
+        public void WriteText(TextWriter writer, int first, int last)
+        {
+            if (Source != null)
+            {
+                writer.Write(Source, Items[first].Offset, Items[last].Offset + Items[last].Length - Items[first].Offset);
+                return;
+            }
+
+            for (int i = first; i <= last; i++)
+                writer.Write(GetText(i));
+        }
+
+        public void Dispose()
+        {
+            if (File != null)
+                File.Dispose();
+
+            File = null;
+            Source = null;
+        }
+
+        public void Dump(TextWriter writer)
+        {
+            for (int i = 0; i < Count; i++)
+            {
+                writer.Write("{ Value: \"");
+                WriteText(writer, i, i);
+                writer.Write("\" | Type: ");
+                writer.Write(TypeNames[(int)Items[i].Type]);
+                writer.Write(" | Line: ");
+                writer.Write(Items[i].Line);
+                writer.Write(" | Column: ");
+                writer.Write(Items[i].Column);
+
+                if (Items[i].Type == Token.Name && Names != null)
+                {
+                    writer.Write(" | Symbol: ");
+                    writer.Write(Items[i].Value);
+                }
+
+                if (Items[i].Type == Token.String && Strings != null)
+                {
+                    writer.Write(" | Constant: ");
+                    writer.Write(Items[i].Value);
+                }
+
+                if (Items[i].Type == Token.Number)
+                {
+                    NumberLiteral literal = Numbers[Items[i].Value];
+                    writer.Write(" | Literal: ");
+
+                    if (literal.IsFloat)
+                        writer.Write(literal.Float.ToString("R", CultureInfo.InvariantCulture));
+
+                    else
+                        writer.Write(literal.Value);
+
+                    if (literal.Type != Word.None)
+                        writer.Write(" " + literal.Type);
+                }
+
+                writer.WriteLine(" }");
+            }
+        }
+    }
+}
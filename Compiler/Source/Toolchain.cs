@@ -0,0 +1,72 @@
+﻿using System;
+using System.ComponentModel;
+using System.Diagnostics;
+using System.IO;
+using System.Text;
+
+namespace Sage
+{
+    // Assembles and links the generated code with the C compiler of the system, which also provides the C runtime.
+    // The compiler is "cc", or the one named by the CC environment variable.
+    internal static class Toolchain
+    {
+        public static bool IsWindows
+        {
+            get { return Environment.OSVersion.Platform == PlatformID.Win32NT; }
+        }
+
+        // Builds an object file or an executable from an assembly file, writing the errors of the compiler to the log
+        public static bool Build(string assemblyFile, string output, bool objectOnly, TextWriter log)
+        {
+            string compiler = Environment.GetEnvironmentVariable("CC");
+
+            if (string.IsNullOrEmpty(compiler))
+                compiler = IsWindows ? "gcc" : "cc";
+
+            ProcessStartInfo start = new ProcessStartInfo
+            {
+                FileName = compiler,
+                Arguments = $"{(objectOnly ? "-c " : "")}-o \"{output}\" \"{assemblyFile}\"",
+                UseShellExecute = false,
+                RedirectStandardOutput = true,
+                RedirectStandardError = true,
+                CreateNoWindow = true
+            };
+
+            try
+            {
+                using (Process process = Process.Start(start))
+                {
+                    // Reading one stream asynchronously keeps the compiler from blocking on a full pipe
+                    StringBuilder errors = new StringBuilder();
+
+                    process.ErrorDataReceived += (sender, e) =>
+                    {
+                        if (e.Data != null)
+                            errors.AppendLine(e.Data);
+                    };
+
+                    process.BeginErrorReadLine();
+
+                    string messages = process.StandardOutput.ReadToEnd();
+                    process.WaitForExit();
+
+                    log.Write(messages);
+
+                    if (process.ExitCode == 0)
+                        return true;
+
+                    log.Write(errors.ToString());
+                    log.WriteLine($"[ERROR] The C compiler \"{compiler}\" failed to build \"{output}\".");
+                    return false;
+                }
+            }
+
+            catch (Win32Exception exception)
+            {
+                log.WriteLine($"[ERROR] Failed to run the C compiler \"{compiler}\": {exception.Message}");
+                return false;
+            }
+        }
+    }
+}
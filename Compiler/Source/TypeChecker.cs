@@ -0,0 +1,507 @@
+﻿using System;
+
+namespace Sage
+{
+    // A type is a handle into the type table, the integer types come in the order of their Word
+    enum TypeId : byte
+    {
+        // Unknown, because of an error that was already reported
+        Error = 0,
+
+        I8,
+        U8,
+        I16,
+        U16,
+        I32,
+        U32,
+        I64,
+        U64,
+
+        // Number literals without a suffix, which take the type of their context
+        Literal,
+        Float,
+        String,
+
+        // The result of the calls of functions returning nothing
+        Nothing
+    }
+
+    internal static class TypeTable
+    {
+        private static readonly string[] Names = { "<error>", "i8", "u8", "i16", "u16", "i32", "u32", "i64", "u64", "integer", "float", "string", "nothing" };
+
+        public static TypeId Of(Word word)
+        {
+            return (word >= Word.I8 && word <= Word.U64) ? (TypeId)(word - Word.I8 + (int)TypeId.I8) : TypeId.Nothing;
+        }
+
+        // The integer type of a handle, i32 for literals and for the types the backend cannot hold
+        public static Word WordOf(TypeId type)
+        {
+            return IsInteger(type) ? (Word)(type - TypeId.I8 + (int)Word.I8) : Word.I32;
+        }
+
+        public static bool IsInteger(TypeId type)
+        {
+            return type >= TypeId.I8 && type <= TypeId.U64;
+        }
+
+        // Whether the first integer type holds every value of the second one
+        public static bool Holds(TypeId type, TypeId value)
+        {
+            Word word = WordOf(type);
+            Word other = WordOf(value);
+
+            if (Keywords.IsSigned(word) == Keywords.IsSigned(other))
+                return Keywords.SizeOf(word) >= Keywords.SizeOf(other);
+
+            return Keywords.IsSigned(word) && Keywords.SizeOf(word) > Keywords.SizeOf(other);
+        }
+
+        // The narrowest integer type holding every value of both, Error when not even i64 holds the ones of u64
+        public static TypeId Common(TypeId left, TypeId right)
+        {
+            if (Holds(left, right))
+                return left;
+
+            if (Holds(right, left))
+                return right;
+
+            // One is signed and the other unsigned and at least as large, the signed type twice as large follows it
+            TypeId unsigned = Keywords.IsSigned(WordOf(left)) ? right : left;
+            return (unsigned != TypeId.U64) ? unsigned + 1 : TypeId.Error;
+        }
+
+        public static string NameOf(TypeId type)
+        {
+            return Names[(int)type];
+        }
+    }
+
+    // Gives every expression of a module its own type and checks it against the type its context expects.
+    // The expressions of a function are checked in one batch: a first sweep lists their nodes with every parent
+    // before its children, one backward sweep computes the types from the operands up, and one forward sweep passes
+    // the expected types down, so a function takes linear time whatever the number of its statements.
+    internal class TypeChecker
+    {
+        private readonly ModuleGraph Graph;
+        private Module Module;
+        private Ast Tree;
+        private TypeId[] Expected;
+        private int[] Order = new int[256];
+        private int Count;
+
+        public TypeChecker(ModuleGraph graph)
+        {
+            Graph = graph;
+        }
+
+        // Fills Module.Types, the variables must already be bound
+        public void Check(Module module)
+        {
+            Module = module;
+            Tree = module.Tree;
+            module.Types = new TypeId[Tree.Count];
+            Expected = new TypeId[Tree.Count];
+
+            Node[] nodes = Tree.Nodes;
+
+            for (int item = nodes[Tree.Root].Left; item >= 0; item = nodes[item].Next)
+            {
+                if (nodes[item].Kind != NodeKind.Function)
+                    continue;
+
+                Count = 0;
+                TypeId returnType = (nodes[item].Extra >= 0) ? TypeTable.Of((Word)Tree.Tokens[nodes[item].Extra].Value) : TypeId.Nothing;
+
+                AddStatements(nodes[item].Right, returnType);
+                ComputeTypes();
+                CheckExpected();
+            }
+
+            Module = null;
+            Tree = null;
+            Expected = null;
+        }
+
+        // Lists the expressions of the statements, each after the expressions containing it
+        private void AddStatements(int block, TypeId returnType)
+        {
+            Node[] nodes = Tree.Nodes;
+
+            for (int node = nodes[block].Left; node >= 0; node = nodes[node].Next)
+                AddStatement(node, returnType);
+        }
+
+        private void AddStatement(int node, TypeId returnType)
+        {
+            Node statement = Tree.Nodes[node];
+
+            switch (statement.Kind)
+            {
+                case NodeKind.Block:
+                    AddStatements(node, returnType);
+                    break;
+
+                case NodeKind.Declaration:
+                    AddExpression(statement.Left, TypeTable.Of((Word)Tree.Tokens[statement.Extra].Value));
+                    break;
+
+                // Arrays are only assigned element by element, through an index in i64
+                case NodeKind.Assignment:
+                {
+                    int variable = Module.Bindings[node];
+
+                    if (variable >= 0 && IsArray(variable) != (statement.Right >= 0))
+                        ModuleGraph.Error(Module, statement.Token, IsArray(variable) ? DiagnosticCode.ArrayWithoutIndex : DiagnosticCode.NotAnArray);
+
+                    AddExpression(statement.Left, (variable >= 0) ? TypeOfVariable(variable) : TypeId.Error);
+                    AddExpression(statement.Right, TypeId.I64);
+                    break;
+                }
+
+                // Returning a value from a function returning nothing is reported by the lowering
+                case NodeKind.Return:
+                    AddExpression(statement.Left, (returnType != TypeId.Nothing) ? returnType : TypeId.Error);
+                    break;
+
+                case NodeKind.Expression:
+                    AddExpression(statement.Left, TypeId.Error);
+                    break;
+
+                // Conditions hold when they are not zero, or compare their operands in the type of the operands
+                case NodeKind.If:
+                    AddExpression(statement.Left, TypeId.Error);
+                    AddStatement(statement.Right, returnType);
+
+                    if (statement.Extra >= 0)
+                        AddStatement(statement.Extra, returnType);
+
+                    break;
+
+                case NodeKind.While:
+                    AddExpression(statement.Left, TypeId.Error);
+                    AddStatement(statement.Right, returnType);
+                    break;
+            }
+        }
+
+        private void AddExpression(int root, TypeId expected)
+        {
+            if (root < 0)
+                return;
+
+            Node[] nodes = Tree.Nodes;
+            int first = Count;
+
+            Expected[root] = expected;
+            Add(root);
+
+            // The list itself serves as the queue of the nodes whose operands are not listed yet
+            for (int i = first; i < Count; i++)
+            {
+                Node expression = nodes[Order[i]];
+
+                switch (expression.Kind)
+                {
+                    case NodeKind.Negate:
+                        Add(expression.Left);
+                        break;
+
+                    case NodeKind.Binary:
+                    case NodeKind.Compare:
+                        Add(expression.Left);
+                        Add(expression.Right);
+                        break;
+
+                    case NodeKind.Call:
+                        for (int argument = expression.Right; argument >= 0; argument = nodes[argument].Next)
+                            Add(argument);
+
+                        break;
+
+                    // The name of the array is not a value of its own
+                    case NodeKind.Index:
+                        Add(expression.Right);
+                        break;
+                }
+            }
+        }
+
+        private void Add(int node)
+        {
+            if (Count == Order.Length)
+                Array.Resize(ref Order, Count * 2);
+
+            Order[Count++] = node;
+        }
+
+        // From the last node to the first, so the operands are typed before the expressions using them
+        private void ComputeTypes()
+        {
+            Node[] nodes = Tree.Nodes;
+            TypeId[] types = Module.Types;
+
+            for (int i = Count - 1; i >= 0; i--)
+            {
+                int node = Order[i];
+                Node expression = nodes[node];
+
+                switch (expression.Kind)
+                {
+                    case NodeKind.Number:
+                    {
+                        NumberLiteral literal = Tree.Tokens.Numbers[Tree.Tokens[expression.Token].Value];
+                        types[node] = literal.IsFloat ? TypeId.Float : (literal.Type != Word.None) ? TypeTable.Of(literal.Type) : TypeId.Literal;
+                        break;
+                    }
+
+                    case NodeKind.String:
+                        types[node] = TypeId.String;
+                        break;
+
+                    case NodeKind.Name:
+                        types[node] = (Module.Bindings[node] >= 0) ? TypeOfVariable(Module.Bindings[node]) : TypeId.Error;
+                        break;
+
+                    case NodeKind.Negate:
+                        types[node] = types[expression.Left];
+                        break;
+
+                    case NodeKind.Index:
+                        types[node] = (Module.Bindings[expression.Left] >= 0) ? TypeOfVariable(Module.Bindings[expression.Left]) : TypeId.Error;
+                        break;
+
+                    // Literals without a suffix take the type of the other operand, integers of two types compute in one
+                    // holding both, and comparisons have the type they compare in
+                    case NodeKind.Binary:
+                    case NodeKind.Compare:
+                    {
+                        TypeId left = types[expression.Left];
+                        TypeId right = types[expression.Right];
+
+                        if (left == TypeId.Literal)
+                            types[node] = right;
+
+                        else if (right == TypeId.Literal || !TypeTable.IsInteger(left) || !TypeTable.IsInteger(right))
+                            types[node] = left;
+
+                        else
+                        {
+                            types[node] = TypeTable.Common(left, right);
+
+                            if (types[node] == TypeId.Error)
+                                ModuleGraph.Error(Module, expression.Token, DiagnosticCode.MixedTypes, $"{TypeTable.NameOf(left)} and {TypeTable.NameOf(right)}");
+                        }
+
+                        break;
+                    }
+
+                    case NodeKind.Call:
+                    {
+                        Module target;
+                        int function;
+
+                        if (!TryResolve(nodes[expression.Left], out target, out function))
+                            types[node] = TypeId.Error;
+
+                        else
+                        {
+                            int returnType = target.Tree.Nodes[function].Extra;
+                            types[node] = (returnType >= 0) ? TypeTable.Of((Word)target.Tree.Tokens[returnType].Value) : TypeId.Nothing;
+                        }
+
+                        break;
+                    }
+                }
+            }
+        }
+
+        // From the first node to the last, so every expression knows the type expected from it before its operands
+        private void CheckExpected()
+        {
+            Node[] nodes = Tree.Nodes;
+            TypeId[] types = Module.Types;
+
+            for (int i = 0; i < Count; i++)
+            {
+                int node = Order[i];
+                Node expression = nodes[node];
+                TypeId expected = Expected[node];
+                TypeId type = types[node];
+
+                if (TypeTable.IsInteger(expected))
+                {
+                    if (type == TypeId.String)
+                        ModuleGraph.Error(Module, expression.Token, DiagnosticCode.ExpectedInteger, TypeTable.NameOf(expected));
+
+                    else if (type == TypeId.Nothing)
+                    {
+                        Module target;
+                        int function;
+
+                        TryResolve(nodes[expression.Left], out target, out function);
+                        ModuleGraph.Error(Module, nodes[expression.Left].Token, DiagnosticCode.ReturnsNothing, NameOf(target, function));
+                    }
+
+                    else if (type == TypeId.Literal && expression.Kind == NodeKind.Number)
+                        CheckLiteral(node, node, expected, false);
+
+                    // Only the literals without a suffix take any integer type, the other values only widen
+                    else if (TypeTable.IsInteger(type) && !TypeTable.Holds(expected, type))
+                        ModuleGraph.Error(Module, expression.Token, DiagnosticCode.NarrowingConversion, $"{TypeTable.NameOf(type)} to {TypeTable.NameOf(expected)}");
+                }
+
+                // Operators compute in the type expected from them when it holds their own one, or else in their own one.
+                // The operands of two types no type holds are not checked once more.
+                TypeId operands;
+
+                if (IsMixed(node))
+                    operands = TypeId.Error;
+
+                else if (TypeTable.IsInteger(expected) && (!TypeTable.IsInteger(type) || TypeTable.Holds(expected, type)))
+                    operands = expected;
+
+                else
+                    operands = TypeTable.IsInteger(type) ? type : TypeId.I32;
+
+                switch (expression.Kind)
+                {
+                    case NodeKind.Negate:
+                        // A negated literal is checked with its sign, and not once more on its own
+                        if (types[expression.Left] == TypeId.Literal && nodes[expression.Left].Kind == NodeKind.Number)
+                        {
+                            CheckLiteral(node, expression.Left, operands, true);
+                            Expected[expression.Left] = TypeId.Error;
+                        }
+
+                        else
+                            Expected[expression.Left] = operands;
+
+                        break;
+
+                    case NodeKind.Binary:
+                    case NodeKind.Compare:
+                        Expected[expression.Left] = operands;
+                        Expected[expression.Right] = operands;
+                        break;
+
+                    case NodeKind.Call:
+                        ExpectArguments(expression);
+                        break;
+
+                    case NodeKind.Name:
+                        if (Module.Bindings[node] >= 0 && IsArray(Module.Bindings[node]))
+                            ModuleGraph.Error(Module, expression.Token, DiagnosticCode.ArrayWithoutIndex);
+
+                        break;
+
+                    case NodeKind.Index:
+                    {
+                        int variable = Module.Bindings[expression.Left];
+
+                        if (variable >= 0 && !IsArray(variable))
+                            ModuleGraph.Error(Module, nodes[expression.Left].Token, DiagnosticCode.NotAnArray);
+
+                        Expected[expression.Right] = TypeId.I64;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // An operator whose operands have integer types no type holds both of
+        private bool IsMixed(int node)
+        {
+            Node expression = Tree.Nodes[node];
+            TypeId[] types = Module.Types;
+
+            return (expression.Kind == NodeKind.Binary || expression.Kind == NodeKind.Compare) && types[node] == TypeId.Error &&
+                TypeTable.IsInteger(types[expression.Left]) && TypeTable.IsInteger(types[expression.Right]);
+        }
+
+        // Arguments of unknown functions and of the runtime are not checked
+        private void ExpectArguments(Node call)
+        {
+            Node[] nodes = Tree.Nodes;
+            Module target;
+            int function;
+            bool resolved = TryResolve(nodes[call.Left], out target, out function);
+            int parameter = resolved ? target.Tree.Nodes[function].Left : -1;
+            int count = 0;
+
+            for (int argument = call.Right; argument >= 0; argument = nodes[argument].Next, count++)
+            {
+                Expected[argument] = (parameter >= 0) ? TypeTable.Of((Word)target.Tree.Tokens[target.Tree.Nodes[parameter].Extra].Value) : TypeId.Error;
+
+                if (parameter >= 0)
+                    parameter = target.Tree.Nodes[parameter].Next;
+            }
+
+            if (!resolved)
+                return;
+
+            int parameters = 0;
+
+            for (parameter = target.Tree.Nodes[function].Left; parameter >= 0; parameter = target.Tree.Nodes[parameter].Next)
+                parameters++;
+
+            if (count != parameters)
+                ModuleGraph.Error(Module, nodes[call.Left].Token, DiagnosticCode.ArgumentCount, NameOf(target, function), parameters, count);
+        }
+
+        // Warns about the literals that wrap around in the type they are converted to, as the lowering wraps them
+        private void CheckLiteral(int first, int literal, TypeId type, bool negated)
+        {
+            Node number = Tree.Nodes[literal];
+            ulong value = Tree.Tokens.Numbers[Tree.Tokens[number.Token].Value].Value;
+            Word word = TypeTable.WordOf(type);
+            int bits = Keywords.SizeOf(word) * 8;
+            bool signed = Keywords.IsSigned(word);
+
+            // Signed types hold one more negative value than positive ones, unsigned ones only hold zero negated
+            ulong max = signed ? (1UL << (bits - 1)) - 1 : (bits == 64) ? ulong.MaxValue : (1UL << bits) - 1;
+            bool fits = negated ? (signed ? value <= max + 1 : value == 0) : value <= max;
+
+            if (!fits)
+                ModuleGraph.Warning(Module, Tree.Nodes[first].Token, number.Token, DiagnosticCode.NumberWraps, TypeTable.NameOf(type));
+        }
+
+        // The name of a function as the lowering gives it
+        private static string NameOf(Module module, int function)
+        {
+            return module.Name + "::" + module.Tree.Tokens.GetText(module.Tree.Nodes[function].Token);
+        }
+
+        // The type of a variable, or of the elements of an array
+        private TypeId TypeOfVariable(int node)
+        {
+            return TypeTable.Of((Word)Tree.Tokens[Tree.Nodes[node].Extra].Value);
+        }
+
+        // Parameters are never arrays, only the declarations with a length
+        private bool IsArray(int node)
+        {
+            return Tree.Nodes[node].Kind == NodeKind.Declaration && Tree.Nodes[node].Right >= 0;
+        }
+
+        // The function a callee names, false for the runtime and for the unknown functions the analyzer reported
+        private bool TryResolve(Node callee, out Module target, out int function)
+        {
+            target = Module;
+            function = -1;
+
+            if (callee.Extra != callee.Token)
+            {
+                int index = Graph.Find(ModuleGraph.PathOf(Tree, callee.Token, callee.Extra - 2));
+
+                if (index < 0 || (index != Module.Index && !Module.Dependencies.Contains(index)))
+                    return false;
+
+                target = Graph.Modules[index];
+            }
+
+            return !target.IsRuntime && target.Functions.TryGetValue(Tree.Tokens[callee.Extra].Value, out function);
+        }
+    }
+}
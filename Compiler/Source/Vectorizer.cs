@@ -0,0 +1,324 @@
+﻿using System;
+using System.Collections.Generic;
+
+namespace Sage
+{
+    // Finds the for loops over the elements of arrays that can run a vector of elements at a time, for the native code
+    // at -O2. A loop qualifies when it counts a variable up by one while it is less than an invariant, and its body
+    // only assigns elements at the index of the variable from additions, subtractions and multiplications of elements
+    // at that same index and of invariants. Every turn then only touches its own elements, so the turns of a vector
+    // can run together. The lowering keeps the loop after the kernel for the elements left over.
+    internal class Vectorizer
+    {
+        // Vectors live in xmm0 to xmm5, which neither the System V nor the Windows convention asks to preserve
+        private const int VectorRegisters = 6;
+
+        private readonly bool Avx2;
+        private readonly bool Report;
+
+        private Module Module;
+        private Ast Tree;
+        private IrFunction Function;
+        private int[] Registers;
+        private int Variable;
+        private IrKernel Kernel;
+        private List<int> Invariants;
+        private readonly Dictionary<int, int> Variables = new Dictionary<int, int>();
+        private readonly Dictionary<ulong, int> Numbers = new Dictionary<ulong, int>();
+        private int Depth;
+        private int MaxDepth;
+        private bool Multiplies;
+
+        // With AVX2 the vectors take 32 bytes instead of the 16 of SSE2, and 32 bit elements can be multiplied
+        public Vectorizer(bool avx2, bool report)
+        {
+            Avx2 = avx2;
+            Report = report;
+        }
+
+        // Returns the kernel of the loop, with the variable it counts, the node of its end and the nodes of the
+        // invariants in the order of the parameters of the kernel, or null when the loop does not qualify
+        public IrKernel Vectorize(Module module, IrFunction function, int[] registers, int loop, List<int> invariants, out int variable, out int end)
+        {
+            Module = module;
+            Tree = module.Tree;
+            Function = function;
+            Registers = registers;
+            Invariants = invariants;
+            Kernel = new IrKernel { Bound = int.MaxValue };
+            Variables.Clear();
+            Numbers.Clear();
+            Depth = 0;
+            MaxDepth = 0;
+            Multiplies = false;
+
+            string reason = Match(loop, out end);
+            IrKernel kernel = Kernel;
+            int token = Tree.Nodes[loop].Token;
+
+            variable = Variable;
+
+            if (reason == null)
+                reason = Check();
+
+            if (Report && reason != null)
+                ModuleGraph.Warning(module, token, token, DiagnosticCode.LoopNotVectorized, reason);
+
+            else if (Report)
+                ModuleGraph.Warning(module, token, token, DiagnosticCode.LoopVectorized, TypeTable.NameOf(TypeTable.Of(kernel.Type)), kernel.Lanes);
+
+            Module = null;
+            Tree = null;
+            Function = null;
+            Registers = null;
+            Invariants = null;
+            Kernel = null;
+            return (reason == null) ? kernel : null;
+        }
+
+        // The reason the shape of the loop does not qualify, or null. A for loop is a while loop whose body is a block
+        // holding the block of the statements followed by the step.
+        private string Match(int loop, out int end)
+        {
+            Node[] nodes = Tree.Nodes;
+            Node statement = nodes[loop];
+            int condition = statement.Left;
+
+            end = -1;
+            Variable = -1;
+
+            if (condition < 0 || nodes[condition].Kind != NodeKind.Compare || Tree.Tokens[nodes[condition].Token].Value != Lexeme.OperatorOf('<') || !IsVariable(nodes[condition].Left))
+                return "its condition is not a variable less than another variable or a number";
+
+            Variable = Module.Bindings[nodes[condition].Left];
+            end = nodes[condition].Right;
+
+            if (!IsInvariant(end))
+                return "its condition is not a variable less than another variable or a number";
+
+            int body = nodes[statement.Right].Left;
+            int step = (body >= 0) ? nodes[body].Next : -1;
+
+            if (step < 0 || !IsStep(step))
+                return "its step is not the variable plus one";
+
+            if (nodes[body].Kind != NodeKind.Block || nodes[body].Left < 0)
+                return "its body assigns no element";
+
+            for (int child = nodes[body].Left; child >= 0; child = nodes[child].Next)
+            {
+                Node assignment = nodes[child];
+
+                if (assignment.Kind != NodeKind.Assignment || assignment.Right < 0)
+                    return "its body does more than assign elements of arrays";
+
+                if (!IsIndex(assignment.Right))
+                    return "it indexes an element by something else than the variable of the loop";
+
+                string reason = AddArray(Module.Bindings[child]) ?? AddExpression(assignment.Left);
+
+                if (reason != null)
+                    return reason;
+
+                Pop(Opcode.Store, Registers[Module.Bindings[child]]);
+            }
+
+            return null;
+        }
+
+        // The reason the instructions of the machine cannot run the kernel, or null
+        private string Check()
+        {
+            int size = Keywords.SizeOf(Kernel.Type);
+
+            if (Multiplies && (size == 1 || size == 8))
+                return $"the multiplication of {size * 8} bit elements has no vector instruction";
+
+            if (Multiplies && size == 4 && !Avx2)
+                return "the multiplication of 32 bit elements needs \"--avx2\"";
+
+            if (Invariants.Count + MaxDepth > VectorRegisters)
+                return $"it needs more than {VectorRegisters} vector registers";
+
+            Kernel.Lanes = (Avx2 ? 32 : 16) / size;
+
+            if (Kernel.Bound < Kernel.Lanes)
+                return "its arrays are shorter than a vector";
+
+            return null;
+        }
+
+        // i = i + 1, or i = 1 + i
+        private bool IsStep(int node)
+        {
+            Node[] nodes = Tree.Nodes;
+            Node step = nodes[node];
+
+            if (step.Kind != NodeKind.Assignment || step.Right >= 0 || Module.Bindings[node] != Variable)
+                return false;
+
+            Node sum = nodes[step.Left];
+
+            if (sum.Kind != NodeKind.Binary || Tree.Tokens[sum.Token].Value != '+')
+                return false;
+
+            return (IsIndex(sum.Left) && IsOne(sum.Right)) || (IsOne(sum.Left) && IsIndex(sum.Right));
+        }
+
+        private bool IsOne(int node)
+        {
+            if (Tree.Nodes[node].Kind != NodeKind.Number)
+                return false;
+
+            NumberLiteral literal = Tree.Tokens.Numbers[Tree.Tokens[Tree.Nodes[node].Token].Value];
+            return !literal.IsFloat && literal.Value == 1;
+        }
+
+        // A name of a variable of the function, not a path
+        private bool IsVariable(int node)
+        {
+            Node name = Tree.Nodes[node];
+            return name.Kind == NodeKind.Name && name.Extra == name.Token && Module.Bindings[node] >= 0;
+        }
+
+        private bool IsIndex(int node)
+        {
+            return IsVariable(node) && Module.Bindings[node] == Variable;
+        }
+
+        // A number or a variable other than the one of the loop, which the body never assigns
+        private bool IsInvariant(int node)
+        {
+            if (IsVariable(node))
+                return Module.Bindings[node] != Variable;
+
+            return Tree.Nodes[node].Kind == NodeKind.Number && !Tree.Tokens.Numbers[Tree.Tokens[Tree.Nodes[node].Token].Value].IsFloat;
+        }
+
+        // Every array of the kernel has the element type of the kernel
+        private string AddArray(int declaration)
+        {
+            Word type = (Word)Tree.Tokens[Tree.Nodes[declaration].Extra].Value;
+
+            if (Kernel.Type == Word.None)
+                Kernel.Type = type;
+
+            else if (Kernel.Type != type)
+                return "it mixes arrays of different element types";
+
+            Kernel.Bound = Math.Min(Kernel.Bound, Function.Arrays[Registers[declaration]].Length);
+            return null;
+        }
+
+        // Adds the operations computing an expression on the top of the stack
+        private string AddExpression(int node)
+        {
+            Node expression = Tree.Nodes[node];
+
+            switch (expression.Kind)
+            {
+                case NodeKind.Number:
+                case NodeKind.Name:
+                    if (IsIndex(node))
+                        return "it uses the variable of the loop as a value";
+
+                    if (!IsInvariant(node))
+                        return "it reads something else than elements, variables and numbers";
+
+                    Push(Opcode.Parameter, ParameterOf(node));
+                    return null;
+
+                case NodeKind.Index:
+                {
+                    if (!IsVariable(expression.Left))
+                        return "it reads something else than elements, variables and numbers";
+
+                    if (!IsIndex(expression.Right))
+                        return "it indexes an element by something else than the variable of the loop";
+
+                    string reason = AddArray(Module.Bindings[expression.Left]);
+
+                    if (reason == null)
+                        Push(Opcode.Load, Registers[Module.Bindings[expression.Left]]);
+
+                    return reason;
+                }
+
+                // Negating takes one more vector for the zero it subtracts from
+                case NodeKind.Negate:
+                {
+                    string reason = AddExpression(expression.Left);
+
+                    MaxDepth = Math.Max(MaxDepth, Depth + 1);
+                    Kernel.Operations.Add(new Instruction { Op = Opcode.Negate, Target = -1, Left = -1, Right = -1 });
+                    return reason;
+                }
+
+                case NodeKind.Binary:
+                {
+                    char operation = (char)Tree.Tokens[expression.Token].Value;
+
+                    if (operation == '/')
+                        return "it divides, which has no vector instruction";
+
+                    string reason = AddExpression(expression.Left) ?? AddExpression(expression.Right);
+
+                    Multiplies |= operation == '*';
+                    Pop((operation == '+') ? Opcode.Add : (operation == '-') ? Opcode.Subtract : Opcode.Multiply, 0);
+                    return reason;
+                }
+
+                case NodeKind.Call:
+                    return "it calls a function";
+
+                default:
+                    return "it computes something else than additions, subtractions and multiplications";
+            }
+        }
+
+        // The invariants are numbered in the order they are first read, each variable and number only once
+        private int ParameterOf(int node)
+        {
+            Node expression = Tree.Nodes[node];
+            int parameter;
+
+            if (expression.Kind == NodeKind.Name)
+            {
+                if (!Variables.TryGetValue(Module.Bindings[node], out parameter))
+                {
+                    parameter = Invariants.Count;
+                    Variables.Add(Module.Bindings[node], parameter);
+                    Invariants.Add(node);
+                }
+
+                return parameter;
+            }
+
+            // A literal with a suffix may wrap to another value, so only the literals without one are shared
+            NumberLiteral literal = Tree.Tokens.Numbers[Tree.Tokens[expression.Token].Value];
+
+            if (literal.Type != Word.None || !Numbers.TryGetValue(literal.Value, out parameter))
+            {
+                parameter = Invariants.Count;
+                Invariants.Add(node);
+
+                if (literal.Type == Word.None)
+                    Numbers.Add(literal.Value, parameter);
+            }
+
+            return parameter;
+        }
+
+        private void Push(Opcode op, int value)
+        {
+            Kernel.Operations.Add(new Instruction { Op = op, Target = -1, Left = -1, Right = -1, Value = value });
+            MaxDepth = Math.Max(MaxDepth, ++Depth);
+        }
+
+        private void Pop(Opcode op, int value)
+        {
+            Kernel.Operations.Add(new Instruction { Op = op, Target = -1, Left = -1, Right = -1, Value = value });
+            Depth--;
+        }
+    }
+}
@@ -0,0 +1,265 @@
+﻿using System;
+using System.IO;
+
+namespace Sage
+{
+    // Runs the bytecode of a program in one dispatch loop. The frames of the functions follow one another on a stack
+    // of 64 bit slots, and a call saves where its caller resumes on a separate stack instead of recursing.
+    internal class VirtualMachine
+    {
+        private const int StackSize = 1 << 20;
+        private const int MaxDepth = 1 << 16;
+
+        private readonly BytecodeFunction[] Functions;
+        private readonly long[] Stack = new long[StackSize];
+
+        // Function, position of the call instruction and frame of every caller
+        private readonly int[] CallerFunctions = new int[MaxDepth];
+        private readonly int[] CallerPositions = new int[MaxDepth];
+        private readonly int[] CallerFrames = new int[MaxDepth];
+
+        public VirtualMachine(BytecodeFunction[] functions)
+        {
+            Functions = functions;
+        }
+
+        // Runs a function without parameters, returning false and logging an error when the program faults. The program
+        // writes its output to the log, before the error.
+        public bool Run(int entry, TextWriter log, out long result)
+        {
+            int current = entry;
+
+            try
+            {
+                result = Execute(ref current, log);
+                return true;
+            }
+
+            catch (ArithmeticException)
+            {
+                log.WriteLine($"[ERROR] The program divided by zero or overflowed a division in the function \"{Functions[current].Name}\".");
+            }
+
+            catch (IndexOutOfRangeException)
+            {
+                log.WriteLine($"[ERROR] The program accessed an array out of its bounds in the function \"{Functions[current].Name}\".");
+            }
+
+            catch (InsufficientExecutionStackException)
+            {
+                log.WriteLine($"[ERROR] The program ran out of stack in the function \"{Functions[current].Name}\".");
+            }
+
+            result = 0;
+            return false;
+        }
+
+        private long Execute(ref int current, TextWriter output)
+        {
+            long[] stack = Stack;
+            BytecodeFunction function = Functions[current];
+            int[] code = function.Code;
+            int frame = 0;
+            int position = 0;
+            int depth = 0;
+
+            if (function.FrameSize > stack.Length)
+                throw new InsufficientExecutionStackException();
+
+            while (true)
+            {
+                switch ((BytecodeOp)code[position])
+                {
+                    case BytecodeOp.Constant:
+                        stack[frame + code[position + 1]] = (uint)code[position + 2] | ((long)code[position + 3] << 32);
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.Move:
+                        stack[frame + code[position + 1]] = stack[frame + code[position + 2]];
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.SignExtend8:
+                        stack[frame + code[position + 1]] = (sbyte)stack[frame + code[position + 2]];
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.SignExtend16:
+                        stack[frame + code[position + 1]] = (short)stack[frame + code[position + 2]];
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.SignExtend32:
+                        stack[frame + code[position + 1]] = (int)stack[frame + code[position + 2]];
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.ZeroExtend8:
+                        stack[frame + code[position + 1]] = (byte)stack[frame + code[position + 2]];
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.ZeroExtend16:
+                        stack[frame + code[position + 1]] = (ushort)stack[frame + code[position + 2]];
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.ZeroExtend32:
+                        stack[frame + code[position + 1]] = (uint)stack[frame + code[position + 2]];
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.Add:
+                        stack[frame + code[position + 1]] = unchecked(stack[frame + code[position + 2]] + stack[frame + code[position + 3]]);
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.Subtract:
+                        stack[frame + code[position + 1]] = unchecked(stack[frame + code[position + 2]] - stack[frame + code[position + 3]]);
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.Multiply:
+                        stack[frame + code[position + 1]] = unchecked(stack[frame + code[position + 2]] * stack[frame + code[position + 3]]);
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.DivideSigned:
+                        stack[frame + code[position + 1]] = stack[frame + code[position + 2]] / stack[frame + code[position + 3]];
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.DivideUnsigned:
+                        stack[frame + code[position + 1]] = (long)((ulong)stack[frame + code[position + 2]] / (ulong)stack[frame + code[position + 3]]);
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.Negate:
+                        stack[frame + code[position + 1]] = unchecked(-stack[frame + code[position + 2]]);
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.Equal:
+                        stack[frame + code[position + 1]] = (stack[frame + code[position + 2]] == stack[frame + code[position + 3]]) ? 1 : 0;
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.NotEqual:
+                        stack[frame + code[position + 1]] = (stack[frame + code[position + 2]] != stack[frame + code[position + 3]]) ? 1 : 0;
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.LessSigned:
+                        stack[frame + code[position + 1]] = (stack[frame + code[position + 2]] < stack[frame + code[position + 3]]) ? 1 : 0;
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.LessEqualSigned:
+                        stack[frame + code[position + 1]] = (stack[frame + code[position + 2]] <= stack[frame + code[position + 3]]) ? 1 : 0;
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.LessUnsigned:
+                        stack[frame + code[position + 1]] = ((ulong)stack[frame + code[position + 2]] < (ulong)stack[frame + code[position + 3]]) ? 1 : 0;
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.LessEqualUnsigned:
+                        stack[frame + code[position + 1]] = ((ulong)stack[frame + code[position + 2]] <= (ulong)stack[frame + code[position + 3]]) ? 1 : 0;
+                        position += 4;
+                        break;
+
+                    case BytecodeOp.Jump:
+                        position = code[position + 1];
+                        break;
+
+                    case BytecodeOp.JumpIfZero:
+                        position = (stack[frame + code[position + 1]] == 0) ? code[position + 2] : position + 3;
+                        break;
+
+                    case BytecodeOp.Load:
+                    {
+                        long index = stack[frame + code[position + 4]];
+
+                        if ((ulong)index >= (ulong)code[position + 3])
+                            throw new IndexOutOfRangeException();
+
+                        stack[frame + code[position + 1]] = stack[frame + code[position + 2] + (int)index];
+                        position += 5;
+                        break;
+                    }
+
+                    case BytecodeOp.Store:
+                    {
+                        long index = stack[frame + code[position + 3]];
+
+                        if ((ulong)index >= (ulong)code[position + 2])
+                            throw new IndexOutOfRangeException();
+
+                        stack[frame + code[position + 1] + (int)index] = stack[frame + code[position + 4]];
+                        position += 5;
+                        break;
+                    }
+
+                    case BytecodeOp.Clear:
+                        Array.Clear(stack, frame + code[position + 1], code[position + 2]);
+                        position += 3;
+                        break;
+
+                    case BytecodeOp.Write:
+                        output.Write(function.Strings[code[position + 1]]);
+                        position += 2;
+                        break;
+
+                    case BytecodeOp.Call:
+                    {
+                        BytecodeFunction callee = Functions[code[position + 2]];
+                        int count = code[position + 3];
+                        int calleeFrame = frame + function.FrameSize;
+
+                        if (depth == MaxDepth || calleeFrame + callee.FrameSize > stack.Length)
+                            throw new InsufficientExecutionStackException();
+
+                        for (int i = 0; i < count; i++)
+                            stack[calleeFrame + i] = stack[frame + code[position + 4 + i]];
+
+                        CallerFunctions[depth] = current;
+                        CallerPositions[depth] = position;
+                        CallerFrames[depth] = frame;
+                        depth++;
+
+                        current = code[position + 2];
+                        function = callee;
+                        code = callee.Code;
+                        frame = calleeFrame;
+                        position = 0;
+                        break;
+                    }
+
+                    case BytecodeOp.Return:
+                    case BytecodeOp.ReturnNothing:
+                    {
+                        long value = ((BytecodeOp)code[position] == BytecodeOp.Return) ? stack[frame + code[position + 1]] : 0;
+
+                        if (depth == 0)
+                            return value;
+
+                        depth--;
+                        current = CallerFunctions[depth];
+                        function = Functions[current];
+                        code = function.Code;
+                        position = CallerPositions[depth];
+                        frame = CallerFrames[depth];
+
+                        if (code[position + 1] >= 0)
+                            stack[frame + code[position + 1]] = value;
+
+                        position += 4 + code[position + 3];
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,158 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+
+namespace Sage
+{
+    // Recompiles the input files whenever they change, re-lexing only the edited lines
+    internal class Watcher
+    {
+        private const int PollInterval = 200;
+
+        private class WatchedFile
+        {
+            public string FileName;
+            public DateTime LastWrite;
+            public TokenStream Tokens;
+
+            // The errors of the lexer, which Relex keeps up to date, and the ones of the last parse
+            public DiagnosticBag LexerDiagnostics;
+            public DiagnosticBag Diagnostics;
+        }
+
+        private readonly Options Options;
+        private readonly IInterner Names;
+        private readonly IInterner Strings;
+        private readonly FileTable Files = new FileTable();
+
+        public Watcher(Options options, IInterner names, IInterner strings)
+        {
+            Options = options;
+            Names = names;
+            Strings = strings;
+        }
+
+        public int Run()
+        {
+            List<WatchedFile> files = new List<WatchedFile>();
+
+            foreach (string fileName in Options.Files)
+            {
+                int id = Files.Add(fileName);
+                WatchedFile file = new WatchedFile { FileName = fileName, LexerDiagnostics = new DiagnosticBag(id), Diagnostics = new DiagnosticBag(id) };
+                Lexer lexer = new Lexer(file.LexerDiagnostics, Names, Strings);
+
+                file.LastWrite = LastWrite(fileName);
+                file.Tokens = lexer.Read(fileName);
+
+                if (file.Tokens != null)
+                    Parse(file);
+
+                Report(file);
+
+                files.Add(file);
+            }
+
+            Console.WriteLine($"[INFO] Watching {files.Count} file(s), press Ctrl+C to stop.");
+
+            while (true)
+            {
+                Thread.Sleep(PollInterval);
+
+                foreach (WatchedFile file in files)
+                {
+                    DateTime lastWrite = LastWrite(file.FileName);
+
+                    if (lastWrite == file.LastWrite)
+                        continue;
+
+                    file.LastWrite = lastWrite;
+
+                    try
+                    {
+                        Update(file);
+                    }
+
+                    // The editor may still hold the file while saving it, the next poll tries again
+                    catch (IOException)
+                    {
+                        file.LastWrite = DateTime.MinValue;
+                    }
+                }
+            }
+        }
+
+        private void Update(WatchedFile file)
+        {
+            if (file.Tokens == null)
+            {
+                file.LexerDiagnostics.Clear();
+                file.Tokens = new Lexer(file.LexerDiagnostics, Names, Strings).Read(file.FileName);
+
+                if (file.Tokens != null)
+                    Parse(file);
+
+                Report(file);
+                return;
+            }
+
+            using (SourceFile source = SourceFile.Open(file.FileName))
+            {
+                char[] old = file.Tokens.Source;
+                int oldLength = file.Tokens.SourceLength;
+
+                // The edit is the range between the common prefix and the common suffix of both texts
+                int prefix = 0;
+                int limit = Math.Min(oldLength, source.Length);
+
+                while (prefix < limit && old[prefix] == source.Text[prefix])
+                    prefix++;
+
+                if (prefix == oldLength && prefix == source.Length)
+                    return;
+
+                int suffix = 0;
+
+                while (suffix < limit - prefix && old[oldLength - suffix - 1] == source.Text[source.Length - suffix - 1])
+                    suffix++;
+
+                string inserted = new string(source.Text, prefix, source.Length - prefix - suffix);
+                Lexer lexer = new Lexer(file.LexerDiagnostics, Names, Strings);
+                RelexResult result = lexer.Relex(file.Tokens, prefix, oldLength - prefix - suffix, inserted);
+
+                string changed = (result.ChangedFunctions.Count > 0) ? string.Join(", ", result.ChangedFunctions) : "none";
+                Console.WriteLine($"[INFO] {file.FileName}: {result.InsertedTokens} token(s) re-lexed for {result.RemovedTokens} removed, changed functions: {changed}.");
+            }
+
+            Parse(file);
+            Report(file);
+        }
+
+        private void Parse(WatchedFile file)
+        {
+            Parser parser = new Parser(file.Diagnostics);
+            Ast tree = parser.Parse(file.Tokens);
+
+            if (Options.DumpAst)
+                tree.Dump(Console.Out);
+        }
+
+        // Prints every diagnostic the file has now, the ones of the lines lexed before as well as the ones of the last
+        // parse. The maximum of errors applies to each file.
+        private void Report(WatchedFile file)
+        {
+            DiagnosticRenderer renderer = new DiagnosticRenderer(Files, Options.MaxErrors);
+
+            Files.SetSource(file.Diagnostics.File, (file.Tokens != null) ? file.Tokens.File : null);
+            renderer.Render(Console.Out, file.LexerDiagnostics);
+            renderer.Render(Console.Out, file.Diagnostics);
+            file.Diagnostics.Clear();
+        }
+
+        private static DateTime LastWrite(string fileName)
+        {
+            return File.Exists(fileName) ? File.GetLastWriteTimeUtc(fileName) : DateTime.MinValue;
+        }
+    }
+}
@@ -0,0 +1,1096 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.Text;
+
+namespace Sage
+{
+    // Writes the functions of a module as x86-64 assembly in the Intel syntax of the GNU assembler.
+    // Every value is kept in a 64 bit register, sign or zero extended from the size of its type, so operations can
+    // be done on whole registers and only their result needs to be wrapped back to its type.
+    internal class X64Emitter
+    {
+        private const int Rax = 0;
+
+        private static readonly string[] Names64 = { "rax", "rcx", "rdx", "rbx", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+        private static readonly string[] Names32 = { "eax", "ecx", "edx", "ebx", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" };
+        private static readonly string[] Names16 = { "ax", "cx", "dx", "bx", "si", "di", "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" };
+        private static readonly string[] Names8 = { "al", "cl", "dl", "bl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b" };
+
+        // Registers of the first arguments: rdi, rsi, rdx, rcx, r8 and r9, as in the System V calling convention
+        private static readonly int[] ArgumentRegisters = { 5, 4, 2, 1, 6, 7 };
+
+        // Strings up to this length are copied to the buffer of the output by the code of the program
+        private const int InlineWrite = 64;
+
+        // Rax and rdx are taken by division and return values, r11 is kept free for moving values between slots
+        private static readonly int[] CallerSaved = { 1, 4, 5, 6, 7, 8 };
+        private static readonly int[] CalleeSaved = { 3, 10, 11, 12, 13 };
+
+        // One emitter for every thread emitting functions in parallel, so each keeps its own output buffer
+        [ThreadStatic]
+        private static X64Emitter Local;
+
+        private readonly StringBuilder Output = new StringBuilder();
+        private IrFunction Function;
+        private RegisterAllocator Allocator;
+        private string Symbol;
+
+        // Number of instructions reading every register, a comparison only read by the branch after it sets no register
+        private int[] Uses;
+
+        // Distance from rbp down to the first element of every array, the arrays live below the slots
+        private int[] ArrayOffsets;
+
+        // Whether some element is accessed, which needs the trap of the indices out of bounds
+        private bool Bounds;
+
+        public static string SymbolOf(string name)
+        {
+            StringBuilder symbol = new StringBuilder(name.Length);
+
+            for (int i = 0; i < name.Length; i++)
+            {
+                char c = name[i];
+
+                if (c == ':' && i + 1 < name.Length && name[i + 1] == ':')
+                {
+                    symbol.Append('.');
+                    i++;
+                }
+
+                else if (c == '_' || (c < 128 && char.IsLetterOrDigit(c)))
+                    symbol.Append(c);
+
+                else
+                    symbol.Append("_u").Append(((int)c).ToString("x4"));
+            }
+
+            return symbol.ToString();
+        }
+
+        public string Emit(List<IrFunction> functions)
+        {
+            Output.Clear();
+
+            foreach (IrFunction function in functions)
+                EmitFunction(function);
+
+            return Output.ToString();
+        }
+
+        public static X64Emitter OfThread()
+        {
+            return Local ?? (Local = new X64Emitter());
+        }
+
+        // Emits one function into a pooled buffer, returning the number of characters written to it
+        public int Emit(IrFunction function, out char[] buffer)
+        {
+            Output.Clear();
+            EmitFunction(function);
+
+            buffer = BufferPool<char>.Rent(Output.Length);
+            Output.CopyTo(0, buffer, 0, Output.Length);
+            return Output.Length;
+        }
+
+        // Joins the buffers in their order, which is the order of the functions whatever thread emitted them, and
+        // gives them back to the pool
+        public static string Merge(char[][] buffers, int[] lengths)
+        {
+            int length = 0;
+
+            for (int i = 0; i < lengths.Length; i++)
+                length += lengths[i];
+
+            StringBuilder output = new StringBuilder(length);
+
+            for (int i = 0; i < buffers.Length; i++)
+            {
+                output.Append(buffers[i], 0, lengths[i]);
+                BufferPool<char>.Return(buffers[i]);
+            }
+
+            return output.ToString();
+        }
+
+        // The entry point of the C runtime, which calls the main function of Sage and exits with its result. A program
+        // writing to the console starts its runtime first and flushes the output before it exits, an instrumented
+        // program writes its profile before that.
+        public static string EmitEntry(IrFunction main, bool windows, bool console, bool profile = false)
+        {
+            StringBuilder output = new StringBuilder();
+            string result = (main.ReturnType != Word.None) ? null : "    xor eax, eax\n";
+
+            // The result waits for the flush in a register the runtime preserves
+            string saved = windows ? "esi" : "ebx";
+
+            output.Append("\n    .globl main\nmain:\n");
+
+            // The Windows convention also preserves rsi and rdi, and reserves 32 bytes for the callee
+            if (windows)
+                output.Append("    push rsi\n    push rdi\n    sub rsp, 40\n");
+
+            else
+                output.Append("    push rbx\n");
+
+            if (console)
+                output.Append($"    call {NativeRuntime.Start}\n");
+
+            output.Append($"    call {SymbolOf(main.Name)}\n").Append(result);
+
+            if (console || profile)
+                output.Append($"    mov {saved}, eax\n");
+
+            if (profile)
+                output.Append($"    call {NativeRuntime.WriteProfile}\n");
+
+            if (console)
+                output.Append($"    call {NativeRuntime.Flush}\n");
+
+            if (console || profile)
+                output.Append($"    mov eax, {saved}\n");
+
+            if (windows)
+                output.Append("    add rsp, 40\n    pop rdi\n    pop rsi\n");
+
+            else
+                output.Append("    pop rbx\n");
+
+            output.Append("    ret\n");
+            return output.ToString();
+        }
+
+        private void EmitFunction(IrFunction function)
+        {
+            function = function.WithoutPhis();
+
+            Function = function;
+            Allocator = new RegisterAllocator(CallerSaved, CalleeSaved);
+            Allocator.Allocate(function);
+            Symbol = SymbolOf(function.Name);
+            Uses = UsesOf(function);
+
+            // The counters of an instrumented function start at zero with the program
+            if (function.Instrumented)
+                Output.Append($"\n    .lcomm {NativeRuntime.CountersOf(function.Name)}, {8 * (1 + 2 * function.Branches.Count)}");
+
+            Output.Append($"\n    .globl {Symbol}\n{Symbol}:\n");
+            Line("push rbp");
+            Line("mov rbp, rsp");
+
+            foreach (int register in Allocator.UsedCalleeSaved)
+                Line($"push {Names64[register]}");
+
+            // Keep the stack aligned on 16 bytes at every call, the arrays take whole blocks of 16 bytes for the vectors
+            int frame = Allocator.SlotCount * 8;
+
+            ArrayOffsets = new int[function.Arrays.Count];
+            Bounds = false;
+
+            for (int i = 0; i < ArrayOffsets.Length; i++)
+            {
+                frame += SizeOf(function.Arrays[i]);
+                ArrayOffsets[i] = Allocator.UsedCalleeSaved.Count * 8 + frame;
+            }
+
+            if ((Allocator.UsedCalleeSaved.Count * 8 + frame) % 16 != 0)
+                frame += 8;
+
+            if (frame > 0)
+                Line($"sub rsp, {frame}");
+
+            if (function.BlockCounts == null)
+            {
+                for (int i = 0; i < function.Count; i++)
+                    EmitInstruction(function.Code[i], i);
+            }
+
+            else
+                EmitBlocks(BlockLayout.Order(function));
+
+            if (Bounds)
+            {
+                Output.Append($".L{Symbol}.bounds:\n");
+                Line("ud2");
+            }
+
+            EmitStrings();
+
+            Function = null;
+            Allocator = null;
+            Uses = null;
+            ArrayOffsets = null;
+        }
+
+        // Emits the blocks in the order of their layout. A block whose next block in the code is not the one laid out
+        // after it jumps there, unless its branch is turned around to fall through to the block laid out next, and
+        // the jumps to the block laid out next are left out.
+        private void EmitBlocks(IrBlock[] blocks)
+        {
+            Instruction[] code = Function.Code;
+
+            for (int i = 0; i < blocks.Length; i++)
+            {
+                IrBlock block = blocks[i];
+                int last = block.End - 1;
+                int next = (i + 1 < blocks.Length) ? blocks[i + 1].Start : -1;
+                long nextBlock = (next >= 0) ? code[next].Value : -1;
+                bool fallsThrough = code[last].Op != Opcode.Jump && code[last].Op != Opcode.Return && block.End < Function.Count;
+
+                for (int j = block.Start; j < last; j++)
+                    EmitInstruction(code[j], j);
+
+                if (code[last].Op == Opcode.Jump && code[last].Value == nextBlock)
+                    continue;
+
+                if (code[last].Op == Opcode.Branch && next != block.End && code[last].Value == nextBlock)
+                {
+                    EmitBranch(code[last], last, code[block.End].Value, true);
+                    continue;
+                }
+
+                EmitInstruction(code[last], last);
+
+                if (fallsThrough && next != block.End)
+                    Line($"jmp {LabelOf(code[block.End].Value)}");
+            }
+        }
+
+        private static int SizeOf(IrArray array)
+        {
+            return (array.Length * Keywords.SizeOf(array.Type) + 15) & ~15;
+        }
+
+        private static int[] UsesOf(IrFunction function)
+        {
+            int[] uses = new int[function.Registers.Count];
+
+            for (int i = 0; i < function.Count; i++)
+            {
+                Instruction instruction = function.Code[i];
+
+                if (instruction.Op == Opcode.Constant || instruction.Op == Opcode.Parameter || IrFunction.HasArguments(instruction.Op))
+                    continue;
+
+                if (instruction.Left >= 0)
+                    uses[instruction.Left]++;
+
+                if (instruction.Right >= 0)
+                    uses[instruction.Right]++;
+            }
+
+            foreach (int argument in function.Arguments)
+                uses[argument]++;
+
+            return uses;
+        }
+
+        private void EmitInstruction(Instruction instruction, int index)
+        {
+            switch (instruction.Op)
+            {
+                case Opcode.Parameter:
+                    if (index == 0)
+                        EmitParameters();
+
+                    break;
+
+                case Opcode.Constant:
+                    EmitConstant(instruction.Target, instruction.Value);
+                    break;
+
+                case Opcode.Copy:
+                    Move(instruction.Target, instruction.Left);
+                    break;
+
+                case Opcode.Convert:
+                    Line($"mov rax, {Operand(instruction.Left)}");
+                    Wrap(Rax, instruction.Type);
+                    Line($"mov {Operand(instruction.Target)}, rax");
+                    break;
+
+                case Opcode.Add:
+                    EmitBinary("add", instruction);
+                    break;
+
+                case Opcode.Subtract:
+                    EmitBinary("sub", instruction);
+                    break;
+
+                case Opcode.Multiply:
+                    EmitBinary("imul", instruction);
+                    break;
+
+                case Opcode.Divide:
+                    Line($"mov rax, {Operand(instruction.Left)}");
+
+                    if (Keywords.IsSigned(instruction.Type))
+                    {
+                        Line("cqo");
+                        Line($"idiv {Operand(instruction.Right)}");
+                    }
+
+                    else
+                    {
+                        Line("xor edx, edx");
+                        Line($"div {Operand(instruction.Right)}");
+                    }
+
+                    Wrap(Rax, instruction.Type);
+                    Line($"mov {Operand(instruction.Target)}, rax");
+                    break;
+
+                case Opcode.Negate:
+                {
+                    int target = Register(instruction.Target);
+                    int register = (target >= 0) ? target : Rax;
+
+                    if (register != Register(instruction.Left))
+                        Line($"mov {Names64[register]}, {Operand(instruction.Left)}");
+
+                    Line($"neg {Names64[register]}");
+                    Wrap(register, instruction.Type);
+
+                    if (register == Rax)
+                        Line($"mov {Operand(instruction.Target)}, rax");
+
+                    break;
+                }
+
+                case Opcode.Equal:
+                case Opcode.NotEqual:
+                case Opcode.Less:
+                case Opcode.LessEqual:
+                case Opcode.Greater:
+                case Opcode.GreaterEqual:
+                    if (!IsFused(index))
+                    {
+                        EmitCompare(instruction);
+                        Line($"set{ConditionOf(instruction.Op, instruction.Type)} al");
+                        Line("movzx eax, al");
+                        Line($"mov {Operand(instruction.Target)}, rax");
+                    }
+
+                    break;
+
+                case Opcode.Label:
+                    Output.Append(LabelOf(instruction.Value)).Append(":\n");
+                    break;
+
+                case Opcode.Jump:
+                    Line($"jmp {LabelOf(instruction.Value)}");
+                    break;
+
+                // The branch is taken when the condition does not hold
+                case Opcode.Branch:
+                    EmitBranch(instruction, index, instruction.Value, false);
+                    break;
+
+                // The counters are 64 bits, which no program runs long enough to wrap
+                case Opcode.Count:
+                {
+                    IrCounter counter = Function.Counters[(int)instruction.Value];
+                    Line($"inc qword ptr [rip + {NativeRuntime.CountersOf(counter.Function)} + {8 * counter.Index}]");
+                    break;
+                }
+
+                case Opcode.Call:
+                    EmitCall(instruction);
+                    break;
+
+                case Opcode.Load:
+                {
+                    int target = Register(instruction.Target);
+                    int register = (target >= 0) ? target : Rax;
+
+                    Line($"{LoadOf(instruction.Type, register)}, {ElementOf(instruction)}");
+
+                    if (register == Rax)
+                        Line($"mov {Operand(instruction.Target)}, rax");
+
+                    break;
+                }
+
+                case Opcode.Store:
+                {
+                    string element = ElementOf(instruction);
+                    int register = Register(instruction.Right);
+
+                    if (register < 0)
+                    {
+                        Line($"mov rax, {Operand(instruction.Right)}");
+                        register = Rax;
+                    }
+
+                    Line($"mov {element}, {NameOf(register, instruction.Type)}");
+                    break;
+                }
+
+                case Opcode.Clear:
+                    EmitClear((int)instruction.Value, index);
+                    break;
+
+                case Opcode.Kernel:
+                    EmitKernel(instruction, index);
+                    break;
+
+                case Opcode.Write:
+                    EmitWrite((int)instruction.Value, index);
+                    break;
+
+                case Opcode.Return:
+                    if (instruction.Left >= 0)
+                        Line($"mov rax, {Operand(instruction.Left)}");
+
+                    Line($"lea rsp, [rbp - {Allocator.UsedCalleeSaved.Count * 8}]");
+
+                    for (int i = Allocator.UsedCalleeSaved.Count - 1; i >= 0; i--)
+                        Line($"pop {Names64[Allocator.UsedCalleeSaved[i]]}");
+
+                    Line("pop rbp");
+                    Line("ret");
+                    break;
+            }
+        }
+
+        // Pushes the registers of all the parameters before popping them in place, so no parameter overwrites another
+        private void EmitParameters()
+        {
+            int count = Math.Min(Function.Parameters.Length, ArgumentRegisters.Length);
+
+            for (int i = 0; i < count; i++)
+                Line($"push {Names64[ArgumentRegisters[i]]}");
+
+            for (int i = Function.Count - 1; i >= 0; i--)
+            {
+                Instruction instruction = Function.Code[i];
+
+                if (instruction.Op == Opcode.Parameter && instruction.Value < count)
+                    Line($"pop {Operand(instruction.Target)}");
+            }
+
+            // The other parameters were pushed by the caller, above the return address
+            for (int i = 0; i < Function.Count && Function.Code[i].Op == Opcode.Parameter; i++)
+            {
+                Instruction instruction = Function.Code[i];
+
+                if (instruction.Value >= count)
+                {
+                    Line($"mov rax, qword ptr [rbp + {16 + (instruction.Value - count) * 8}]");
+                    Line($"mov {Operand(instruction.Target)}, rax");
+                }
+            }
+        }
+
+        private void EmitConstant(int target, long value)
+        {
+            int register = Register(target);
+
+            if (register >= 0)
+            {
+                if (value == 0)
+                    Line($"xor {Names32[register]}, {Names32[register]}");
+
+                else
+                    Line($"{(IsImmediate(value) ? "mov" : "movabs")} {Names64[register]}, {Number(value)}");
+            }
+
+            else if (IsImmediate(value))
+                Line($"mov {Operand(target)}, {Number(value)}");
+
+            else
+            {
+                Line($"movabs rax, {Number(value)}");
+                Line($"mov {Operand(target)}, rax");
+            }
+        }
+
+        // Computes in the target register when it does not hold the right operand, and in rax otherwise
+        private void EmitBinary(string operation, Instruction instruction)
+        {
+            int target = Register(instruction.Target);
+            int register = (target >= 0 && instruction.Target != instruction.Right && target != Register(instruction.Right)) ? target : Rax;
+
+            if (register != Register(instruction.Left) || register == Rax)
+                Line($"mov {Names64[register]}, {Operand(instruction.Left)}");
+
+            Line($"{operation} {Names64[register]}, {Operand(instruction.Right)}");
+            Wrap(register, instruction.Type);
+
+            if (register == Rax)
+                Line($"mov {Operand(instruction.Target)}, rax");
+        }
+
+        // Jumps to the block when the condition of the branch does not hold, or when it holds for a branch turned around
+        private void EmitBranch(Instruction instruction, int index, long block, bool holds)
+        {
+            if (index > 0 && IsFused(index - 1))
+            {
+                Instruction compare = Function.Code[index - 1];
+
+                EmitCompare(compare);
+                Line($"j{ConditionOf(holds ? compare.Op : Inverse(compare.Op), compare.Type)} {LabelOf(block)}");
+                return;
+            }
+
+            if (Register(instruction.Left) >= 0)
+                Line($"test {Names64[Register(instruction.Left)]}, {Names64[Register(instruction.Left)]}");
+
+            else
+                Line($"cmp {Operand(instruction.Left)}, 0");
+
+            Line($"{(holds ? "jne" : "je")} {LabelOf(block)}");
+        }
+
+        // A comparison read by nothing but the branch following it compares right before the jump
+        private bool IsFused(int index)
+        {
+            Instruction[] code = Function.Code;
+            return index + 1 < Function.Count && code[index + 1].Op == Opcode.Branch && code[index + 1].Left == code[index].Target &&
+                code[index].Op >= Opcode.Equal && code[index].Op <= Opcode.GreaterEqual && Uses[code[index].Target] == 1;
+        }
+
+        // The left operand must be a register, the values of both are extended over the whole registers
+        private void EmitCompare(Instruction instruction)
+        {
+            string left = (Register(instruction.Left) >= 0) ? Names64[Register(instruction.Left)] : "rax";
+
+            if (left == "rax")
+                Line($"mov rax, {Operand(instruction.Left)}");
+
+            Line($"cmp {left}, {Operand(instruction.Right)}");
+        }
+
+        private static string ConditionOf(Opcode op, Word type)
+        {
+            bool signed = Keywords.IsSigned(type);
+
+            switch (op)
+            {
+                case Opcode.Equal:
+                    return "e";
+
+                case Opcode.NotEqual:
+                    return "ne";
+
+                case Opcode.Less:
+                    return signed ? "l" : "b";
+
+                case Opcode.LessEqual:
+                    return signed ? "le" : "be";
+
+                case Opcode.Greater:
+                    return signed ? "g" : "a";
+
+                default:
+                    return signed ? "ge" : "ae";
+            }
+        }
+
+        private static Opcode Inverse(Opcode op)
+        {
+            switch (op)
+            {
+                case Opcode.Equal:
+                    return Opcode.NotEqual;
+
+                case Opcode.NotEqual:
+                    return Opcode.Equal;
+
+                case Opcode.Less:
+                    return Opcode.GreaterEqual;
+
+                case Opcode.LessEqual:
+                    return Opcode.Greater;
+
+                case Opcode.Greater:
+                    return Opcode.LessEqual;
+
+                default:
+                    return Opcode.Less;
+            }
+        }
+
+        // Local labels of the assembler, which are not kept in the symbols of the object
+        private string LabelOf(long block)
+        {
+            return $".L{Symbol}.{block}";
+        }
+
+        // Arguments are pushed and then popped in their registers, as their values may be in those registers
+        private void EmitCall(Instruction instruction)
+        {
+            int count = instruction.Right;
+            int onStack = Math.Max(0, count - ArgumentRegisters.Length);
+            int padding = (onStack % 2 != 0) ? 8 : 0;
+
+            if (padding > 0)
+                Line("sub rsp, 8");
+
+            for (int i = count - 1; i >= ArgumentRegisters.Length; i--)
+                Line($"push {Operand(Function.Arguments[instruction.Left + i])}");
+
+            int inRegisters = Math.Min(count, ArgumentRegisters.Length);
+
+            for (int i = 0; i < inRegisters; i++)
+                Line($"push {Operand(Function.Arguments[instruction.Left + i])}");
+
+            for (int i = inRegisters - 1; i >= 0; i--)
+                Line($"pop {Names64[ArgumentRegisters[i]]}");
+
+            Line($"call {SymbolOf(Function.Callees[(int)instruction.Value])}");
+
+            if (onStack > 0)
+                Line($"add rsp, {onStack * 8 + padding}");
+
+            if (instruction.Target >= 0)
+                Line($"mov {Operand(instruction.Target)}, rax");
+        }
+
+        // Copies a short string to the buffer of the console in pieces of 16 bytes or less, the last piece overlapping
+        // the one before it. When the buffer has no room the runtime flushes it first, and the output of a terminal is
+        // flushed after every string holding a line break. The register allocator sees the writes as calls.
+        private void EmitWrite(int index, int position)
+        {
+            byte[] bytes = Encoding.UTF8.GetBytes(Function.Strings[index]);
+            string text = $".L{Symbol}.s{index}";
+            string done = $".L{Symbol}.d{position}";
+
+            if (bytes.Length == 0)
+                return;
+
+            if (bytes.Length > InlineWrite)
+            {
+                Line($"lea rdi, [rip + {text}]");
+                Line($"mov esi, {bytes.Length}");
+                Line($"call {NativeRuntime.Write}");
+            }
+
+            else
+            {
+                string full = $".L{Symbol}.f{position}";
+
+                Line($"mov rax, qword ptr [rip + {NativeRuntime.Used}]");
+                Line($"cmp rax, {NativeRuntime.BufferSize - bytes.Length}");
+                Line($"ja {full}");
+                Line($"lea rdx, [rip + {NativeRuntime.Buffer}]");
+
+                if (bytes.Length >= 16)
+                {
+                    for (int offset = 0; offset < bytes.Length; offset += 16)
+                        CopyPiece(text, Math.Min(offset, bytes.Length - 16), 16);
+                }
+
+                else
+                {
+                    int size = (bytes.Length >= 8) ? 8 : (bytes.Length >= 4) ? 4 : (bytes.Length >= 2) ? 2 : 1;
+
+                    CopyPiece(text, 0, size);
+
+                    if (bytes.Length > size)
+                        CopyPiece(text, bytes.Length - size, size);
+                }
+
+                Line($"add rax, {bytes.Length}");
+                Line($"mov qword ptr [rip + {NativeRuntime.Used}], rax");
+                Line($"jmp {done}");
+                Output.Append(full).Append(":\n");
+                Line($"lea rdi, [rip + {text}]");
+                Line($"mov esi, {bytes.Length}");
+                Line($"call {NativeRuntime.Write}");
+            }
+
+            Output.Append(done).Append(":\n");
+
+            if (Array.IndexOf(bytes, (byte)'\n') >= 0)
+            {
+                string skip = $".L{Symbol}.n{position}";
+
+                Line($"cmp byte ptr [rip + {NativeRuntime.Interactive}], 0");
+                Line($"je {skip}");
+                Line($"call {NativeRuntime.Flush}");
+                Output.Append(skip).Append(":\n");
+            }
+        }
+
+        // Moves a piece of the string to the buffer at the position in rax, through xmm0 or r11
+        private void CopyPiece(string text, int offset, int size)
+        {
+            if (size == 16)
+            {
+                Line($"movdqu xmm0, xmmword ptr [rip + {text} + {offset}]");
+                Line($"movdqu xmmword ptr [rdx + rax + {offset}], xmm0");
+                return;
+            }
+
+            string register = (size == 8) ? "r11" : (size == 4) ? "r11d" : (size == 2) ? "r11w" : "r11b";
+
+            Line($"mov {register}, {PointerOf(size)} ptr [rip + {text} + {offset}]");
+            Line($"mov {PointerOf(size)} ptr [rdx + rax + {offset}], {register}");
+        }
+
+        // The constant strings of the function, read only and without a terminating zero
+        private void EmitStrings()
+        {
+            if (Function.Strings.Count == 0)
+                return;
+
+            Output.Append(Toolchain.IsWindows ? "\n    .section .rdata,\"dr\"\n" : "\n    .section .rodata\n");
+
+            for (int i = 0; i < Function.Strings.Count; i++)
+            {
+                byte[] bytes = Encoding.UTF8.GetBytes(Function.Strings[i]);
+
+                Output.Append($".L{Symbol}.s{i}:\n");
+
+                for (int start = 0; start < bytes.Length; start += 16)
+                {
+                    Output.Append("    .byte ");
+
+                    for (int j = start; j < Math.Min(start + 16, bytes.Length); j++)
+                        Output.Append((j > start) ? ", " : "").Append(bytes[j]);
+
+                    Output.Append('\n');
+                }
+            }
+
+            Output.Append("    .text\n");
+        }
+
+        // Checks the index of an element against the length of its array, the trap stops the program. The address
+        // is returned with the size of the element.
+        private string ElementOf(Instruction instruction)
+        {
+            int array = (int)instruction.Value;
+            int size = Keywords.SizeOf(instruction.Type);
+            int index = Register(instruction.Left);
+
+            if (index < 0)
+            {
+                Line($"mov r11, {Operand(instruction.Left)}");
+                index = 9;
+            }
+
+            Line($"cmp {Names64[index]}, {Function.Arrays[array].Length}");
+            Line($"jae .L{Symbol}.bounds");
+            Bounds = true;
+
+            return $"{PointerOf(size)} ptr [rbp + {Names64[index]}*{size} - {ArrayOffsets[array]}]";
+        }
+
+        private static string PointerOf(int size)
+        {
+            switch (size)
+            {
+                case 1:
+                    return "byte";
+
+                case 2:
+                    return "word";
+
+                case 4:
+                    return "dword";
+
+                default:
+                    return "qword";
+            }
+        }
+
+        // The instruction loading an element extended as the type asks, up to the address
+        private static string LoadOf(Word type, int register)
+        {
+            bool signed = Keywords.IsSigned(type);
+
+            switch (Keywords.SizeOf(type))
+            {
+                case 1:
+                case 2:
+                    return signed ? $"movsx {Names64[register]}" : $"movzx {Names32[register]}";
+
+                case 4:
+                    return signed ? $"movsxd {Names64[register]}" : $"mov {Names32[register]}";
+
+                default:
+                    return $"mov {Names64[register]}";
+            }
+        }
+
+        private static string NameOf(int register, Word type)
+        {
+            switch (Keywords.SizeOf(type))
+            {
+                case 1:
+                    return Names8[register];
+
+                case 2:
+                    return Names16[register];
+
+                case 4:
+                    return Names32[register];
+
+                default:
+                    return Names64[register];
+            }
+        }
+
+        // Zeroes the array 16 bytes at a time, in a loop unless it is small
+        private void EmitClear(int array, int index)
+        {
+            int size = SizeOf(Function.Arrays[array]);
+            int offset = ArrayOffsets[array];
+
+            Line("pxor xmm0, xmm0");
+
+            if (size <= 64)
+            {
+                for (int i = 0; i < size; i += 16)
+                    Line($"movdqu xmmword ptr [rbp - {offset - i}], xmm0");
+
+                return;
+            }
+
+            string loop = $".L{Symbol}.c{index}";
+
+            Line("xor eax, eax");
+            Output.Append(loop).Append(":\n");
+            Line($"movdqu xmmword ptr [rbp + rax - {offset}], xmm0");
+            Line("add rax, 16");
+            Line($"cmp rax, {size}");
+            Line($"jb {loop}");
+        }
+
+        // Runs the kernel from its start while a whole vector of indices stays below its end and within its arrays,
+        // leaving the index it stopped at in its target. The invariants are spread over the first vector registers
+        // and the operations use the ones after them as their stack. A turn that would leave the arrays ends the
+        // kernel, so the loop after it stops the program at the very element out of bounds.
+        private void EmitKernel(Instruction instruction, int index)
+        {
+            IrKernel kernel = Function.Kernels[(int)instruction.Value];
+            int size = Keywords.SizeOf(kernel.Type);
+            bool wide = kernel.Lanes * size == 32;
+            int invariants = instruction.Right - 2;
+            string loop = $".L{Symbol}.v{index}";
+            string end = $".L{Symbol}.w{index}";
+            string suffix = SuffixOf(size);
+
+            for (int i = 0; i < invariants; i++)
+            {
+                Line($"mov rax, {Operand(Function.Arguments[instruction.Left + 2 + i])}");
+                Broadcast(i, size, wide);
+            }
+
+            Line($"mov rax, {Operand(Function.Arguments[instruction.Left])}");
+            Output.Append(loop).Append(":\n");
+            Line($"cmp rax, {kernel.Bound - kernel.Lanes}");
+            Line($"ja {end}");
+            Line($"lea rdx, [rax + {kernel.Lanes}]");
+            Line($"cmp rdx, {Operand(Function.Arguments[instruction.Left + 1])}");
+            Line($"j{(Keywords.IsSigned(instruction.Type) ? "g" : "a")} {end}");
+
+            int depth = invariants;
+
+            foreach (Instruction operation in kernel.Operations)
+            {
+                switch (operation.Op)
+                {
+                    case Opcode.Load:
+                        Line($"{(wide ? "v" : "")}movdqu {VectorOf(depth++, wide)}, {VectorElementOf((int)operation.Value, size, wide)}");
+                        break;
+
+                    case Opcode.Store:
+                        Line($"{(wide ? "v" : "")}movdqu {VectorElementOf((int)operation.Value, size, wide)}, {VectorOf(--depth, wide)}");
+                        break;
+
+                    case Opcode.Parameter:
+                        Line($"{(wide ? "v" : "")}movdqa {VectorOf(depth++, wide)}, {VectorOf((int)operation.Value, wide)}");
+                        break;
+
+                    case Opcode.Add:
+                        depth--;
+                        Vector("padd" + suffix, depth - 1, depth, wide);
+                        break;
+
+                    case Opcode.Subtract:
+                        depth--;
+                        Vector("psub" + suffix, depth - 1, depth, wide);
+                        break;
+
+                    // 16 bit elements are multiplied by SSE2, 32 bit ones by AVX2 only
+                    case Opcode.Multiply:
+                        depth--;
+                        Vector((size == 2) ? "pmullw" : "pmulld", depth - 1, depth, wide);
+                        break;
+
+                    // Subtracts from a zero in the vector above the top
+                    case Opcode.Negate:
+                        Vector("pxor", depth, depth, wide);
+                        Vector("psub" + suffix, depth, depth - 1, wide);
+                        Line($"{(wide ? "v" : "")}movdqa {VectorOf(depth - 1, wide)}, {VectorOf(depth, wide)}");
+                        break;
+                }
+            }
+
+            Line("mov rax, rdx");
+            Line($"jmp {loop}");
+            Output.Append(end).Append(":\n");
+
+            // Leaving the upper halves of the registers dirty slows down the SSE code of the callers
+            if (wide)
+                Line("vzeroupper");
+
+            Line($"mov {Operand(instruction.Target)}, rax");
+        }
+
+        // Fills every element of the vector register with the value of rax
+        private void Broadcast(int vector, int size, bool wide)
+        {
+            string register = VectorOf(vector, false);
+
+            if (wide)
+            {
+                Line($"vmovq {register}, rax");
+                Line($"vpbroadcast{SuffixOf(size)} {VectorOf(vector, true)}, {register}");
+                return;
+            }
+
+            if (size == 8)
+            {
+                Line($"movq {register}, rax");
+                Line($"punpcklqdq {register}, {register}");
+                return;
+            }
+
+            Line($"movd {register}, eax");
+
+            if (size == 4)
+            {
+                Line($"pshufd {register}, {register}, 0");
+                return;
+            }
+
+            if (size == 1)
+                Line($"punpcklbw {register}, {register}");
+
+            Line($"pshuflw {register}, {register}, 0");
+            Line($"punpcklqdq {register}, {register}");
+        }
+
+        // The destination comes twice in the three operands of AVX
+        private void Vector(string operation, int target, int source, bool wide)
+        {
+            if (wide)
+                Line($"v{operation} {VectorOf(target, true)}, {VectorOf(target, true)}, {VectorOf(source, true)}");
+
+            else
+                Line($"{operation} {VectorOf(target, false)}, {VectorOf(source, false)}");
+        }
+
+        private static string VectorOf(int vector, bool wide)
+        {
+            return (wide ? "ymm" : "xmm") + vector;
+        }
+
+        // The elements of the vector starting at the index in rax
+        private string VectorElementOf(int array, int size, bool wide)
+        {
+            return $"{(wide ? "ymm" : "xmm")}word ptr [rbp + rax*{size} - {ArrayOffsets[array]}]";
+        }
+
+        private static string SuffixOf(int size)
+        {
+            switch (size)
+            {
+                case 1:
+                    return "b";
+
+                case 2:
+                    return "w";
+
+                case 4:
+                    return "d";
+
+                default:
+                    return "q";
+            }
+        }
+
+        private void Move(int target, int source)
+        {
+            int register = Register(target);
+
+            if (register >= 0)
+            {
+                if (register != Register(source))
+                    Line($"mov {Names64[register]}, {Operand(source)}");
+            }
+
+            else if (Register(source) >= 0)
+                Line($"mov {Operand(target)}, {Operand(source)}");
+
+            else if (Allocator.Locations[target] != Allocator.Locations[source])
+            {
+                Line($"mov r11, {Operand(source)}");
+                Line($"mov {Operand(target)}, r11");
+            }
+        }
+
+        // Extends the low bits of a register that belong to the type over the whole register
+        private void Wrap(int register, Word type)
+        {
+            bool signed = Keywords.IsSigned(type);
+
+            switch (Keywords.SizeOf(type))
+            {
+                case 1:
+                    Line(signed ? $"movsx {Names64[register]}, {Names8[register]}" : $"movzx {Names32[register]}, {Names8[register]}");
+                    break;
+
+                case 2:
+                    Line(signed ? $"movsx {Names64[register]}, {Names16[register]}" : $"movzx {Names32[register]}, {Names16[register]}");
+                    break;
+
+                case 4:
+                    Line(signed ? $"movsxd {Names64[register]}, {Names32[register]}" : $"mov {Names32[register]}, {Names32[register]}");
+                    break;
+            }
+        }
+
+        // The machine register of a virtual register, or -1 when it lives on the stack
+        private int Register(int register)
+        {
+            if (register < 0)
+                return -1;
+
+            int location = Allocator.Locations[register];
+            return RegisterAllocator.IsSlot(location) ? -1 : location;
+        }
+
+        private string Operand(int register)
+        {
+            int location = Allocator.Locations[register];
+
+            if (!RegisterAllocator.IsSlot(location))
+                return Names64[location];
+
+            int offset = (Allocator.UsedCalleeSaved.Count + RegisterAllocator.SlotOf(location) + 1) * 8;
+            return $"qword ptr [rbp - {offset}]";
+        }
+
+        private static string Number(long value)
+        {
+            return value.ToString(CultureInfo.InvariantCulture);
+        }
+
+        private static bool IsImmediate(long value)
+        {
+            return value >= int.MinValue && value <= int.MaxValue;
+        }
+
+        private void Line(string text)
+        {
+            Output.Append("    ").Append(text).Append('\n');
+        }
+    }
+}